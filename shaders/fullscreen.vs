@@ -0,0 +1,10 @@
+﻿#version 330 core
+out vec2 texCoord;
+
+// One triangle covering the whole screen, drawn without vertex data.
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    texCoord = position;
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
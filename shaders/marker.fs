@@ -1,6 +1,6 @@
 ﻿#version 330 core
+in vec3 markerColor;
 out vec4 FragColor;
-uniform vec3 markerColor;
 void main(){
     FragColor = vec4(markerColor, 1.0);
 }
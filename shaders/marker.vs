@@ -1,8 +1,27 @@
 ﻿#version 330 core
 layout (location = 0) in vec3 aPos;
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (location = 1) in vec3 aColor;
+layout (location = 2) in float aSize;
+
+// Per-frame values, shared with the other shaders (see src/frame_uniforms.hpp).
+layout (std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    float pointSize;
+    bool useLighting;
+    float viewportHeight;
+    bool adaptivePointSize;
+    float radiusScale;
+};
+
+out vec3 markerColor;
+
+// Debug geometry (see src/debug_draw.hpp) is given in world space.
 void main(){
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * vec4(aPos, 1.0);
+    gl_PointSize = aSize;
+    markerColor = aColor;
 }
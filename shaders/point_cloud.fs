@@ -4,10 +4,19 @@ in vec3 fragNormal;
 in vec3 fragPos;
 out vec4 FragColor;
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform vec3 lightColor;
-uniform bool useLighting;
+// Per-frame values, shared with the other shaders (see src/frame_uniforms.hpp).
+layout (std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    float pointSize;
+    bool useLighting;
+    float viewportHeight;
+    bool adaptivePointSize;
+    float radiusScale;
+};
 
 void main()
 {
@@ -19,11 +28,11 @@ void main()
     if(useLighting)
     {
         // Compute ambient and diffuse lighting
-        vec3 ambient = 0.2 * lightColor;
+        vec3 ambient = 0.2 * lightColor.rgb;
         vec3 norm = normalize(fragNormal);
-        vec3 lightDir = normalize(lightPos - fragPos);
+        vec3 lightDir = normalize(lightPos.xyz - fragPos);
         float diff = max(dot(norm, lightDir), 0.0);
-        vec3 diffuse = diff * lightColor;
+        vec3 diffuse = diff * lightColor.rgb;
         vec3 result = (ambient + diffuse) * fragColor;
         FragColor = vec4(result, 1.0);
     }
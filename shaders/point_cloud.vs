@@ -2,23 +2,85 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
 layout (location = 2) in vec3 aNormal;
+layout (location = 3) in float aRadius;
+layout (location = 4) in float aTile;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform float pointSize;
+
+// Per-frame values, shared with the other shaders (see src/frame_uniforms.hpp).
+layout (std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    float pointSize;
+    bool useLighting;
+    float viewportHeight;
+    bool adaptivePointSize;
+    float radiusScale;
+};
+
+// Placement of the files of a scene (see src/frame_uniforms.hpp), six texels per tile: the
+// columns of the tile's model matrix, boundsMin and boundsExtent. With sceneTiles set, the points
+// are transformed by the model matrix of tile aTile before 'model', and compact positions are
+// relative to the tile bounds instead of boundsMin/boundsExtent.
+uniform samplerBuffer sceneTileData;
+uniform bool sceneTiles;
+
+// Compact vertex format: aPos is the position normalized to the cloud bounds and
+// aNormal.xy an octahedral-encoded normal (see src/compact_vertex.hpp), and aRadius is
+// sqrt(radius / bounds diagonal).
+uniform bool compactVertices;
+uniform vec3 boundsMin;
+uniform vec3 boundsExtent;
+
+// Relative distance the point is pushed away from the camera, used by the depth pass of the
+// deferred splatting pipeline (see src/splat_renderer.hpp). 0 for the forward path.
+uniform float depthOffset;
 
 out vec3 fragColor;
 out vec3 fragNormal;
 out vec3 fragPos;
 
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
 void main()
 {
-    vec4 worldPos = model * vec4(aPos, 1.0);
+    mat4 pointModel = model;
+    vec3 quantizationMin = boundsMin;
+    vec3 quantizationExtent = boundsExtent;
+    if (sceneTiles) {
+        int texel = int(aTile) * 6;
+        pointModel = model * mat4(texelFetch(sceneTileData, texel), texelFetch(sceneTileData, texel + 1),
+                                  texelFetch(sceneTileData, texel + 2), texelFetch(sceneTileData, texel + 3));
+        quantizationMin = texelFetch(sceneTileData, texel + 4).xyz;
+        quantizationExtent = texelFetch(sceneTileData, texel + 5).xyz;
+    }
+    vec3 position = compactVertices ? quantizationMin + aPos * quantizationExtent : aPos;
+    vec3 normal = compactVertices ? octahedralDecode(aNormal.xy) : aNormal;
+
+    vec4 worldPos = pointModel * vec4(position, 1.0);
     fragPos = worldPos.xyz;
     fragColor = aColor;
     // Transform the normal appropriately.
-    fragNormal = mat3(transpose(inverse(model))) * aNormal;
-    gl_Position = projection * view * worldPos;
-    gl_PointSize = pointSize;
+    fragNormal = mat3(transpose(inverse(pointModel))) * normal;
+    // Scaling along the view ray moves the depth but not the position on screen.
+    vec4 viewPosition = view * worldPos;
+    viewPosition.xyz *= 1.0 + depthOffset;
+    gl_Position = projection * viewPosition;
+
+    // Perspective-correct size: the radius projected to pixels at the distance of the point.
+    // Points without a radius keep the fixed size.
+    float radius = compactVertices ? aRadius * aRadius * length(quantizationExtent) : aRadius;
+    if (adaptivePointSize && radius > 0.0)
+        gl_PointSize = clamp(radiusScale * radius * projection[1][1] * viewportHeight / -viewPosition.z, 1.0, 100.0);
+    else
+        gl_PointSize = pointSize;
 }
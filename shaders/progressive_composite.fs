@@ -0,0 +1,18 @@
+﻿#version 330 core
+// Copies the image accumulated by progressive rendering (see src/progressive_renderer.hpp) into
+// the target framebuffer, with its depth, leaving the background where no point was drawn.
+in vec2 texCoord;
+out vec4 FragColor;
+
+uniform sampler2D colorTexture;
+uniform sampler2D depthTexture;
+uniform float farDepth;   // what the depth buffer is cleared to, 0 with reversed-Z
+
+void main()
+{
+    float depth = texture(depthTexture, texCoord).r;
+    if (depth == farDepth)
+        discard;
+    FragColor = texture(colorTexture, texCoord);
+    gl_FragDepth = depth;
+}
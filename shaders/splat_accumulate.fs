@@ -0,0 +1,21 @@
+﻿#version 330 core
+in vec3 fragColor;
+in vec3 fragNormal;
+in vec3 fragPos;
+
+// Summed with additive blending over all splats that are in front of the visibility depth.
+layout (location = 0) out vec4 accumColor;    // rgb * weight, weight
+layout (location = 1) out vec4 accumNormal;   // normal * weight, weight
+
+void main()
+{
+    vec2 coord = gl_PointCoord * 2.0 - 1.0;
+    float r2 = dot(coord, coord);
+    if (r2 > 1.0)
+        discard;
+
+    // Splats fade towards their edge, so overlapping splats blend smoothly.
+    float weight = 1.0 - r2;
+    accumColor = vec4(fragColor * weight, weight);
+    accumNormal = vec4(fragNormal * weight, weight);
+}
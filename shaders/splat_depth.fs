@@ -0,0 +1,7 @@
+﻿#version 330 core
+// Visibility pass of the deferred splatting pipeline: depth only, round sprites.
+void main()
+{
+    if (length(gl_PointCoord - vec2(0.5)) > 0.5)
+        discard;
+}
@@ -0,0 +1,85 @@
+﻿#version 330 core
+in vec2 texCoord;
+out vec4 FragColor;
+
+// Per-frame values, shared with the other shaders (see src/frame_uniforms.hpp).
+layout (std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    float pointSize;
+    bool useLighting;
+    float viewportHeight;
+    bool adaptivePointSize;
+    float radiusScale;
+};
+
+uniform sampler2D colorTexture;
+uniform sampler2D normalTexture;
+uniform sampler2D depthTexture;
+uniform mat4 inverseViewProjection;
+uniform bool depthZeroToOne;   // clip-space depth in [0, 1] (reversed-Z) instead of [-1, 1]
+uniform float farDepth;        // what the depth buffer is cleared to
+
+uniform bool eyeDomeLighting;
+uniform float edlStrength;
+uniform float edlRadius;   // in pixels
+
+const vec2 neighbours[8] = vec2[8](
+    vec2(1.0, 0.0), vec2(-1.0, 0.0), vec2(0.0, 1.0), vec2(0.0, -1.0),
+    vec2(0.7071, 0.7071), vec2(-0.7071, 0.7071), vec2(0.7071, -0.7071), vec2(-0.7071, -0.7071));
+
+// Normalized device depth of a depth buffer value.
+float ndcDepth(float depth)
+{
+    return depthZeroToOne ? depth : depth * 2.0 - 1.0;
+}
+
+// Distance from the camera plane of a depth buffer value.
+float linearDepth(float depth)
+{
+    return projection[3][2] / (ndcDepth(depth) + projection[2][2]);
+}
+
+void main()
+{
+    vec4 color = texture(colorTexture, texCoord);
+    if (color.a <= 0.0)
+        discard;
+    float depth = texture(depthTexture, texCoord).r;
+    vec3 albedo = color.rgb / color.a;
+    vec3 result = albedo;
+
+    if (useLighting)
+    {
+        // Same ambient and diffuse lighting as point_cloud.fs, once per pixel.
+        vec4 world = inverseViewProjection * vec4(texCoord * 2.0 - 1.0, ndcDepth(depth), 1.0);
+        vec3 fragPos = world.xyz / world.w;
+        vec3 normal = texture(normalTexture, texCoord).xyz;
+        float normalLength = length(normal);
+        vec3 lightDir = normalize(lightPos.xyz - fragPos);
+        float diff = normalLength > 0.0 ? max(dot(normal / normalLength, lightDir), 0.0) : 0.0;
+        result = (0.2 * lightColor.rgb + diff * lightColor.rgb) * albedo;
+    }
+
+    if (eyeDomeLighting)
+    {
+        // Darken pixels that are behind their neighbours, compared in log depth.
+        vec2 texel = edlRadius / vec2(textureSize(depthTexture, 0));
+        float own = log2(linearDepth(depth));
+        float response = 0.0;
+        for (int i = 0; i < 8; ++i)
+        {
+            float neighbour = texture(depthTexture, texCoord + neighbours[i] * texel).r;
+            if (neighbour != farDepth)
+                response += max(0.0, own - log2(linearDepth(neighbour)));
+        }
+        result *= exp(-response / 8.0 * 300.0 * edlStrength);
+    }
+
+    FragColor = vec4(result, 1.0);
+    // Keep the depth, so markers drawn afterwards are hidden behind the points.
+    gl_FragDepth = depth;
+}
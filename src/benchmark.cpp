@@ -0,0 +1,440 @@
+﻿//
+// src/benchmark.cpp
+//
+
+#include "benchmark.hpp"
+#include "depth_range.hpp"
+#include "frame_uniforms.hpp"
+#include "gl_extensions.hpp"
+#include "point_renderer.hpp"
+#include "shader.hpp"
+#include "simd_kernels.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct Keyframe {
+    glm::vec3 position;
+    glm::vec3 target;
+};
+
+// Queries of each kind timed after the frames.
+constexpr int QUERY_SAMPLES = 1000;
+constexpr size_t QUERY_NEIGHBOURS = 8;
+
+// Mean times of the spatial queries of PointRenderer, in microseconds.
+struct QueryTiming {
+    double pickUs = 0.0;
+    double nearestUs = 0.0;
+    double radiusUs = 0.0;
+    size_t pickHits = 0;        // rays that hit a point
+    double radiusPoints = 0.0;  // mean number of points found per radius query
+};
+
+struct FrameTiming {
+    double cpuMs;     // recording the frame's GL commands
+    double gpuMs;     // GL_TIME_ELAPSED of the point pass
+    double frameMs;   // until glFinish returned
+    size_t pointsDrawn;
+};
+
+// Camera path file: one keyframe per line, "x y z tx ty tz" (position and look-at target).
+// Empty lines and lines starting with '#' are ignored.
+bool readCameraPath(const std::string &filename, std::vector<Keyframe> &keyframes)
+{
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "[Benchmark] Failed to open camera path: " << filename << std::endl;
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        if (line.find_first_not_of(" \t\r") == std::string::npos || line[line.find_first_not_of(" \t")] == '#')
+            continue;
+        std::istringstream iss(line);
+        Keyframe key;
+        if (!(iss >> key.position.x >> key.position.y >> key.position.z >> key.target.x >> key.target.y >> key.target.z)) {
+            std::cerr << "[Benchmark] Failed to read keyframe on line " << lineNumber << std::endl;
+            return false;
+        }
+        keyframes.push_back(key);
+    }
+    if (keyframes.empty()) {
+        std::cerr << "[Benchmark] Camera path has no keyframes: " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// One turn around the cloud, slightly from above.
+std::vector<Keyframe> orbitPath(const Bounds &bounds)
+{
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    float radius = std::max(glm::length(bounds.extent()), 1e-3f);
+    std::vector<Keyframe> keyframes;
+    for (int i = 0; i <= 16; ++i) {
+        float angle = glm::radians(360.0f * i / 16);
+        glm::vec3 offset(std::cos(angle) * radius, radius * 0.3f, std::sin(angle) * radius);
+        keyframes.push_back({center + offset, center});
+    }
+    return keyframes;
+}
+
+// Position on the path at t in [0, 1], linear between evenly spaced keyframes.
+Keyframe samplePath(const std::vector<Keyframe> &keyframes, float t)
+{
+    if (keyframes.size() == 1)
+        return keyframes.front();
+    float position = t * (keyframes.size() - 1);
+    size_t index = std::min(static_cast<size_t>(position), keyframes.size() - 2);
+    float f = position - index;
+    const Keyframe &a = keyframes[index], &b = keyframes[index + 1];
+    return {glm::mix(a.position, b.position, f), glm::mix(a.target, b.target, f)};
+}
+
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(std::lround(p * (values.size() - 1)));
+    return values[index];
+}
+
+// Quote 's' as a JSON string.
+std::string jsonString(const std::string &s)
+{
+    std::string quoted = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + '"';
+}
+
+void writeSummary(std::ostream &out, const char *name, const std::vector<double> &values, bool json)
+{
+    double sum = 0.0;
+    for (double value : values)
+        sum += value;
+    double mean = values.empty() ? 0.0 : sum / values.size();
+    if (json) {
+        out << "    \"" << name << "\": {\"mean\": " << mean << ", \"p50\": " << percentile(values, 0.5)
+            << ", \"p95\": " << percentile(values, 0.95) << ", \"p99\": " << percentile(values, 0.99)
+            << ", \"max\": " << percentile(values, 1.0) << "}";
+    } else {
+        out << name << " mean " << mean << " ms, p50 " << percentile(values, 0.5) << " ms, p95 "
+            << percentile(values, 0.95) << " ms, p99 " << percentile(values, 0.99) << " ms" << std::endl;
+    }
+}
+
+// Time QUERY_SAMPLES picks along rays through random pixels seen from the keyframes, k-nearest
+// neighbour queries around random points of the cloud, and radius queries around the same points
+// with twice the distance to their farthest neighbour as the radius.
+QueryTiming benchmarkQueries(const PointRenderer &renderer, const std::vector<Keyframe> &keyframes,
+                             const glm::mat4 &projection, int height)
+{
+    QueryTiming timing;
+    const size_t pointCount = renderer.getPointCount();
+    if (renderer.getLod() || pointCount == 0)
+        return timing;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_int_distribution<size_t> anyPoint(0, pointCount - 1);
+
+    // Two pixels around the ray, as for picking with the mouse.
+    const float tanAngle = 2.0f * 2.0f / (projection[1][1] * height);
+    auto start = Clock::now();
+    for (int i = 0; i < QUERY_SAMPLES; ++i) {
+        const Keyframe &key = keyframes[i % keyframes.size()];
+        glm::mat4 view = glm::lookAt(key.position, key.target, glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::vec4 farPoint = glm::inverse(projection * view) * glm::vec4(unit(random), unit(random), 1.0f, 1.0f);
+        glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - key.position);
+        PointRenderer::PickResult pick;
+        timing.pickHits += renderer.pick(key.position, direction, tanAngle, pick);
+    }
+    timing.pickUs = elapsedMs(start) * 1000.0 / QUERY_SAMPLES;
+
+    std::vector<glm::vec3> centers(QUERY_SAMPLES);
+    for (glm::vec3 &center : centers)
+        center = renderer.getWorldPosition(anyPoint(random));
+    std::vector<float> radii(QUERY_SAMPLES, 0.0f);
+    std::vector<size_t> indices;
+    start = Clock::now();
+    for (int i = 0; i < QUERY_SAMPLES; ++i) {
+        if (renderer.findNearest(centers[i], QUERY_NEIGHBOURS, indices) > 0)
+            radii[i] = glm::length(renderer.getWorldPosition(indices.back()) - centers[i]);
+    }
+    timing.nearestUs = elapsedMs(start) * 1000.0 / QUERY_SAMPLES;
+
+    size_t found = 0;
+    start = Clock::now();
+    for (int i = 0; i < QUERY_SAMPLES; ++i)
+        found += renderer.findWithinRadius(centers[i], 2.0f * radii[i], indices);
+    timing.radiusUs = elapsedMs(start) * 1000.0 / QUERY_SAMPLES;
+    timing.radiusPoints = double(found) / QUERY_SAMPLES;
+    return timing;
+}
+
+GLFWwindow *createHiddenWindow(int width, int height)
+{
+    auto create = [&]() -> GLFWwindow* {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        return glfwCreateWindow(width, height, "Point Cloud Benchmark", nullptr, nullptr);
+    };
+
+    if (glfwInit()) {
+        if (GLFWwindow *window = create())
+            return window;
+        glfwTerminate();
+    }
+
+    // No display: software context without any window system.
+    std::cout << "[Benchmark] No window system, trying OSMesa" << std::endl;
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    if (!glfwInit())
+        return nullptr;
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    GLFWwindow *window = create();
+    if (!window)
+        glfwTerminate();
+    return window;
+}
+
+} // namespace
+
+int runBenchmark(const BenchmarkOptions &options)
+{
+    GLFWwindow *window = createHiddenWindow(options.width, options.height);
+    if (!window) {
+        std::cerr << "[Benchmark] Failed to create an OpenGL context" << std::endl;
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
+        std::cerr << "[Benchmark] Failed to initialize GLAD" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    loadGlExtensions(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
+    const char *glRenderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    std::cout << "[Benchmark] Renderer: " << (glRenderer ? glRenderer : "unknown") << std::endl;
+
+    int exitCode = 0;
+    {
+        // The default framebuffer of a hidden window may not be backed by anything.
+        GLuint framebuffer, colorBuffer, depthBuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &colorBuffer);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, options.width, options.height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, options.width, options.height);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        glViewport(0, 0, options.width, options.height);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        if (options.reversedZ)
+            enableReversedZ();
+
+        Shader pointShader("shaders/point_cloud.vs", "shaders/point_cloud.fs");
+        pointShader.bindUniformBlock("FrameUniforms", FRAME_UNIFORMS_BINDING);
+        FrameUniformBuffer frameUniforms;
+
+        auto loadStart = Clock::now();
+        PointRenderer renderer(options.file, options.loadOptions);
+        renderer.setGpuCulling(options.gpuCulling);
+        glFinish();
+        double loadMs = elapsedMs(loadStart);
+        const PointRenderer::LoadTimings timings = renderer.getLoadTimings();
+        const BufferUploader::Stats uploadStats = renderer.getUploadStats();
+
+        std::vector<Keyframe> keyframes;
+        if (options.cameraPath.empty())
+            keyframes = orbitPath(renderer.getBounds());
+        else if (!readCameraPath(options.cameraPath, keyframes))
+            exitCode = -1;
+
+        std::vector<FrameTiming> frames;
+        std::vector<GLuint> queries(std::max(options.frames, 0));
+        Bounds bounds = renderer.getBounds();
+        BoundingSphere sphere = renderer.getBoundingSphere();
+        const float fovy = glm::radians(45.0f);
+        const float aspect = static_cast<float>(options.width) / options.height;
+        // The queries only need the rays, the frames fit the near and far plane to the cloud.
+        DepthRange queryRange;
+        queryRange.farPlane = std::max(glm::length(bounds.extent()) * 4.0f, 1.0f);
+        queryRange.nearPlane = queryRange.farPlane * 1e-4f;
+        glm::mat4 projection = perspectiveProjection(fovy, aspect, queryRange);
+        if (exitCode == 0 && !queries.empty()) {
+            glGenQueries(static_cast<GLsizei>(queries.size()), queries.data());
+
+            for (int i = 0; i < options.frames; ++i) {
+                auto frameStart = Clock::now();
+                Keyframe key = samplePath(keyframes, options.frames > 1 ? float(i) / (options.frames - 1) : 0.0f);
+                glm::mat4 view = glm::lookAt(key.position, key.target, glm::vec3(0.0f, 1.0f, 0.0f));
+                glm::mat4 frameProjection = perspectiveProjection(fovy, aspect, fitDepthRange(bounds, sphere, view));
+
+                glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glBeginQuery(GL_TIME_ELAPSED, queries[i]);
+                FrameUniforms uniforms;
+                uniforms.projection = frameProjection;
+                uniforms.view = view;
+                uniforms.viewPos = glm::vec4(key.position, 1.0f);
+                uniforms.lightPos = glm::vec4(key.position, 1.0f);
+                uniforms.pointSize = options.pointSize;
+                uniforms.viewportHeight = static_cast<float>(options.height);
+                frameUniforms.update(uniforms);
+                pointShader.use();
+                pointShader.setMat4("model", glm::mat4(1.0f));
+                renderer.update();
+                renderer.render(pointShader, frameProjection, view);
+                glEndQuery(GL_TIME_ELAPSED);
+                double cpuMs = elapsedMs(frameStart);
+                glFinish();
+
+                size_t pointsDrawn = renderer.getLod() ? renderer.getLod()->getStats().pointsDrawn
+                                                       : renderer.getChunkStats().pointsDrawn;
+                frames.push_back({cpuMs, 0.0, elapsedMs(frameStart), pointsDrawn});
+            }
+
+            for (size_t i = 0; i < frames.size(); ++i) {
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+                frames[i].gpuMs = nanoseconds / 1e6;
+            }
+            glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+        }
+
+        QueryTiming queryTiming;
+        if (exitCode == 0)
+            queryTiming = benchmarkQueries(renderer, keyframes, projection, options.height);
+
+        std::ofstream out;
+        if (exitCode == 0) {
+            out.open(options.output);
+            if (!out.is_open()) {
+                std::cerr << "[Benchmark] Failed to create output file: " << options.output << std::endl;
+                exitCode = -1;
+            }
+        }
+
+        if (exitCode == 0) {
+            std::vector<double> cpu, gpu, total;
+            for (const FrameTiming &frame : frames) {
+                cpu.push_back(frame.cpuMs);
+                gpu.push_back(frame.gpuMs);
+                total.push_back(frame.frameMs);
+            }
+
+            bool json = options.output.size() < 4 || options.output.substr(options.output.size() - 4) != ".csv";
+            if (json) {
+                out << "{\n  \"file\": " << jsonString(options.file) << ",\n"
+                    << "  \"renderer\": " << jsonString(glRenderer ? glRenderer : "unknown") << ",\n"
+                    << "  \"width\": " << options.width << ",\n  \"height\": " << options.height << ",\n"
+                    << "  \"points\": " << renderer.getPointCount() << ",\n"
+                    << "  \"simd\": \"" << simdLevelName(getSimdLevel()) << "\",\n"
+                    << "  \"reversed_z\": " << (isReversedZ() ? "true" : "false") << ",\n"
+                    << "  \"culling\": \"" << (options.gpuCulling && renderer.isGpuCullingAvailable() ? "gpu" : "cpu")
+                    << "\",\n"
+                    << "  \"load_ms\": " << loadMs << ",\n"
+                    << "  \"prepare_ms\": " << timings.prepareMs << ",\n"
+                    << "  \"upload_ms\": " << timings.uploadMs << ",\n"
+                    << "  \"upload\": {\"bytes\": " << uploadStats.bytes << ", \"slices\": " << uploadStats.slices
+                    << ", \"fence_wait_ms\": " << uploadStats.fenceWaitMs << ", \"persistent\": "
+                    << (renderer.isPersistentUpload() ? "true" : "false") << "},\n"
+                    << "  \"queries\": {\"index_ms\": " << timings.indexMs << ", \"pick_us\": " << queryTiming.pickUs
+                    << ", \"pick_hits\": " << queryTiming.pickHits << ", \"nearest_us\": " << queryTiming.nearestUs
+                    << ", \"radius_us\": " << queryTiming.radiusUs << ", \"radius_points\": "
+                    << queryTiming.radiusPoints << ", \"samples\": " << QUERY_SAMPLES << "},\n"
+                    << "  \"summary\": {\n";
+                writeSummary(out, "cpu_ms", cpu, true);
+                out << ",\n";
+                writeSummary(out, "gpu_ms", gpu, true);
+                out << ",\n";
+                writeSummary(out, "frame_ms", total, true);
+                out << "\n  },\n  \"frames\": [\n";
+                for (size_t i = 0; i < frames.size(); ++i) {
+                    out << "    {\"frame\": " << i << ", \"cpu_ms\": " << frames[i].cpuMs << ", \"gpu_ms\": "
+                        << frames[i].gpuMs << ", \"frame_ms\": " << frames[i].frameMs << ", \"points_drawn\": "
+                        << frames[i].pointsDrawn << "}" << (i + 1 < frames.size() ? "," : "") << "\n";
+                }
+                out << "  ]\n}\n";
+            } else {
+                out << "# file=" << options.file << ", points=" << renderer.getPointCount() << ", load_ms=" << loadMs
+                    << ", prepare_ms=" << timings.prepareMs << ", upload_ms=" << timings.uploadMs
+                    << ", index_ms=" << timings.indexMs << ", pick_us=" << queryTiming.pickUs << ", nearest_us="
+                    << queryTiming.nearestUs << ", radius_us=" << queryTiming.radiusUs << "\n";
+                out << "frame,cpu_ms,gpu_ms,frame_ms,points_drawn\n";
+                for (size_t i = 0; i < frames.size(); ++i) {
+                    out << i << "," << frames[i].cpuMs << "," << frames[i].gpuMs << "," << frames[i].frameMs << ","
+                        << frames[i].pointsDrawn << "\n";
+                }
+            }
+
+            std::cout << "[Benchmark] " << renderer.getPointCount() << " points, load " << loadMs << " ms (upload "
+                      << timings.uploadMs << " ms), " << frames.size() << " frames" << std::endl;
+            std::cout << "[Benchmark] Upload " << uploadStats.bytes / (1024.0 * 1024.0) << " MiB in "
+                      << uploadStats.slices << " slices ("
+                      << (renderer.isPersistentUpload() ? "persistent staging ring" : "glBufferSubData") << "), "
+                      << uploadStats.fenceWaitMs << " ms waiting for fences" << std::endl;
+            std::cout << "[Benchmark] ";
+            writeSummary(std::cout, "CPU", cpu, false);
+            std::cout << "[Benchmark] ";
+            writeSummary(std::cout, "GPU", gpu, false);
+            std::cout << "[Benchmark] k-d trees built in " << timings.indexMs << " ms, pick " << queryTiming.pickUs
+                      << " us (" << queryTiming.pickHits << " / " << QUERY_SAMPLES << " hit), " << QUERY_NEIGHBOURS
+                      << "-nearest " << queryTiming.nearestUs << " us, radius " << queryTiming.radiusUs << " us ("
+                      << queryTiming.radiusPoints << " points)" << std::endl;
+            std::cout << "[Benchmark] Results written to " << options.output << std::endl;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        glDeleteFramebuffers(1, &framebuffer);
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return exitCode;
+}
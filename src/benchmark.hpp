@@ -0,0 +1,32 @@
+﻿//
+// src/benchmark.hpp
+//
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <string>
+#include "point_loader.hpp"
+
+// Settings of a headless benchmark run (--benchmark).
+struct BenchmarkOptions {
+    std::string file;             // point cloud to load
+    std::string cameraPath;       // keyframe file, empty for an orbit around the cloud
+    std::string output = "benchmark.json";  // .json or .csv
+    int frames = 300;
+    int width = 1280;
+    int height = 720;
+    float pointSize = 2.0f;
+    bool gpuCulling = true;       // cull with the compute shader where supported
+    bool reversedZ = true;        // reversed-Z depth where supported (see depth_range.hpp)
+    LoadOptions loadOptions;
+};
+
+// Render 'frames' frames into an offscreen framebuffer of an invisible window, following the
+// camera path, and write load, upload and per-frame CPU/GPU times to options.output.
+// If no window can be created (no display), GLFW's null platform with OSMesa is tried, which
+// together with Mesa's llvmpipe needs no GPU at all.
+// Returns the process exit code.
+int runBenchmark(const BenchmarkOptions& options);
+
+#endif // BENCHMARK_HPP
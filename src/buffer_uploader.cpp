@@ -0,0 +1,107 @@
+﻿//
+// src/buffer_uploader.cpp
+//
+
+#include "buffer_uploader.hpp"
+#include "gl_extensions.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+BufferUploader::BufferUploader(size_t sliceBytes, unsigned slotCount)
+    : sliceBytes(sliceBytes), slotCount(std::max(slotCount, 1u)), fences(this->slotCount, nullptr)
+{
+}
+
+BufferUploader::~BufferUploader()
+{
+    for (GLsync &fence : fences) {
+        if (fence)
+            glDeleteSync(fence);
+    }
+    if (staging) {
+        glBindBuffer(GL_COPY_READ_BUFFER, staging);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &staging);
+    }
+}
+
+void BufferUploader::createRing()
+{
+    initialized = true;
+    const GlExtensions &ext = glExtensions();
+    if (!ext.bufferStorage)
+        return;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr ringBytes = static_cast<GLsizeiptr>(sliceBytes * slotCount);
+    glGenBuffers(1, &staging);
+    glBindBuffer(GL_COPY_READ_BUFFER, staging);
+    ext.BufferStorage(GL_COPY_READ_BUFFER, ringBytes, nullptr, flags);
+    mapping = static_cast<char*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, ringBytes, flags));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    if (!mapping) {
+        // Fall back to glBufferSubData.
+        glDeleteBuffers(1, &staging);
+        staging = 0;
+    }
+}
+
+void BufferUploader::waitForSlot(unsigned slot)
+{
+    GLsync &fence = fences[slot];
+    if (!fence)
+        return;
+    auto start = std::chrono::steady_clock::now();
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (true) {
+        GLenum result = glClientWaitSync(fence, flags, 1000000000ull);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+            break;
+        flags = 0;
+    }
+    stats.fenceWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void BufferUploader::upload(GLuint buffer, size_t offset, const void *data, size_t size)
+{
+    if (!initialized)
+        createRing();
+
+    const char *src = static_cast<const char*>(data);
+    if (mapping) {
+        glBindBuffer(GL_COPY_READ_BUFFER, staging);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    }
+
+    for (size_t done = 0; done < size;) {
+        size_t bytes = std::min(sliceBytes, size - done);
+        if (mapping) {
+            unsigned slot = nextSlot;
+            nextSlot = (nextSlot + 1) % slotCount;
+            waitForSlot(slot);
+            std::memcpy(mapping + slot * sliceBytes, src + done, bytes);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(slot * sliceBytes),
+                                static_cast<GLintptr>(offset + done), static_cast<GLsizeiptr>(bytes));
+            fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        } else {
+            glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(offset + done), static_cast<GLsizeiptr>(bytes),
+                            src + done);
+        }
+        done += bytes;
+        stats.bytes += bytes;
+        ++stats.slices;
+    }
+
+    if (mapping) {
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
@@ -0,0 +1,57 @@
+﻿//
+// src/buffer_uploader.hpp
+//
+
+#ifndef BUFFER_UPLOADER_HPP
+#define BUFFER_UPLOADER_HPP
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+
+// Copies vertex data into GL buffers in fixed-size slices instead of one big glBufferData.
+//
+// With buffer storage (GL 4.4 / ARB_buffer_storage) the slices go through a ring of staging
+// slots in one persistently mapped buffer: wait for the slot's fence, memcpy into the mapping,
+// glCopyBufferSubData into the target and fence the slot again. The driver never has to
+// allocate or copy the whole upload at once. Without buffer storage every slice is written
+// with glBufferSubData.
+class BufferUploader {
+public:
+    struct Stats {
+        size_t bytes = 0;
+        size_t slices = 0;
+        double fenceWaitMs = 0.0;   // time spent waiting for staging slots to become free
+    };
+
+    explicit BufferUploader(size_t sliceBytes = size_t(8) << 20, unsigned slotCount = 4);
+    ~BufferUploader();
+
+    BufferUploader(const BufferUploader&) = delete;
+    BufferUploader& operator=(const BufferUploader&) = delete;
+
+    // Copy 'size' bytes from 'data' to 'offset' in 'buffer'.
+    void upload(GLuint buffer, size_t offset, const void* data, size_t size);
+
+    // True if the persistent staging ring is used, false for plain glBufferSubData.
+    bool isPersistent() const { return mapping != nullptr; }
+
+    const Stats& getStats() const { return stats; }
+    void resetStats() { stats = Stats(); }
+
+private:
+    void createRing();
+    // Wait until the GPU is done reading from 'slot'.
+    void waitForSlot(unsigned slot);
+
+    size_t sliceBytes;
+    unsigned slotCount;
+    bool initialized = false;
+    GLuint staging = 0;
+    char* mapping = nullptr;
+    std::vector<GLsync> fences;
+    unsigned nextSlot = 0;
+    Stats stats;
+};
+
+#endif // BUFFER_UPLOADER_HPP
@@ -2,13 +2,15 @@
 // src/camera.cpp
 #include "camera.hpp"
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
 #include <cmath>
 
 Camera::Camera(glm::vec3 position, glm::vec3 up, float yaw, float pitch)
     : Front(glm::vec3(0.0f, 0.0f, -1.0f)),
       MovementSpeed(SPEED),
       MouseSensitivity(SENSITIVITY),
-      Zoom(ZOOM)
+      Zoom(ZOOM),
+      CameraRelative(false)
 {
     Position = position;
     WorldUp = up;
@@ -22,6 +24,18 @@ glm::mat4 Camera::GetViewMatrix()
     return glm::lookAt(Position, Position + Front, Up);
 }
 
+glm::mat4 Camera::GetRenderViewMatrix()
+{
+    if (!CameraRelative)
+        return GetViewMatrix();
+    return glm::lookAt(glm::vec3(0.0f), Front, Up);
+}
+
+glm::dvec3 Camera::GetRenderOrigin() const
+{
+    return CameraRelative ? glm::dvec3(Position) : glm::dvec3(0.0);
+}
+
 void Camera::ProcessKeyboard(Camera_Movement direction, float deltaTime)
 {
     float velocity = MovementSpeed * deltaTime;
@@ -64,6 +78,15 @@ void Camera::ProcessMouseScroll(float yoffset)
         Zoom = 45.0f;
 }
 
+void Camera::Frame(const glm::vec3& center, float radius, float aspect)
+{
+    // Half of the narrower of the vertical and horizontal field of view.
+    float tanHalf = std::tan(glm::radians(Zoom) * 0.5f) * std::min(aspect, 1.0f);
+    float distance = radius * std::sqrt(1.0f + 1.0f / (tanHalf * tanHalf));
+    Position = center - Front * distance;
+    MovementSpeed = glm::clamp(radius * 0.25f, MIN_SPEED, MAX_SPEED);
+}
+
 void Camera::updateCameraVectors()
 {
     glm::vec3 front;
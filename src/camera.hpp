@@ -19,6 +19,9 @@ const float PITCH       =  0.0f;
 const float SPEED       =  2.5f;
 const float SENSITIVITY =  0.1f;
 const float ZOOM        =  45.0f;
+// Movement speed limits, wide enough for clouds from millimetres to kilometres across.
+const float MIN_SPEED   =  0.01f;
+const float MAX_SPEED   =  10000.0f;
 
 class Camera {
 public:
@@ -35,15 +38,25 @@ public:
     float MovementSpeed;
     float MouseSensitivity;
     float Zoom;
+    // Render relative to the camera: the geometry is moved by -Position in double precision
+    // and the view only rotates, so points far from the origin keep their float precision.
+    bool CameraRelative;
 
     Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 3.0f),
            glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f),
            float yaw = YAW, float pitch = PITCH);
 
     glm::mat4 GetViewMatrix();
+    // View matrix to render with: GetViewMatrix(), or only its rotation with CameraRelative.
+    glm::mat4 GetRenderViewMatrix();
+    // What the renderers subtract from the geometry for GetRenderViewMatrix(), zero unless CameraRelative.
+    glm::dvec3 GetRenderOrigin() const;
     void ProcessKeyboard(Camera_Movement direction, float deltaTime);
     void ProcessMouseMovement(float xoffset, float yoffset, bool constrainPitch = true);
     void ProcessMouseScroll(float yoffset);
+    // Move back along the view direction until the sphere fills the view, and scale the movement
+    // speed to its size. 'aspect' is the width over the height of the view.
+    void Frame(const glm::vec3& center, float radius, float aspect);
 
 private:
     void updateCameraVectors();
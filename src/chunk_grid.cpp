@@ -0,0 +1,131 @@
+﻿//
+// src/chunk_grid.cpp
+//
+
+#include "chunk_grid.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+void ChunkGrid::clear()
+{
+    for (std::vector<float> *bounds : {&minX, &minY, &minZ, &maxX, &maxY, &maxZ})
+        bounds->clear();
+    first.clear();
+    count.clear();
+}
+
+bool buildChunkGrid(std::vector<Point> &points, ChunkGrid &grid, size_t chunkPoints)
+{
+    grid.clear();
+    if (points.empty())
+        return false;
+
+    // Cubic cells sized so an evenly filled grid has about 'chunkPoints' points per cell.
+    // Flat clouds get a minimum thickness so the cell size does not collapse to zero.
+    Bounds bounds = computeBounds(points);
+    glm::vec3 extent = bounds.extent();
+    float largest = std::max({extent.x, extent.y, extent.z, 1e-6f});
+    extent = glm::max(extent, glm::vec3(largest * 1e-3f));
+    double cells = std::max<double>(1.0, double(points.size()) / chunkPoints);
+    float cellSize = static_cast<float>(std::cbrt(double(extent.x) * extent.y * extent.z / cells));
+    uint32_t dims[3];
+    for (int i = 0; i < 3; ++i)
+        dims[i] = static_cast<uint32_t>(std::clamp(std::ceil(extent[i] / cellSize), 1.0f, 1024.0f));
+    const glm::vec3 scale = glm::vec3(float(dims[0]), float(dims[1]), float(dims[2])) / extent;
+
+    std::vector<uint32_t> cellOf(points.size());
+    ThreadPool::instance().parallelFor(0, points.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            glm::vec3 cell = (points[i].position - bounds.min) * scale;
+            uint32_t x = std::min(static_cast<uint32_t>(std::max(cell.x, 0.0f)), dims[0] - 1);
+            uint32_t y = std::min(static_cast<uint32_t>(std::max(cell.y, 0.0f)), dims[1] - 1);
+            uint32_t z = std::min(static_cast<uint32_t>(std::max(cell.z, 0.0f)), dims[2] - 1);
+            cellOf[i] = (z * dims[1] + y) * dims[0] + x;
+        }
+    }, 1 << 16);
+
+    // Counting sort by cell.
+    std::vector<uint32_t> offsets(size_t(dims[0]) * dims[1] * dims[2] + 1, 0);
+    for (uint32_t cell : cellOf)
+        ++offsets[cell + 1];
+    for (size_t i = 1; i < offsets.size(); ++i)
+        offsets[i] += offsets[i - 1];
+
+    bool sorted = std::is_sorted(cellOf.begin(), cellOf.end());
+    if (!sorted) {
+        std::vector<Point> ordered(points.size());
+        std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < points.size(); ++i)
+            ordered[next[cellOf[i]]++] = points[i];
+        points.swap(ordered);
+    }
+
+    for (size_t cell = 0; cell + 1 < offsets.size(); ++cell) {
+        if (offsets[cell + 1] == offsets[cell])
+            continue;
+        grid.first.push_back(static_cast<int32_t>(offsets[cell]));
+        grid.count.push_back(static_cast<int32_t>(offsets[cell + 1] - offsets[cell]));
+    }
+
+    // Tight bounds of the points in each chunk.
+    const size_t chunks = grid.size();
+    for (std::vector<float> *values : {&grid.minX, &grid.minY, &grid.minZ, &grid.maxX, &grid.maxY, &grid.maxZ})
+        values->resize(chunks);
+    ThreadPool::instance().parallelFor(0, chunks, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            Bounds box{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+            for (int32_t i = grid.first[c]; i < grid.first[c] + grid.count[c]; ++i) {
+                box.min = glm::min(box.min, points[i].position);
+                box.max = glm::max(box.max, points[i].position);
+            }
+            grid.minX[c] = box.min.x; grid.minY[c] = box.min.y; grid.minZ[c] = box.min.z;
+            grid.maxX[c] = box.max.x; grid.maxY[c] = box.max.y; grid.maxZ[c] = box.max.z;
+        }
+    }, 64);
+    return !sorted;
+}
+
+void shuffleChunks(std::vector<Point> &points, const ChunkGrid &grid)
+{
+    ThreadPool::instance().parallelFor(0, grid.size(), [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            std::mt19937 random(static_cast<uint32_t>(c));
+            std::shuffle(points.begin() + grid.first[c], points.begin() + grid.first[c] + grid.count[c], random);
+        }
+    }, 16);
+}
+
+size_t cullChunks(const ChunkGrid &grid, const Frustum &frustum, std::vector<uint8_t> &visible)
+{
+    visible.resize(grid.size());
+    return cullChunks(grid, frustum, visible, 0, grid.size());
+}
+
+size_t cullChunks(const ChunkGrid &grid, const Frustum &frustum, std::vector<uint8_t> &visible, size_t begin,
+                  size_t end)
+{
+    const size_t chunks = end - begin;
+    std::fill(visible.begin() + begin, visible.begin() + end, uint8_t(1));
+    const float *minX = grid.minX.data() + begin, *minY = grid.minY.data() + begin, *minZ = grid.minZ.data() + begin;
+    const float *maxX = grid.maxX.data() + begin, *maxY = grid.maxY.data() + begin, *maxZ = grid.maxZ.data() + begin;
+    uint8_t *out = visible.data() + begin;
+
+    // Same test as intersects(), one plane at a time over all chunks. The furthest corner
+    // along the plane normal is picked with max() per axis, which keeps the loop branch-free.
+    for (const glm::vec4 &plane : frustum.planes) {
+        const float a = plane.x, b = plane.y, c = plane.z, d = plane.w;
+        for (size_t i = 0; i < chunks; ++i) {
+            float distance = std::max(a * minX[i], a * maxX[i]) + std::max(b * minY[i], b * maxY[i]) +
+                             std::max(c * minZ[i], c * maxZ[i]) + d;
+            out[i] &= static_cast<uint8_t>(distance >= 0.0f);
+        }
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < chunks; ++i)
+        count += out[i];
+    return count;
+}
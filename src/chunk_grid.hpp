@@ -0,0 +1,47 @@
+﻿//
+// src/chunk_grid.hpp
+//
+
+#ifndef CHUNK_GRID_HPP
+#define CHUNK_GRID_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "frustum.hpp"
+#include "point.hpp"
+
+// Spatial chunks of a point cloud whose points are stored grouped by chunk, so every chunk
+// is one contiguous range of the vertex buffer. The chunk bounds are kept as separate
+// arrays so culling runs as straight loops the compiler can vectorize.
+struct ChunkGrid {
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+    std::vector<int32_t> first;   // index of the first point of each chunk
+    std::vector<int32_t> count;   // number of points in each chunk
+
+    size_t size() const { return first.size(); }
+    void clear();
+};
+
+// Target number of points per chunk.
+constexpr size_t DEFAULT_CHUNK_POINTS = 16384;
+
+// Sort 'points' into the cells of a uniform grid over their bounds and describe the
+// non-empty cells in 'grid'. The sort is stable, so calling it again on sorted points
+// gives the same order. Returns true if the points had to be moved.
+bool buildChunkGrid(std::vector<Point>& points, ChunkGrid& grid, size_t chunkPoints = DEFAULT_CHUNK_POINTS);
+
+// Shuffle the points inside each chunk of 'grid', so any slice of a chunk's range is an even
+// random subset of it (used for progressive rendering). Seeded per chunk, so the order is the same
+// on every run. Runs on the thread pool.
+void shuffleChunks(std::vector<Point>& points, const ChunkGrid& grid);
+
+// Set visible[i] to 1 for every chunk that intersects the frustum and to 0 otherwise.
+// Returns the number of visible chunks.
+size_t cullChunks(const ChunkGrid& grid, const Frustum& frustum, std::vector<uint8_t>& visible);
+// The same for the chunks in [begin, end) only. 'visible' must have an entry for every chunk.
+size_t cullChunks(const ChunkGrid& grid, const Frustum& frustum, std::vector<uint8_t>& visible, size_t begin,
+                  size_t end);
+
+#endif // CHUNK_GRID_HPP
@@ -0,0 +1,107 @@
+﻿//
+// src/compact_vertex.cpp
+//
+
+#include "compact_vertex.hpp"
+#include "simd_kernels.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Points converted by the SIMD kernels at a time, small enough for buffers on the stack.
+constexpr size_t PACK_BATCH = 1024;
+
+uint16_t quantizeUnorm16(float value)
+{
+    return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+int16_t quantizeSnorm16(float value)
+{
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+// Pack the 'n' (at most PACK_BATCH) points given by their component arrays.
+void packBatch(const PointArrays &points, size_t source, size_t n, const Bounds &bounds, float invDiagonal,
+               CompactPoint *packed)
+{
+    float unitX[PACK_BATCH], unitY[PACK_BATCH], unitZ[PACK_BATCH];
+    uint32_t rgba[PACK_BATCH];
+    normalizeToUnitCube(points.x.data() + source, points.y.data() + source, points.z.data() + source, n, bounds,
+                        unitX, unitY, unitZ);
+    packColors(points.r.data() + source, points.g.data() + source, points.b.data() + source, n, rgba);
+    for (size_t i = 0; i < n; ++i) {
+        CompactPoint &out = packed[i];
+        out.position[0] = quantizeUnorm16(unitX[i]);
+        out.position[1] = quantizeUnorm16(unitY[i]);
+        out.position[2] = quantizeUnorm16(unitZ[i]);
+        out.position[3] = quantizeUnorm16(std::sqrt(points.radius[source + i] * invDiagonal));
+        for (int c = 0; c < 4; ++c)
+            out.color[c] = static_cast<uint8_t>(rgba[i] >> (8 * c));
+        glm::vec2 octa = octahedralEncode(points.normal(source + i));
+        out.normal[0] = quantizeSnorm16(octa.x);
+        out.normal[1] = quantizeSnorm16(octa.y);
+    }
+}
+
+float inverseDiagonal(const Bounds &bounds)
+{
+    const float diagonal = glm::length(bounds.extent());
+    return diagonal > 0.0f ? 1.0f / diagonal : 0.0f;
+}
+
+} // namespace
+
+std::vector<VertexAttribute> compactPointLayout()
+{
+    return {
+        {LOCATION_POSITION, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(CompactPoint, position), sizeof(CompactPoint)},
+        {LOCATION_COLOR,    4, GL_UNSIGNED_BYTE,  GL_TRUE, offsetof(CompactPoint, color),    sizeof(CompactPoint)},
+        {LOCATION_NORMAL,   2, GL_SHORT,          GL_TRUE, offsetof(CompactPoint, normal),   sizeof(CompactPoint)},
+        {LOCATION_RADIUS,   1, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(CompactPoint, position) + 3 * sizeof(uint16_t),
+         sizeof(CompactPoint)},
+    };
+}
+
+glm::vec2 octahedralEncode(const glm::vec3 &normal)
+{
+    float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (l1 <= 0.0f)
+        return glm::vec2(0.0f);
+    glm::vec2 e(normal.x / l1, normal.y / l1);
+    // Fold the lower hemisphere over the diagonals.
+    if (normal.z < 0.0f) {
+        glm::vec2 folded((1.0f - std::abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+                         (1.0f - std::abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+        e = folded;
+    }
+    return e;
+}
+
+void packCompactPoints(const std::vector<Point> &points, const Bounds &bounds, std::vector<CompactPoint> &packed)
+{
+    // Split one batch at a time rather than the whole vector, so no second copy of the points is made.
+    const float invDiagonal = inverseDiagonal(bounds);
+    packed.resize(points.size());
+    ThreadPool::instance().parallelFor(0, points.size(), [&](size_t begin, size_t end) {
+        PointArrays batchArrays;
+        batchArrays.resize(PACK_BATCH);
+        for (size_t batch = begin; batch < end; batch += PACK_BATCH) {
+            const size_t n = std::min(PACK_BATCH, end - batch);
+            splitPoints(points.data() + batch, n, batchArrays, 0);
+            packBatch(batchArrays, 0, n, bounds, invDiagonal, packed.data() + batch);
+        }
+    }, 1 << 16);
+}
+
+void packCompactPoints(const PointArrays &points, size_t first, size_t count, const Bounds &bounds,
+                       CompactPoint *packed)
+{
+    const float invDiagonal = inverseDiagonal(bounds);
+    ThreadPool::instance().parallelFor(0, count, [&](size_t begin, size_t end) {
+        for (size_t batch = begin; batch < end; batch += PACK_BATCH)
+            packBatch(points, first + batch, std::min(PACK_BATCH, end - batch), bounds, invDiagonal, packed + batch);
+    }, 1 << 16);
+}
@@ -0,0 +1,45 @@
+﻿//
+// src/compact_vertex.hpp
+//
+
+#ifndef COMPACT_VERTEX_HPP
+#define COMPACT_VERTEX_HPP
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "point.hpp"
+#include "point_arrays.hpp"
+#include "vertex_layout.hpp"
+
+// GPU vertex formats the renderer can upload.
+enum class VertexFormat {
+    Full,    // Point as is: 10 floats, 40 bytes per point
+    Compact  // CompactPoint: 16 bytes per point
+};
+
+// 16-byte vertex: positions quantized to 16 bits per axis relative to the cloud bounds,
+// RGBA8 color and an octahedral-encoded normal in two signed 16-bit values. The fourth
+// position component holds sqrt(radius / bounds diagonal), which keeps small radii precise.
+// Decoded in shaders/point_cloud.vs.
+struct CompactPoint {
+    uint16_t position[4]; // xyz, w is the encoded radius
+    uint8_t color[4];     // rgba
+    int16_t normal[2];    // octahedral encoding in [-1,1]
+};
+static_assert(sizeof(CompactPoint) == 16, "CompactPoint must stay 16 bytes");
+
+// Layout of a std::vector<CompactPoint> uploaded as is.
+std::vector<VertexAttribute> compactPointLayout();
+
+// Quantize 'points' against 'bounds' on the thread pool.
+void packCompactPoints(const std::vector<Point>& points, const Bounds& bounds, std::vector<CompactPoint>& packed);
+// Quantize the points [first, first + count) of 'points' against 'bounds' into packed[0, count),
+// on the thread pool. Positions and colors are converted with the SIMD kernels.
+void packCompactPoints(const PointArrays& points, size_t first, size_t count, const Bounds& bounds,
+                       CompactPoint* packed);
+
+// Octahedral normal encoding into [-1,1]^2. Zero-length normals encode to (0,0).
+glm::vec2 octahedralEncode(const glm::vec3& normal);
+
+#endif // COMPACT_VERTEX_HPP
@@ -0,0 +1,94 @@
+﻿//
+// src/debug_draw.cpp
+//
+
+#include "debug_draw.hpp"
+#include "vertex_layout.hpp"
+#include <algorithm>
+
+DebugDraw::~DebugDraw()
+{
+    if (VBO)
+        glDeleteBuffers(1, &VBO);
+    if (VAO)
+        glDeleteVertexArrays(1, &VAO);
+}
+
+void DebugDraw::point(const glm::vec3 &position, const glm::vec3 &color, float size)
+{
+    points.push_back({position, color, size});
+}
+
+void DebugDraw::line(const glm::vec3 &from, const glm::vec3 &to, const glm::vec3 &color)
+{
+    lines.push_back({from, color, 1.0f});
+    lines.push_back({to, color, 1.0f});
+}
+
+void DebugDraw::box(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &color)
+{
+    box(min, max, color, glm::mat4(1.0f));
+}
+
+void DebugDraw::box(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &color, const glm::mat4 &transform)
+{
+    glm::vec3 corner[8];
+    for (int i = 0; i < 8; ++i)
+        corner[i] = glm::vec3(transform * glm::vec4(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y,
+                                                    i & 4 ? max.z : min.z, 1.0f));
+    // Corners that differ in exactly one coordinate bit are joined by an edge.
+    for (int i = 0; i < 8; ++i) {
+        for (int bit = 1; bit < 8; bit <<= 1) {
+            if (!(i & bit))
+                line(corner[i], corner[i | bit], color);
+        }
+    }
+}
+
+void DebugDraw::flush(const glm::vec3 &origin)
+{
+    if (points.empty() && lines.empty())
+        return;
+    if (origin != glm::vec3(0.0f)) {
+        for (Vertex &vertex : points)
+            vertex.position -= origin;
+        for (Vertex &vertex : lines)
+            vertex.position -= origin;
+    }
+
+    if (!VAO) {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        // Locations as in shaders/marker.vs.
+        applyVertexLayout({
+            {0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position), sizeof(Vertex)},
+            {1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, color),    sizeof(Vertex)},
+            {2, 1, GL_FLOAT, GL_FALSE, offsetof(Vertex, size),     sizeof(Vertex)},
+        });
+    } else {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    }
+
+    // Orphan the storage of the last frame, so the upload never waits for its draw.
+    const size_t pointBytes = points.size() * sizeof(Vertex);
+    const size_t lineBytes = lines.size() * sizeof(Vertex);
+    capacity = std::max({capacity, pointBytes + lineBytes, size_t(4096)});
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(capacity), nullptr, GL_STREAM_DRAW);
+    if (pointBytes)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(pointBytes), points.data());
+    if (lineBytes)
+        glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(pointBytes), static_cast<GLsizeiptr>(lineBytes),
+                        lines.data());
+
+    if (!points.empty())
+        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(points.size()));
+    if (!lines.empty())
+        glDrawArrays(GL_LINES, static_cast<GLint>(points.size()), static_cast<GLsizei>(lines.size()));
+    glBindVertexArray(0);
+
+    points.clear();
+    lines.clear();
+}
@@ -0,0 +1,54 @@
+﻿//
+// src/debug_draw.hpp
+//
+
+#ifndef DEBUG_DRAW_HPP
+#define DEBUG_DRAW_HPP
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Immediate-mode drawing of points, lines and boxes for markers and diagnostics.
+//
+// Shapes are queued during the frame and flush() writes all of them into one dynamic vertex
+// buffer with a single upload, then draws the points and the lines from it. The VAO and the
+// buffer are created once and reused; the buffer only grows. Draw with shaders/marker.*.
+class DebugDraw {
+public:
+    struct Vertex {
+        glm::vec3 position;
+        glm::vec3 color;
+        float size;   // point size in pixels, unused for lines
+    };
+
+    DebugDraw() = default;
+    ~DebugDraw();
+
+    DebugDraw(const DebugDraw&) = delete;
+    DebugDraw& operator=(const DebugDraw&) = delete;
+
+    void point(const glm::vec3& position, const glm::vec3& color, float size = 1.0f);
+    void line(const glm::vec3& from, const glm::vec3& to, const glm::vec3& color);
+    // The 12 edges of an axis-aligned box.
+    void box(const glm::vec3& min, const glm::vec3& max, const glm::vec3& color);
+    // The same box with its corners transformed by 'transform', e.g. a box in tile coordinates.
+    void box(const glm::vec3& min, const glm::vec3& max, const glm::vec3& color, const glm::mat4& transform);
+
+    // Upload and draw everything queued since the last flush, then clear the queue.
+    // 'origin' is subtracted from all positions, for camera-relative rendering.
+    // The marker shader must be in use.
+    void flush(const glm::vec3& origin = glm::vec3(0.0f));
+
+    size_t getVertexCount() const { return points.size() + lines.size(); }
+
+private:
+    std::vector<Vertex> points;
+    std::vector<Vertex> lines;
+    GLuint VAO = 0;
+    GLuint VBO = 0;
+    size_t capacity = 0;   // allocated size of VBO in bytes
+};
+
+#endif // DEBUG_DRAW_HPP
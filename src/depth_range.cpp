@@ -0,0 +1,155 @@
+﻿//
+// src/depth_range.cpp
+//
+
+#include "depth_range.hpp"
+#include "gl_extensions.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+// Smallest near plane as a fraction of the far plane. A float depth buffer with reversed-Z keeps
+// its precision down to a tiny ratio, a fixed-point one with the default mapping does not.
+constexpr float MIN_NEAR_RATIO_REVERSED = 1e-6f;
+constexpr float MIN_NEAR_RATIO = 1e-4f;
+// Both planes are moved out by this fraction, so points right on the bounds are not clipped.
+constexpr float DEPTH_MARGIN = 0.01f;
+
+bool reversedZ = false;
+
+} // namespace
+
+bool enableReversedZ()
+{
+    if (!glExtensions().clipControl)
+        return false;
+    glExtensions().ClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+    glClearDepth(0.0);
+    glDepthFunc(GL_GREATER);
+    reversedZ = true;
+    std::cout << "[Depth] Reversed-Z with a float depth buffer" << std::endl;
+    return true;
+}
+
+bool isReversedZ()
+{
+    return reversedZ;
+}
+
+GLenum depthFunction()
+{
+    return reversedZ ? GL_GREATER : GL_LESS;
+}
+
+float farDepth()
+{
+    return reversedZ ? 0.0f : 1.0f;
+}
+
+DepthRange fitDepthRange(const Bounds &box, const BoundingSphere &sphere, const glm::mat4 &view)
+{
+    if (sphere.radius <= 0.0f && box.extent() == glm::vec3(0.0f))
+        return DepthRange();
+
+    // Distances along the view direction of the box corners, then limited further by the sphere.
+    float nearest = std::numeric_limits<float>::max(), farthest = std::numeric_limits<float>::lowest();
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 corner(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+        float depth = -(view * glm::vec4(corner, 1.0f)).z;
+        nearest = std::min(nearest, depth);
+        farthest = std::max(farthest, depth);
+    }
+    if (sphere.radius > 0.0f) {
+        float depth = -(view * glm::vec4(sphere.center, 1.0f)).z;
+        nearest = std::max(nearest, depth - sphere.radius);
+        farthest = std::min(farthest, depth + sphere.radius);
+    }
+    // Everything is behind the camera.
+    if (farthest <= 0.0f)
+        return DepthRange();
+
+    DepthRange range;
+    range.farPlane = farthest * (1.0f + DEPTH_MARGIN);
+    const float minNear = range.farPlane * (reversedZ ? MIN_NEAR_RATIO_REVERSED : MIN_NEAR_RATIO);
+    range.nearPlane = std::max(nearest * (1.0f - DEPTH_MARGIN), minNear);
+    return range;
+}
+
+glm::mat4 perspectiveProjection(float fovy, float aspect, const DepthRange &range)
+{
+    if (!reversedZ)
+        return glm::perspective(fovy, aspect, range.nearPlane, range.farPlane);
+
+    // Maps the near plane to depth 1 and the far plane to 0, with clip control set to [0, 1].
+    const float n = range.nearPlane, f = range.farPlane;
+    const float tanHalf = std::tan(fovy * 0.5f);
+    glm::mat4 projection(0.0f);
+    projection[0][0] = 1.0f / (aspect * tanHalf);
+    projection[1][1] = 1.0f / tanHalf;
+    projection[2][2] = n / (f - n);
+    projection[2][3] = -1.0f;
+    projection[3][2] = f * n / (f - n);
+    return projection;
+}
+
+SceneFramebuffer::~SceneFramebuffer()
+{
+    release();
+}
+
+void SceneFramebuffer::release()
+{
+    if (framebuffer) {
+        glDeleteFramebuffers(1, &framebuffer);
+        GLuint renderbuffers[] = {colorBuffer, depthBuffer};
+        glDeleteRenderbuffers(2, renderbuffers);
+        framebuffer = colorBuffer = depthBuffer = 0;
+    }
+    width = height = 0;
+}
+
+bool SceneFramebuffer::bind(int newWidth, int newHeight)
+{
+    if (newWidth <= 0 || newHeight <= 0) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return false;
+    }
+    if (newWidth != width || newHeight != height) {
+        release();
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &colorBuffer);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, newWidth, newHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, newWidth, newHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "[Depth] Scene framebuffer is incomplete" << std::endl;
+            release();
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return false;
+        }
+        width = newWidth;
+        height = newHeight;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    return true;
+}
+
+void SceneFramebuffer::present() const
+{
+    if (!framebuffer)
+        return;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,69 @@
+﻿//
+// src/depth_range.hpp
+//
+
+#ifndef DEPTH_RANGE_HPP
+#define DEPTH_RANGE_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "point.hpp"
+
+// Near and far planes fitted to the cloud every frame, and the depth convention all passes use.
+//
+// With GL 4.5 or ARB_clip_control the depth is reversed: clip-space depth runs from 1 at the near
+// plane to 0 at the far plane, and is stored in a float depth buffer. The exponent of the float
+// then cancels the 1/z of the projection, so precision stays even over the whole range and the
+// near plane can sit very close to the camera without the far points fighting. Otherwise the GL
+// default of [-1, 1] with GL_LESS is kept.
+
+// Distances of the near and far plane from the camera.
+struct DepthRange {
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+};
+
+// Switch to reversed-Z if the driver supports it: clip control, depth test and cleared depth.
+// Needs a current context and loadGlExtensions().
+bool enableReversedZ();
+bool isReversedZ();
+// The depth test of the convention in use: GL_GREATER with reversed-Z, GL_LESS otherwise.
+GLenum depthFunction();
+// Depth buffer value of the far plane, which the depth buffer is cleared to: 0 or 1.
+float farDepth();
+
+// The tightest range around 'box' and 'sphere' (world space) seen with 'view'. The near plane is
+// kept at a minimum fraction of the far plane, smaller with reversed-Z. Gives the default range
+// while nothing is loaded.
+DepthRange fitDepthRange(const Bounds& box, const BoundingSphere& sphere, const glm::mat4& view);
+
+// Perspective projection for the convention in use, 'fovy' in radians.
+glm::mat4 perspectiveProjection(float fovy, float aspect, const DepthRange& range);
+
+// Offscreen color and float depth buffer for the scene, as the default framebuffer of the window
+// only has fixed-point depth. Used while reversed-Z is on, and copied to the window each frame.
+class SceneFramebuffer {
+public:
+    SceneFramebuffer() = default;
+    ~SceneFramebuffer();
+
+    SceneFramebuffer(const SceneFramebuffer&) = delete;
+    SceneFramebuffer& operator=(const SceneFramebuffer&) = delete;
+
+    // Bind the framebuffer, (re)created at the given size. Binds the default framebuffer instead
+    // and returns false if it cannot be created.
+    bool bind(int width, int height);
+    // Copy the color into the default framebuffer and bind that, e.g. before drawing the UI.
+    void present() const;
+
+private:
+    void release();
+
+    GLuint framebuffer = 0;
+    GLuint colorBuffer = 0;
+    GLuint depthBuffer = 0;
+    int width = 0;
+    int height = 0;
+};
+
+#endif // DEPTH_RANGE_HPP
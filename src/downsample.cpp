@@ -0,0 +1,220 @@
+﻿//
+// src/downsample.cpp
+//
+
+#include "downsample.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+// Cell coordinates are packed into a 64-bit key with this many bits per axis.
+constexpr uint32_t AXIS_BITS = 21;
+constexpr uint32_t AXIS_CELLS = 1u << AXIS_BITS;
+// The cells are hashed into this many partitions, each sorted and reduced by one task.
+constexpr size_t PARTITIONS = 256;
+constexpr size_t BLOCK_POINTS = 1 << 16;
+// Steps of the budget search after the voxel size has been bracketed within a factor of 2.
+constexpr int BUDGET_BISECTIONS = 6;
+
+struct VoxelEntry {
+    uint64_t key;
+    size_t index;       // the entry is padded to 16 bytes anyway, so clouds past 4G points cost nothing extra
+
+    bool operator<(const VoxelEntry &other) const
+    {
+        return key != other.key ? key < other.key : index < other.index;
+    }
+};
+
+// Points grouped by cell. Partition p is entries[start[p], start[p + 1]), sorted by cell key,
+// so the points of one cell are a contiguous run in file order.
+struct VoxelGroups {
+    std::vector<VoxelEntry> entries;
+    std::vector<size_t> start;
+};
+
+float clampVoxelSize(const Bounds &bounds, float voxelSize)
+{
+    glm::vec3 extent = bounds.extent();
+    float largest = std::max({extent.x, extent.y, extent.z, 1e-6f});
+    return std::max(voxelSize, largest / static_cast<float>(AXIS_CELLS - 1));
+}
+
+// Cell along one axis, clamped in float so the conversion is always defined: NaN and negative
+// offsets go to the first cell, offsets past the grid to the last one.
+uint64_t axisCell(float offset)
+{
+    if (!(offset > 0.0f))
+        return 0;
+    return offset < static_cast<float>(AXIS_CELLS - 1) ? static_cast<uint64_t>(offset) : AXIS_CELLS - 1;
+}
+
+uint64_t voxelKey(const glm::vec3 &position, const Bounds &bounds, float inverseSize)
+{
+    glm::vec3 cell = (position - bounds.min) * inverseSize;
+    return (axisCell(cell.z) << (2 * AXIS_BITS)) | (axisCell(cell.y) << AXIS_BITS) | axisCell(cell.x);
+}
+
+size_t partitionOf(uint64_t key)
+{
+    // Fibonacci hashing, the top 8 bits pick one of the 256 partitions.
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 56);
+}
+
+// Hash every point into its cell and group the points by cell: a counting pass per block of
+// points, a scatter into the partitions and a sort of each partition, all on the thread pool.
+void groupByVoxel(const std::vector<Point> &points, const Bounds &bounds, float voxelSize, VoxelGroups &groups)
+{
+    const size_t n = points.size();
+    const size_t blocks = (n + BLOCK_POINTS - 1) / BLOCK_POINTS;
+    const float inverseSize = 1.0f / voxelSize;
+    ThreadPool &pool = ThreadPool::instance();
+
+    std::vector<size_t> offsets(blocks * PARTITIONS, 0);
+    pool.parallelFor(0, blocks, [&](size_t first, size_t last) {
+        for (size_t b = first; b < last; ++b) {
+            size_t *count = &offsets[b * PARTITIONS];
+            for (size_t i = b * BLOCK_POINTS; i < std::min(n, (b + 1) * BLOCK_POINTS); ++i)
+                ++count[partitionOf(voxelKey(points[i].position, bounds, inverseSize))];
+        }
+    });
+
+    // Partition-major prefix sum, so every partition is contiguous and keeps the block order.
+    groups.start.assign(PARTITIONS + 1, n);
+    size_t offset = 0;
+    for (size_t p = 0; p < PARTITIONS; ++p) {
+        groups.start[p] = offset;
+        for (size_t b = 0; b < blocks; ++b) {
+            size_t count = offsets[b * PARTITIONS + p];
+            offsets[b * PARTITIONS + p] = offset;
+            offset += count;
+        }
+    }
+
+    groups.entries.resize(n);
+    pool.parallelFor(0, blocks, [&](size_t first, size_t last) {
+        for (size_t b = first; b < last; ++b) {
+            size_t *next = &offsets[b * PARTITIONS];
+            for (size_t i = b * BLOCK_POINTS; i < std::min(n, (b + 1) * BLOCK_POINTS); ++i) {
+                uint64_t key = voxelKey(points[i].position, bounds, inverseSize);
+                groups.entries[next[partitionOf(key)]++] = {key, i};
+            }
+        }
+    });
+    pool.parallelFor(0, PARTITIONS, [&](size_t first, size_t last) {
+        for (size_t p = first; p < last; ++p)
+            std::sort(groups.entries.begin() + groups.start[p], groups.entries.begin() + groups.start[p + 1]);
+    });
+}
+
+// Number of distinct cells in each partition.
+std::vector<size_t> countCells(const VoxelGroups &groups)
+{
+    std::vector<size_t> cells(PARTITIONS, 0);
+    ThreadPool::instance().parallelFor(0, PARTITIONS, [&](size_t first, size_t last) {
+        for (size_t p = first; p < last; ++p) {
+            for (size_t i = groups.start[p]; i < groups.start[p + 1]; ++i) {
+                if (i == groups.start[p] || groups.entries[i].key != groups.entries[i - 1].key)
+                    ++cells[p];
+            }
+        }
+    });
+    return cells;
+}
+
+size_t countOccupied(const std::vector<Point> &points, const Bounds &bounds, float voxelSize)
+{
+    VoxelGroups groups;
+    groupByVoxel(points, bounds, voxelSize, groups);
+    std::vector<size_t> cells = countCells(groups);
+    size_t total = 0;
+    for (size_t count : cells)
+        total += count;
+    return total;
+}
+
+} // namespace
+
+float downsampleVoxelGrid(std::vector<Point> &points, float voxelSize)
+{
+    if (points.empty() || !(voxelSize > 0.0f) || !std::isfinite(voxelSize))
+        return 0.0f;
+    const Bounds bounds = computeBounds(points);
+    voxelSize = clampVoxelSize(bounds, voxelSize);
+
+    VoxelGroups groups;
+    groupByVoxel(points, bounds, voxelSize, groups);
+    std::vector<size_t> cells = countCells(groups);
+    std::vector<size_t> outputStart(PARTITIONS + 1, 0);
+    for (size_t p = 0; p < PARTITIONS; ++p)
+        outputStart[p + 1] = outputStart[p] + cells[p];
+
+    std::vector<Point> reduced(outputStart[PARTITIONS]);
+    ThreadPool::instance().parallelFor(0, PARTITIONS, [&](size_t first, size_t last) {
+        for (size_t p = first; p < last; ++p) {
+            size_t out = outputStart[p];
+            size_t i = groups.start[p];
+            while (i < groups.start[p + 1]) {
+                // Sums in double, as large coordinates lose the small offsets in float.
+                glm::dvec3 position(0.0);
+                glm::vec3 color(0.0f), normal(0.0f);
+                size_t count = 0;
+                const uint64_t key = groups.entries[i].key;
+                for (; i < groups.start[p + 1] && groups.entries[i].key == key; ++i, ++count) {
+                    const Point &pt = points[groups.entries[i].index];
+                    position += glm::dvec3(pt.position);
+                    color += pt.color;
+                    normal += pt.normal;
+                }
+                Point &cell = reduced[out++];
+                cell.position = glm::vec3(position / static_cast<double>(count));
+                cell.color = color / static_cast<float>(count);
+                float length = glm::length(normal);
+                cell.normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+                cell.radius = 0.0f;
+            }
+        }
+    });
+    points.swap(reduced);
+    return voxelSize;
+}
+
+float voxelSizeForBudget(const std::vector<Point> &points, size_t budget)
+{
+    if (budget == 0 || points.size() <= budget)
+        return 0.0f;
+    const Bounds bounds = computeBounds(points);
+    glm::vec3 extent = bounds.extent();
+    float largest = std::max({extent.x, extent.y, extent.z, 1e-6f});
+
+    // Start from the size that fills the largest extent as a cube with 'budget' cells and
+    // bracket the answer between 'low' (too many points) and 'high' (within budget).
+    float high = clampVoxelSize(bounds, largest / static_cast<float>(std::cbrt(double(budget))));
+    float low = high;
+    if (countOccupied(points, bounds, high) <= budget) {
+        do {
+            high = low;
+            low = high * 0.5f;
+        } while (clampVoxelSize(bounds, low) == low && countOccupied(points, bounds, low) <= budget);
+        if (clampVoxelSize(bounds, low) != low)
+            return high;
+    } else {
+        // Past twice the largest extent every point falls into one cell.
+        do {
+            low = high;
+            high = low * 2.0f;
+        } while (high < 2.0f * largest && countOccupied(points, bounds, high) > budget);
+    }
+
+    for (int step = 0; step < BUDGET_BISECTIONS; ++step) {
+        float middle = std::sqrt(low * high);
+        if (countOccupied(points, bounds, middle) <= budget)
+            high = middle;
+        else
+            low = middle;
+    }
+    return high;
+}
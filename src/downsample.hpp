@@ -0,0 +1,24 @@
+﻿//
+// src/downsample.hpp
+//
+
+#ifndef DOWNSAMPLE_HPP
+#define DOWNSAMPLE_HPP
+
+#include <cstddef>
+#include <vector>
+#include "point.hpp"
+
+// Replace 'points' by one point per occupied cell of a cubic grid with cells 'voxelSize' wide,
+// anchored at the cloud bounds. Position and color are the mean of the points in the cell, the
+// normal is their normalized mean and the radius is reset to 0. The voxel size is raised if the
+// grid would need more than 2^21 cells along an axis. Runs on the thread pool.
+// Returns the voxel size that was used, or 0 if 'voxelSize' is not positive and finite, in which
+// case the points are left as they are.
+float downsampleVoxelGrid(std::vector<Point>& points, float voxelSize);
+
+// Voxel size for which downsampleVoxelGrid() keeps at most 'budget' points, found by searching
+// over the occupied cell count. Returns 0 if the cloud already fits.
+float voxelSizeForBudget(const std::vector<Point>& points, size_t budget);
+
+#endif // DOWNSAMPLE_HPP
@@ -0,0 +1,29 @@
+﻿//
+// src/frame_uniforms.cpp
+//
+
+#include "frame_uniforms.hpp"
+#include <cstring>
+
+FrameUniformBuffer::~FrameUniformBuffer()
+{
+    if (buffer)
+        glDeleteBuffers(1, &buffer);
+}
+
+void FrameUniformBuffer::update(const FrameUniforms &values)
+{
+    if (!buffer) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), &values, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, buffer);
+        current = values;
+        return;
+    }
+    if (std::memcmp(&current, &values, sizeof(FrameUniforms)) == 0)
+        return;
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &values);
+    current = values;
+}
@@ -0,0 +1,66 @@
+﻿//
+// src/frame_uniforms.hpp
+//
+
+#ifndef FRAME_UNIFORMS_HPP
+#define FRAME_UNIFORMS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Binding point of the "FrameUniforms" block in shaders/point_cloud.* and shaders/marker.vs.
+constexpr GLuint FRAME_UNIFORMS_BINDING = 0;
+
+// Per-frame values shared by all shaders, laid out as the std140 block "FrameUniforms".
+struct FrameUniforms {
+    glm::mat4 projection{1.0f};
+    glm::mat4 view{1.0f};
+    glm::vec4 viewPos{0.0f};      // xyz used
+    glm::vec4 lightPos{0.0f};     // xyz used
+    glm::vec4 lightColor{1.0f};   // xyz used
+    float pointSize = 1.0f;       // pixels
+    int32_t useLighting = 1;      // GLSL bool
+    float viewportHeight = 1.0f;  // pixels
+    int32_t adaptivePointSize = 0; // GLSL bool: size points by their radius and distance
+    float radiusScale = 1.0f;     // factor on the point radius with adaptivePointSize
+    float padding[3] = {};
+};
+static_assert(sizeof(FrameUniforms) == 208, "FrameUniforms must match the std140 layout of the GLSL block");
+
+// Texture unit of the "sceneTileData" buffer texture in shaders/point_cloud.vs, filled by PointRenderer.
+// Units 0-2 are taken by the offscreen passes of the splat and progressive renderers.
+constexpr GLuint SCENE_TILES_TEXTURE_UNIT = 3;
+// Each tile takes TILE_TEXELS RGBA32F texels of the buffer texture. Every GL 3.3 driver allows
+// at least 65536 texels, enough for 10922 tiles.
+constexpr size_t TILE_TEXELS = 6;
+constexpr size_t MAX_SCENE_TILES = 65536 / TILE_TEXELS;
+
+// Placement of one scene tile, as TILE_TEXELS texels: the model matrix by columns, then the bounds.
+struct TileUniforms {
+    glm::mat4 model{1.0f};           // tile to world coordinates
+    glm::vec4 boundsMin{0.0f};       // xyz used: compact positions are relative to these bounds
+    glm::vec4 boundsExtent{1.0f};    // xyz used
+};
+static_assert(sizeof(TileUniforms) == TILE_TEXELS * sizeof(glm::vec4), "TileUniforms must match the texels read by the shader");
+
+// Uniform buffer holding FrameUniforms, bound to FRAME_UNIFORMS_BINDING.
+// Unchanged values are not uploaded again.
+class FrameUniformBuffer {
+public:
+    FrameUniformBuffer() = default;
+    ~FrameUniformBuffer();
+
+    FrameUniformBuffer(const FrameUniformBuffer&) = delete;
+    FrameUniformBuffer& operator=(const FrameUniformBuffer&) = delete;
+
+    // Upload 'values' if they differ from the last upload. Creates the buffer on first use.
+    void update(const FrameUniforms& values);
+
+private:
+    GLuint buffer = 0;
+    FrameUniforms current;
+};
+
+#endif // FRAME_UNIFORMS_HPP
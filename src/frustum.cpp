@@ -0,0 +1,39 @@
+﻿//
+// src/frustum.cpp
+//
+
+#include "frustum.hpp"
+
+Frustum extractFrustum(const glm::mat4 &m)
+{
+    // glm matrices are column-major, row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+    auto row = [&m](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+    const glm::vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+    Frustum frustum;
+    frustum.planes[0] = r3 + r0; // left
+    frustum.planes[1] = r3 - r0; // right
+    frustum.planes[2] = r3 + r1; // bottom
+    frustum.planes[3] = r3 - r1; // top
+    frustum.planes[4] = r3 + r2; // near
+    frustum.planes[5] = r3 - r2; // far
+    for (glm::vec4 &plane : frustum.planes) {
+        float length = glm::length(glm::vec3(plane.x, plane.y, plane.z));
+        if (length > 0.0f)
+            plane /= length;
+    }
+    return frustum;
+}
+
+bool intersects(const Frustum &frustum, const Bounds &box)
+{
+    for (const glm::vec4 &plane : frustum.planes) {
+        // Corner of the box furthest along the plane normal.
+        glm::vec3 positive(plane.x >= 0.0f ? box.max.x : box.min.x,
+                           plane.y >= 0.0f ? box.max.y : box.min.y,
+                           plane.z >= 0.0f ? box.max.z : box.min.z);
+        if (plane.x * positive.x + plane.y * positive.y + plane.z * positive.z + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,27 @@
+﻿//
+// src/frustum.hpp
+//
+
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include <glm/glm.hpp>
+#include "point.hpp"
+
+// View frustum as six inward-facing planes (xyz = normal, w = distance), in the space the
+// view-projection matrix maps from.
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Extract the planes of 'viewProjection' (Gribb/Hartmann), normalized. Assumes clip-space depth
+// in [-1, 1]; with the reversed [0, 1] depth of depth_range.hpp the near plane is still exact and
+// the far plane is dropped, which only makes culling conservative (the far plane is fitted to the
+// cloud anyway).
+Frustum extractFrustum(const glm::mat4& viewProjection);
+
+// True if the box is at least partially inside the frustum. Conservative: boxes near a corner
+// of the frustum may be reported visible even though they are just outside.
+bool intersects(const Frustum& frustum, const Bounds& box);
+
+#endif // FRUSTUM_HPP
@@ -0,0 +1,70 @@
+﻿//
+// src/gl_extensions.cpp
+//
+
+#include "gl_extensions.hpp"
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+GlExtensions extensions;
+
+bool hasExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char *extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (extension && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool atLeast(int major, int minor)
+{
+    return extensions.majorVersion > major || (extensions.majorVersion == major && extensions.minorVersion >= minor);
+}
+
+} // namespace
+
+void loadGlExtensions(GLADloadproc load)
+{
+    extensions = GlExtensions();
+    glGetIntegerv(GL_MAJOR_VERSION, &extensions.majorVersion);
+    glGetIntegerv(GL_MINOR_VERSION, &extensions.minorVersion);
+
+    if (atLeast(4, 4) || hasExtension("GL_ARB_buffer_storage")) {
+        extensions.BufferStorage = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(load("glBufferStorage"));
+        extensions.bufferStorage = extensions.BufferStorage != nullptr;
+    }
+
+    if (atLeast(4, 3) || (hasExtension("GL_ARB_multi_draw_indirect") && hasExtension("GL_ARB_base_instance"))) {
+        extensions.MultiDrawArraysIndirect =
+            reinterpret_cast<PFNGLMULTIDRAWARRAYSINDIRECTPROC>(load("glMultiDrawArraysIndirect"));
+        extensions.multiDrawIndirect = extensions.MultiDrawArraysIndirect != nullptr;
+    }
+
+    if (atLeast(4, 3)) {
+        extensions.DispatchCompute = reinterpret_cast<PFNGLDISPATCHCOMPUTEPROC>(load("glDispatchCompute"));
+        extensions.MemoryBarrier = reinterpret_cast<PFNGLMEMORYBARRIERPROC>(load("glMemoryBarrier"));
+        extensions.computeShader = extensions.DispatchCompute != nullptr && extensions.MemoryBarrier != nullptr;
+    }
+
+    if (atLeast(4, 5) || hasExtension("GL_ARB_clip_control")) {
+        extensions.ClipControl = reinterpret_cast<PFNGLCLIPCONTROLPROC>(load("glClipControl"));
+        extensions.clipControl = extensions.ClipControl != nullptr;
+    }
+
+    std::cout << "[GL] OpenGL " << extensions.majorVersion << "." << extensions.minorVersion
+              << ", buffer storage: " << (extensions.bufferStorage ? "yes" : "no")
+              << ", multi-draw indirect: " << (extensions.multiDrawIndirect ? "yes" : "no")
+              << ", compute shaders: " << (extensions.computeShader ? "yes" : "no")
+              << ", clip control: " << (extensions.clipControl ? "yes" : "no") << std::endl;
+}
+
+const GlExtensions &glExtensions()
+{
+    return extensions;
+}
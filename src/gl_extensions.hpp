@@ -0,0 +1,81 @@
+﻿//
+// src/gl_extensions.hpp
+//
+
+#ifndef GL_EXTENSIONS_HPP
+#define GL_EXTENSIONS_HPP
+
+#include <glad/glad.h>
+
+// GLAD is generated for the OpenGL 3.3 core profile. Functions from newer versions or
+// extensions are loaded here at runtime and are only used when the driver has them.
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+
+#ifndef GL_ZERO_TO_ONE
+#define GL_NEGATIVE_ONE_TO_ONE 0x935E
+#define GL_ZERO_TO_ONE 0x935F
+#endif
+
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+typedef void (APIENTRYP PFNGLMULTIDRAWARRAYSINDIRECTPROC)(GLenum mode, const void* indirect, GLsizei drawcount,
+                                                          GLsizei stride);
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+typedef void (APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void (APIENTRYP PFNGLCLIPCONTROLPROC)(GLenum origin, GLenum depth);
+
+// One draw of glMultiDrawArraysIndirect, laid out as the GL expects it in GL_DRAW_INDIRECT_BUFFER.
+struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;   // also offsets the instanced attributes
+};
+
+struct GlExtensions {
+    int majorVersion = 0;
+    int minorVersion = 0;
+
+    // GL 4.4 / ARB_buffer_storage: immutable buffers that can stay mapped while in use.
+    bool bufferStorage = false;
+    PFNGLBUFFERSTORAGEPROC BufferStorage = nullptr;
+
+    // GL 4.3 / ARB_multi_draw_indirect with ARB_base_instance: draws read from a buffer.
+    bool multiDrawIndirect = false;
+    PFNGLMULTIDRAWARRAYSINDIRECTPROC MultiDrawArraysIndirect = nullptr;
+
+    // GL 4.3: compute shaders and shader storage buffers.
+    bool computeShader = false;
+    PFNGLDISPATCHCOMPUTEPROC DispatchCompute = nullptr;
+    PFNGLMEMORYBARRIERPROC MemoryBarrier = nullptr;
+
+    // GL 4.5 / ARB_clip_control: clip space depth in [0, 1], needed for reversed-Z.
+    bool clipControl = false;
+    PFNGLCLIPCONTROLPROC ClipControl = nullptr;
+};
+
+// Query the context version and extensions and load the entry points above.
+// Needs a current context and GLAD to be loaded already.
+void loadGlExtensions(GLADloadproc load);
+
+// What loadGlExtensions() found.
+const GlExtensions& glExtensions();
+
+#endif // GL_EXTENSIONS_HPP
@@ -0,0 +1,126 @@
+﻿//
+// src/gpu_culler.cpp
+//
+
+#include "gpu_culler.hpp"
+#include "gl_extensions.hpp"
+#include <algorithm>
+
+namespace {
+
+constexpr GLuint WORKGROUP_SIZE = 64;   // local_size_x of shaders/chunk_cull.comp
+
+// std430 layout of "Chunk" in shaders/chunk_cull.comp.
+struct GpuChunk {
+    float boundsMin[4];
+    float boundsMax[4];
+    uint32_t first;
+    uint32_t count;
+    uint32_t tile;
+    uint32_t padding;
+};
+static_assert(sizeof(GpuChunk) == 48, "GpuChunk must match the std430 layout of the GLSL struct");
+static_assert(sizeof(Frustum) == 6 * 4 * sizeof(float), "frustum planes are uploaded as is");
+
+} // namespace
+
+GpuChunkCuller::GpuChunkCuller()
+    : shader("shaders/chunk_cull.comp")
+{
+}
+
+GpuChunkCuller::~GpuChunkCuller()
+{
+    if (statsFence) glDeleteSync(statsFence);
+    for (GLuint buffer : {chunkBuffer, frustumBuffer, commandBuffer, statsBuffer}) {
+        if (buffer) glDeleteBuffers(1, &buffer);
+    }
+}
+
+bool GpuChunkCuller::isSupported()
+{
+    return glExtensions().computeShader && glExtensions().multiDrawIndirect;
+}
+
+void GpuChunkCuller::setChunks(const ChunkGrid &chunks, const std::vector<uint32_t> &chunkTile)
+{
+    if (!chunkBuffer) {
+        glGenBuffers(1, &chunkBuffer);
+        glGenBuffers(1, &frustumBuffer);
+        glGenBuffers(1, &commandBuffer);
+        glGenBuffers(1, &statsBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_READ);
+    }
+
+    chunkCount = chunks.size();
+    std::vector<GpuChunk> data(chunkCount);
+    for (size_t i = 0; i < chunkCount; ++i) {
+        data[i] = {{chunks.minX[i], chunks.minY[i], chunks.minZ[i], 0.0f},
+                   {chunks.maxX[i], chunks.maxY[i], chunks.maxZ[i], 0.0f},
+                   static_cast<uint32_t>(chunks.first[i]), static_cast<uint32_t>(chunks.count[i]), chunkTile[i], 0};
+    }
+    // Zero-sized buffers are not allowed as shader storage, so there is always room for one chunk.
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, chunkBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(std::max<size_t>(chunkCount, 1) * sizeof(GpuChunk)),
+                 data.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 static_cast<GLsizeiptr>(std::max<size_t>(chunkCount, 1) * sizeof(DrawArraysIndirectCommand)), nullptr,
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    stats = Stats();
+}
+
+void GpuChunkCuller::cull(const std::vector<Frustum> &tileFrustums, float sliceBegin, float sliceEnd)
+{
+    if (chunkCount == 0 || tileFrustums.empty())
+        return;
+    collectStats();
+
+    size_t bytes = tileFrustums.size() * sizeof(Frustum);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, frustumBuffer);
+    if (bytes > frustumCapacity) {
+        frustumCapacity = bytes;
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(bytes), tileFrustums.data());
+    // Only frames that start with the last counters read count anew, the others leave them alone.
+    const bool countStats = !statsFence;
+    if (countStats) {
+        const GLuint zero[2] = {0, 0};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), zero);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    shader.use();
+    shader.setInt("chunkCount", static_cast<int>(chunkCount));
+    shader.setBool("countStats", countStats);
+    shader.setFloat("sliceBegin", sliceBegin);
+    shader.setFloat("sliceEnd", sliceEnd);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, chunkBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, frustumBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, statsBuffer);
+    const GlExtensions &gl = glExtensions();
+    gl.DispatchCompute(static_cast<GLuint>((chunkCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE), 1, 1);
+    // The commands are read by the draw, the counters by the next glGetBufferSubData.
+    gl.MemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    if (countStats)
+        statsFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void GpuChunkCuller::collectStats()
+{
+    if (!statsFence || glClientWaitSync(statsFence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        return;
+    glDeleteSync(statsFence);
+    statsFence = nullptr;
+    GLuint counters[2] = {0, 0};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    stats.chunksDrawn = counters[0];
+    stats.pointsDrawn = counters[1];
+}
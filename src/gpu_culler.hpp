@@ -0,0 +1,68 @@
+﻿//
+// src/gpu_culler.hpp
+//
+
+#ifndef GPU_CULLER_HPP
+#define GPU_CULLER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include "chunk_grid.hpp"
+#include "frustum.hpp"
+#include "shader.hpp"
+
+// Frustum culling of the chunks on the GPU, as an alternative to cullChunks().
+//
+// The chunk bounds and ranges stay in a shader storage buffer. Each frame the six planes of
+// every tile's frustum are uploaded and shaders/chunk_cull.comp writes one
+// DrawArraysIndirectCommand per chunk, with an instance count of 0 for chunks outside. The
+// command buffer is then drawn with a single glMultiDrawArraysIndirect, so the CPU cost does not
+// grow with the number of chunks. Needs GL 4.3; check isSupported() first.
+class GpuChunkCuller {
+public:
+    struct Stats {
+        size_t chunksDrawn = 0;
+        size_t pointsDrawn = 0;
+    };
+
+    GpuChunkCuller();
+    ~GpuChunkCuller();
+
+    GpuChunkCuller(const GpuChunkCuller&) = delete;
+    GpuChunkCuller& operator=(const GpuChunkCuller&) = delete;
+
+    // True if the context has compute shaders and multi-draw indirect.
+    static bool isSupported();
+    // False if the compute shader failed to build.
+    bool isValid() const { return shader.isValid(); }
+
+    // Upload the chunks, 'chunkTile[i]' being the tile (and base instance) of chunk i.
+    void setChunks(const ChunkGrid& chunks, const std::vector<uint32_t>& chunkTile);
+    // Write the draw commands for the frustum of each tile, given in tile coordinates. Each
+    // command covers the slice [sliceBegin, sliceEnd) of its chunk (see PointRenderer::render()).
+    void cull(const std::vector<Frustum>& tileFrustums, float sliceBegin = 0.0f, float sliceEnd = 1.0f);
+
+    // Buffer to bind as GL_DRAW_INDIRECT_BUFFER, holding getCommandCount() commands.
+    GLuint getCommandBuffer() const { return commandBuffer; }
+    size_t getCommandCount() const { return chunkCount; }
+    // Counts of an earlier cull(), read back without waiting for the GPU, so they lag a frame or two.
+    const Stats& getStats() const { return stats; }
+
+private:
+    // Read the counters of the last cull() if the GPU is done with it.
+    void collectStats();
+
+    Shader shader;
+    GLuint chunkBuffer = 0;
+    GLuint frustumBuffer = 0;
+    GLuint commandBuffer = 0;
+    GLuint statsBuffer = 0;
+    size_t chunkCount = 0;
+    size_t frustumCapacity = 0;    // bytes allocated in frustumBuffer
+    GLsync statsFence = nullptr;
+    Stats stats;
+};
+
+#endif // GPU_CULLER_HPP
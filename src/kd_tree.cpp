@@ -0,0 +1,277 @@
+﻿//
+// src/kd_tree.cpp
+//
+
+#include "kd_tree.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+// Where the range [begin, end) of a node is divided between its two children.
+uint32_t splitPoint(uint32_t begin, uint32_t end)
+{
+    return begin + (end - begin) / 2;
+}
+
+// Insert a candidate into the sorted list of the best 'count' (of at most 'k') neighbours.
+void insertNeighbour(uint32_t index, float distance2, size_t k, size_t &count, uint32_t *indices, float *distances2)
+{
+    if (count == k && distance2 >= distances2[k - 1])
+        return;
+    size_t i = count < k ? count++ : k - 1;
+    while (i > 0 && distances2[i - 1] > distance2) {
+        distances2[i] = distances2[i - 1];
+        indices[i] = indices[i - 1];
+        --i;
+    }
+    distances2[i] = distance2;
+    indices[i] = index;
+}
+
+} // namespace
+
+void KdTree::clear()
+{
+    positions.clear();
+    order.clear();
+    splitValue.clear();
+    splitAxis.clear();
+    boundsMin = boundsMax = glm::vec3(0.0f);
+    depth = 0;
+}
+
+bool KdTree::build(const std::vector<Point> &points)
+{
+    return build(points.data(), points.size());
+}
+
+bool KdTree::build(const Point *points, size_t count)
+{
+    return buildFrom(count, [points](uint32_t i) { return points[i].position; });
+}
+
+bool KdTree::build(const float *x, const float *y, const float *z, size_t count)
+{
+    return buildFrom(count, [x, y, z](uint32_t i) { return glm::vec3(x[i], y[i], z[i]); });
+}
+
+template<typename Position>
+bool KdTree::buildFrom(size_t pointCount, const Position &position)
+{
+    clear();
+    if (pointCount > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "[KdTree] " << pointCount << " points, at most " << std::numeric_limits<uint32_t>::max()
+                  << " can be indexed" << std::endl;
+        return false;
+    }
+    const uint32_t count = static_cast<uint32_t>(pointCount);
+    order.resize(count);
+    std::iota(order.begin(), order.end(), 0u);
+    while ((size_t(count) >> depth) > LEAF_POINTS)
+        ++depth;
+
+    const size_t innerNodes = (size_t(1) << depth) - 1;
+    splitValue.assign(innerNodes, 0.0f);
+    splitAxis.assign(innerNodes, 0);
+    // Ranges of the nodes of the current level, refined level by level.
+    std::vector<uint32_t> begins{0}, ends{count};
+    for (unsigned level = 0; level < depth; ++level) {
+        const size_t firstNode = (size_t(1) << level) - 1;
+        ThreadPool::instance().parallelFor(0, begins.size(), [&](size_t first, size_t last) {
+            for (size_t n = first; n < last; ++n) {
+                uint32_t *begin = order.data() + begins[n];
+                uint32_t *end = order.data() + ends[n];
+                glm::vec3 low(std::numeric_limits<float>::max()), high(std::numeric_limits<float>::lowest());
+                for (const uint32_t *it = begin; it != end; ++it) {
+                    const glm::vec3 p = position(*it);
+                    low = glm::min(low, p);
+                    high = glm::max(high, p);
+                }
+                glm::vec3 extent = high - low;
+                int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+                uint32_t *mid = order.data() + splitPoint(begins[n], ends[n]);
+                if (begin != end) {
+                    std::nth_element(begin, mid, end, [&](uint32_t a, uint32_t b) {
+                        return position(a)[axis] < position(b)[axis];
+                    });
+                }
+                splitAxis[firstNode + n] = static_cast<uint8_t>(axis);
+                splitValue[firstNode + n] = mid != end ? position(*mid)[axis] : 0.0f;
+            }
+        });
+
+        std::vector<uint32_t> nextBegins, nextEnds;
+        nextBegins.reserve(begins.size() * 2);
+        nextEnds.reserve(begins.size() * 2);
+        for (size_t n = 0; n < begins.size(); ++n) {
+            uint32_t mid = splitPoint(begins[n], ends[n]);
+            nextBegins.push_back(begins[n]);
+            nextEnds.push_back(mid);
+            nextBegins.push_back(mid);
+            nextEnds.push_back(ends[n]);
+        }
+        begins.swap(nextBegins);
+        ends.swap(nextEnds);
+    }
+
+    positions.resize(count);
+    ThreadPool::instance().parallelFor(0, count, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+            positions[i] = position(order[i]);
+    }, 1 << 16);
+    boundsMin = count > 0 ? positions[0] : glm::vec3(0.0f);
+    boundsMax = boundsMin;
+    for (const glm::vec3 &p : positions) {
+        boundsMin = glm::min(boundsMin, p);
+        boundsMax = glm::max(boundsMax, p);
+    }
+    return true;
+}
+
+size_t KdTree::nearest(const glm::vec3 &query, size_t k, uint32_t *indices, float *distances2) const
+{
+    if (k == 0 || positions.empty())
+        return 0;
+
+    struct Entry {
+        uint32_t node, begin, end;
+        float distance2;   // lower bound of the distance from 'query' to the node
+    };
+    Entry stack[64];
+    size_t top = 0;
+    stack[top++] = {0, 0, static_cast<uint32_t>(positions.size()), 0.0f};
+    const size_t innerNodes = splitValue.size();
+    size_t found = 0;
+
+    while (top > 0) {
+        Entry entry = stack[--top];
+        if (found == k && entry.distance2 >= distances2[k - 1])
+            continue;
+        if (entry.node >= innerNodes) {
+            for (uint32_t i = entry.begin; i < entry.end; ++i) {
+                glm::vec3 d = positions[i] - query;
+                insertNeighbour(order[i], glm::dot(d, d), k, found, indices, distances2);
+            }
+            continue;
+        }
+        float diff = query[splitAxis[entry.node]] - splitValue[entry.node];
+        uint32_t mid = splitPoint(entry.begin, entry.end);
+        Entry left{2 * entry.node + 1, entry.begin, mid, entry.distance2};
+        Entry right{2 * entry.node + 2, mid, entry.end, entry.distance2};
+        // The far side is pushed first, so the near side is searched first.
+        Entry &far = diff < 0.0f ? right : left;
+        far.distance2 = std::max(entry.distance2, diff * diff);
+        stack[top++] = far;
+        stack[top++] = diff < 0.0f ? left : right;
+    }
+    return found;
+}
+
+size_t KdTree::withinRadius(const glm::vec3 &center, float radius, std::vector<uint32_t> &indices) const
+{
+    if (positions.empty() || radius < 0.0f)
+        return 0;
+
+    struct Entry {
+        uint32_t node, begin, end;
+        glm::vec3 low, high;   // box of the node
+    };
+    Entry stack[64];
+    size_t top = 0;
+    stack[top++] = {0, 0, static_cast<uint32_t>(positions.size()), boundsMin, boundsMax};
+    const size_t innerNodes = splitValue.size();
+    const float radius2 = radius * radius;
+    const size_t before = indices.size();
+
+    while (top > 0) {
+        Entry entry = stack[--top];
+        glm::vec3 d = glm::max(glm::max(entry.low - center, center - entry.high), glm::vec3(0.0f));
+        if (glm::dot(d, d) > radius2)
+            continue;
+        if (entry.node >= innerNodes) {
+            for (uint32_t i = entry.begin; i < entry.end; ++i) {
+                glm::vec3 p = positions[i] - center;
+                if (glm::dot(p, p) <= radius2)
+                    indices.push_back(order[i]);
+            }
+            continue;
+        }
+        int axis = splitAxis[entry.node];
+        uint32_t mid = splitPoint(entry.begin, entry.end);
+        Entry left{2 * entry.node + 1, entry.begin, mid, entry.low, entry.high};
+        Entry right{2 * entry.node + 2, mid, entry.end, entry.low, entry.high};
+        left.high[axis] = splitValue[entry.node];
+        right.low[axis] = splitValue[entry.node];
+        stack[top++] = left;
+        stack[top++] = right;
+    }
+    return indices.size() - before;
+}
+
+bool KdTree::pick(const glm::vec3 &origin, const glm::vec3 &direction, float tanAngle, uint32_t &index,
+                  float &distance) const
+{
+    if (positions.empty())
+        return false;
+
+    struct Entry {
+        uint32_t node, begin, end;
+        glm::vec3 low, high;   // box of the node
+    };
+    // Every point of a box lies within the sphere around it, so the box can only hold a point
+    // in the cone if that sphere reaches into the cone, and only one nearer than the best so far
+    // if the sphere starts before it.
+    auto reachable = [&](const Entry &entry, float best) {
+        glm::vec3 center = (entry.low + entry.high) * 0.5f - origin;
+        float radius = glm::length(entry.high - entry.low) * 0.5f;
+        float t = glm::dot(center, direction);
+        if (t + radius <= 0.0f || t - radius >= best)
+            return false;
+        float offset = std::sqrt(std::max(glm::dot(center, center) - t * t, 0.0f));
+        return offset - radius <= tanAngle * (t + radius);
+    };
+
+    Entry stack[64];
+    size_t top = 0;
+    stack[top++] = {0, 0, static_cast<uint32_t>(positions.size()), boundsMin, boundsMax};
+    const size_t innerNodes = splitValue.size();
+    const float tan2 = tanAngle * tanAngle;
+    float best = std::numeric_limits<float>::max();
+    bool found = false;
+
+    while (top > 0) {
+        Entry entry = stack[--top];
+        if (!reachable(entry, best))
+            continue;
+        if (entry.node >= innerNodes) {
+            for (uint32_t i = entry.begin; i < entry.end; ++i) {
+                glm::vec3 p = positions[i] - origin;
+                float t = glm::dot(p, direction);
+                if (t <= 0.0f || t >= best || glm::dot(p, p) - t * t > tan2 * t * t)
+                    continue;
+                best = t;
+                index = order[i];
+                found = true;
+            }
+            continue;
+        }
+        int axis = splitAxis[entry.node];
+        uint32_t mid = splitPoint(entry.begin, entry.end);
+        Entry left{2 * entry.node + 1, entry.begin, mid, entry.low, entry.high};
+        Entry right{2 * entry.node + 2, mid, entry.end, entry.low, entry.high};
+        left.high[axis] = splitValue[entry.node];
+        right.low[axis] = splitValue[entry.node];
+        // The side of the origin is searched first, so 'best' prunes the other one.
+        bool leftFirst = origin[axis] < splitValue[entry.node];
+        stack[top++] = leftFirst ? right : left;
+        stack[top++] = leftFirst ? left : right;
+    }
+    if (found)
+        distance = best;
+    return found;
+}
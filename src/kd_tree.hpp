@@ -0,0 +1,61 @@
+﻿//
+// src/kd_tree.hpp
+//
+
+#ifndef KD_TREE_HPP
+#define KD_TREE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "point.hpp"
+
+// Static k-d tree over point positions for nearest-neighbour, radius and ray queries.
+//
+// The tree is balanced and implicit: node i has the children 2i+1 and 2i+2, every node splits
+// its range of points at the median along the longest axis of the range, and the leaves are
+// the ranges below a fixed depth. Only the split planes are stored; the positions are kept
+// in tree order so each leaf is one contiguous run of memory. Levels are built in parallel.
+// The box of a node follows from the bounds of all points and the split planes above it.
+class KdTree {
+public:
+    static constexpr size_t LEAF_POINTS = 16;   // leaves hold at most about this many points
+
+    // Indices are 32-bit, so the build fails (and leaves the tree empty) above UINT32_MAX points.
+    bool build(const std::vector<Point>& points);
+    bool build(const Point* points, size_t count);
+    // From position columns, e.g. those of PointArrays.
+    bool build(const float* x, const float* y, const float* z, size_t count);
+    void clear();
+
+    size_t size() const { return positions.size(); }
+
+    // Find the (up to) 'k' points nearest to 'query', closest first. Writes their indices into
+    // the original point array and their squared distances; returns how many were found.
+    size_t nearest(const glm::vec3& query, size_t k, uint32_t* indices, float* distances2) const;
+
+    // Append the indices of all points within 'radius' of 'center' to 'indices', in no
+    // particular order. Returns how many were appended.
+    size_t withinRadius(const glm::vec3& center, float radius, std::vector<uint32_t>& indices) const;
+
+    // Find the first point along the ray from 'origin' in the unit 'direction' that lies inside
+    // the cone around the ray with the given tangent of its half angle, e.g. the pixels around
+    // the mouse cursor. Returns false if there is none; 'distance' is measured along the ray.
+    bool pick(const glm::vec3& origin, const glm::vec3& direction, float tanAngle, uint32_t& index,
+              float& distance) const;
+
+private:
+    // 'position(i)' returns the position of point i.
+    template<typename Position>
+    bool buildFrom(size_t pointCount, const Position& position);
+
+    std::vector<glm::vec3> positions;    // in tree order
+    std::vector<uint32_t> order;         // original index of positions[i]
+    std::vector<float> splitValue;       // per inner node
+    std::vector<uint8_t> splitAxis;
+    glm::vec3 boundsMin{0.0f}, boundsMax{0.0f};   // of all points, the box of the root
+    unsigned depth = 0;                  // number of inner levels
+};
+
+#endif // KD_TREE_HPP
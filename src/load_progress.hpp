@@ -0,0 +1,39 @@
+﻿//
+// src/load_progress.hpp
+//
+
+#ifndef LOAD_PROGRESS_HPP
+#define LOAD_PROGRESS_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Progress of a point cloud load. Written by the loading threads, read by the UI and
+// used to ask a running load to stop.
+struct LoadProgress {
+    std::atomic<uint64_t> bytesTotal{0};
+    std::atomic<uint64_t> bytesRead{0};
+    std::atomic<uint64_t> pointsParsed{0};
+    std::atomic<bool> cancelRequested{false};
+
+    void reset(uint64_t totalBytes)
+    {
+        bytesTotal = totalBytes;
+        bytesRead = 0;
+        pointsParsed = 0;
+        cancelRequested = false;
+    }
+    bool cancelled() const { return cancelRequested.load(std::memory_order_relaxed); }
+};
+
+// Add 'bytes' and 'points' to the progress, if any. Returns false if the load was cancelled.
+inline bool reportProgress(LoadProgress* progress, uint64_t bytes, uint64_t points)
+{
+    if (!progress)
+        return true;
+    progress->bytesRead.fetch_add(bytes, std::memory_order_relaxed);
+    progress->pointsParsed.fetch_add(points, std::memory_order_relaxed);
+    return !progress->cancelled();
+}
+
+#endif // LOAD_PROGRESS_HPP
@@ -0,0 +1,375 @@
+﻿//
+// src/lod_builder.cpp
+//
+
+#include "lod_builder.hpp"
+#include "compact_vertex.hpp"
+#include "lod_format.hpp"
+#include "point_loader.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Bytes copied at a time from the data file into the output file.
+constexpr size_t COPY_BYTES = 1 << 24;
+
+// Marks a sampling cell whose point has been kept; ranks are 32-bit, so none equals it.
+constexpr uint64_t CELL_TAKEN = std::numeric_limits<uint64_t>::max();
+
+struct BuildNode {
+    Bounds cube;
+    uint8_t level = 0;
+    fs::path pointFile;                     // Point records of the cube not kept by an ancestor
+    uint64_t pointCount = 0;
+    std::array<uint64_t, 8> childCounts{};  // points passed on to the child octants
+    uint32_t firstChild = 0;
+    uint8_t childMask = 0;
+    uint32_t keptCount = 0;                 // points stored in this node
+    uint64_t dataOffset = 0;                // of the stored points in the data file
+};
+
+// The packed points of all nodes, in the order the nodes are finished.
+struct DataFile {
+    std::ofstream out;
+    uint64_t size = 0;
+    std::mutex mutex;
+
+    bool append(const std::vector<CompactPoint> &packed, uint64_t &offset)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        offset = size;
+        out.write(reinterpret_cast<const char*>(packed.data()), packed.size() * sizeof(CompactPoint));
+        size += packed.size() * sizeof(CompactPoint);
+        return bool(out);
+    }
+};
+
+// Removes the temporary files of a build when it ends, whether it succeeded or not.
+struct BuildDirectory {
+    fs::path path;
+
+    ~BuildDirectory()
+    {
+        std::error_code error;
+        if (!path.empty())
+            fs::remove_all(path, error);
+    }
+};
+
+int octantOf(const glm::vec3 &position, const glm::vec3 &center)
+{
+    return (position.x >= center.x ? 1 : 0) | (position.y >= center.y ? 2 : 0) | (position.z >= center.z ? 4 : 0);
+}
+
+Bounds octantCube(const Bounds &cube, int octant)
+{
+    glm::vec3 center = (cube.min + cube.max) * 0.5f;
+    Bounds child;
+    child.min = glm::vec3((octant & 1) ? center.x : cube.min.x, (octant & 2) ? center.y : cube.min.y,
+                          (octant & 4) ? center.z : cube.min.z);
+    child.max = glm::vec3((octant & 1) ? cube.max.x : center.x, (octant & 2) ? cube.max.y : center.y,
+                          (octant & 4) ? cube.max.z : center.z);
+    return child;
+}
+
+fs::path childFile(const fs::path &directory, size_t node, int octant)
+{
+    return directory / ("node" + std::to_string(node) + "-" + std::to_string(octant));
+}
+
+// Pseudo-random rank of a point, hashed from its position so every pass over a node's file gets
+// the same one. Keeping the point of least rank in each cell samples like keeping the first one
+// after shuffling the cloud, which cannot be done to a cloud on disk.
+uint32_t sampleRank(const glm::vec3 &position)
+{
+    uint32_t bits[3];
+    std::memcpy(bits, &position, sizeof(bits));
+    uint64_t hash = (uint64_t(bits[0]) | uint64_t(bits[1]) << 32) ^ uint64_t(bits[2]) * 0x9E3779B97F4A7C15ull;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    return static_cast<uint32_t>(hash ^ (hash >> 31));
+}
+
+// Read the next batch of Point records from a node's file; false at its end.
+bool readBatch(std::ifstream &in, size_t batchPoints, std::vector<Point> &batch)
+{
+    batch.resize(batchPoints);
+    in.read(reinterpret_cast<char*>(batch.data()), batchPoints * sizeof(Point));
+    batch.resize(static_cast<size_t>(in.gcount()) / sizeof(Point));
+    return !batch.empty();
+}
+
+// Keep the point of least rank in each cell of the sampling grid (all points in a leaf), append
+// them packed to 'data' and pass the rest on to the files of the child octants. Two passes over
+// the node's file: the first finds the least rank per cell, the second distributes the points.
+// Colors are multiplied by 'colorScale'. The node's file is removed afterwards.
+bool sampleNode(BuildNode &node, size_t index, const fs::path &directory, float colorScale, float rootSpacing,
+                const LodBuildOptions &options, DataFile &data)
+{
+    const bool leaf = node.pointCount <= options.maxLeafPoints || node.level >= options.maxDepth;
+    if (leaf && node.pointCount > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "[LOD Build] Too many points for one node at depth " << int(node.level) << ": "
+                  << node.pointCount << std::endl;
+        return false;
+    }
+
+    const unsigned resolution = options.gridResolution;
+    const glm::vec3 center = (node.cube.min + node.cube.max) * 0.5f;
+    const float cellsPerUnit = resolution / std::max(node.cube.max.x - node.cube.min.x, 1e-20f);
+    auto cellOf = [&](const glm::vec3 &position) {
+        glm::vec3 cell = glm::floor((position - node.cube.min) * cellsPerUnit);
+        uint64_t x = static_cast<uint64_t>(std::clamp(cell.x, 0.0f, resolution - 1.0f));
+        uint64_t y = static_cast<uint64_t>(std::clamp(cell.y, 0.0f, resolution - 1.0f));
+        uint64_t z = static_cast<uint64_t>(std::clamp(cell.z, 0.0f, resolution - 1.0f));
+        return (z * resolution + y) * resolution + x;
+    };
+
+    std::vector<Point> batch;
+    std::unordered_map<uint64_t, uint64_t> cellRanks;
+    if (!leaf) {
+        cellRanks.reserve(std::min<uint64_t>(node.pointCount, uint64_t(resolution) * resolution * resolution));
+        std::ifstream in(node.pointFile, std::ios::binary);
+        while (readBatch(in, options.batchPoints, batch)) {
+            for (const Point &point : batch) {
+                const uint64_t rank = sampleRank(point.position);
+                auto [it, inserted] = cellRanks.emplace(cellOf(point.position), rank);
+                if (!inserted)
+                    it->second = std::min(it->second, rank);
+            }
+        }
+    }
+
+    // A node keeps about one point per cell of its sampling grid, so when it is drawn without
+    // its children its points are that far apart, not as close as in the full cloud.
+    const float spacing = std::ldexp(rootSpacing, -int(node.level));
+    std::vector<CompactPoint> packed, packedBatch;
+    std::vector<Point> kept;
+    std::array<std::vector<Point>, 8> children;
+    std::array<std::ofstream, 8> childFiles;
+    std::ifstream in(node.pointFile, std::ios::binary);
+    uint64_t read = 0;
+    bool written = true;
+    while (written && readBatch(in, options.batchPoints, batch)) {
+        read += batch.size();
+        kept.clear();
+        for (Point &point : batch) {
+            point.color *= colorScale;
+            if (!leaf) {
+                auto cell = cellRanks.find(cellOf(point.position));
+                if (cell->second != sampleRank(point.position)) {
+                    children[octantOf(point.position, center)].push_back(point);
+                    continue;
+                }
+                cell->second = CELL_TAKEN;
+            }
+            point.radius = std::max(point.radius, spacing);
+            kept.push_back(point);
+        }
+        packCompactPoints(kept, node.cube, packedBatch);
+        packed.insert(packed.end(), packedBatch.begin(), packedBatch.end());
+
+        for (int octant = 0; octant < 8; ++octant) {
+            std::vector<Point> &child = children[octant];
+            if (child.empty())
+                continue;
+            if (!childFiles[octant].is_open())
+                childFiles[octant].open(childFile(directory, index, octant), std::ios::binary | std::ios::trunc);
+            childFiles[octant].write(reinterpret_cast<const char*>(child.data()), child.size() * sizeof(Point));
+            written = written && childFiles[octant];
+            node.childCounts[octant] += child.size();
+            child.clear();
+        }
+    }
+    in.close();
+    std::error_code error;
+    fs::remove(node.pointFile, error);
+    for (std::ofstream &file : childFiles) {
+        if (file.is_open()) {
+            file.close();
+            written = written && file;
+        }
+    }
+    if (read != node.pointCount || !written) {
+        std::cerr << "[LOD Build] Failed to pass on the points of node " << index << " in " << directory
+                  << std::endl;
+        return false;
+    }
+
+    node.keptCount = static_cast<uint32_t>(packed.size());
+    if (!data.append(packed, node.dataOffset)) {
+        std::cerr << "[LOD Build] Failed to write the points of node " << index << " to " << directory << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool buildLodOctree(const std::string &inputFile, const std::string &outputFile, const LodBuildOptions &options)
+{
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+
+    BuildDirectory directory;
+    const fs::path path = fs::path(outputFile + ".build");
+    std::error_code error;
+    if (fs::exists(path, error) || !fs::create_directory(path, error)) {
+        std::cerr << "[LOD Build] Failed to create the directory for temporary files (remove it if it is left "
+                  << "from an earlier build): " << path << std::endl;
+        return false;
+    }
+    directory.path = path;
+
+    // Pass the whole cloud to the root node's file, taking its bounds on the way.
+    std::vector<BuildNode> nodes(1);
+    nodes[0].pointFile = path / "node";
+    std::ofstream rootFile(nodes[0].pointFile, std::ios::binary | std::ios::trunc);
+    if (!rootFile.is_open()) {
+        std::cerr << "[LOD Build] Failed to create file: " << nodes[0].pointFile << std::endl;
+        return false;
+    }
+    Bounds bounds{glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+    glm::dvec3 origin(0.0);
+    float colorScale = 1.0f;
+    auto spill = [&](std::vector<Point> &batch) {
+        const Bounds batchBounds = computeBounds(batch);
+        bounds = {glm::min(bounds.min, batchBounds.min), glm::max(bounds.max, batchBounds.max)};
+        rootFile.write(reinterpret_cast<const char*>(batch.data()), batch.size() * sizeof(Point));
+        nodes[0].pointCount += batch.size();
+        return bool(rootFile);
+    };
+    if (!readPointFileBatches(inputFile, options.batchPoints, spill, origin, colorScale)) {
+        if (!rootFile)
+            std::cerr << "[LOD Build] Failed to write file: " << nodes[0].pointFile << std::endl;
+        return false;
+    }
+    rootFile.close();
+    if (!rootFile) {
+        std::cerr << "[LOD Build] Failed to write file: " << nodes[0].pointFile << std::endl;
+        return false;
+    }
+    if (nodes[0].pointCount == 0)
+        bounds = {glm::vec3(0.0f), glm::vec3(0.0f)};
+
+    // The root is a cube around the bounds, so all nodes are cubes.
+    float size = std::max({bounds.extent().x, bounds.extent().y, bounds.extent().z, 1e-6f});
+    nodes[0].cube = {bounds.min, bounds.min + glm::vec3(size)};
+    const float rootSpacing = size / options.gridResolution;
+
+    DataFile data;
+    data.out.open(path / "data", std::ios::binary | std::ios::trunc);
+    if (!data.out.is_open()) {
+        std::cerr << "[LOD Build] Failed to create file: " << path / "data" << std::endl;
+        return false;
+    }
+
+    // Level by level: sample all nodes of a level in parallel, then append their children,
+    // which keeps the node array in breadth-first order.
+    size_t levelBegin = 0;
+    while (levelBegin < nodes.size()) {
+        size_t levelEnd = nodes.size();
+        std::atomic<bool> failed(false);
+        ThreadPool::instance().parallelFor(levelBegin, levelEnd, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last && !failed; ++i) {
+                if (!sampleNode(nodes[i], i, path, i == 0 ? colorScale : 1.0f, rootSpacing, options, data))
+                    failed = true;
+            }
+        });
+        if (failed)
+            return false;
+        for (size_t i = levelBegin; i < levelEnd; ++i) {
+            for (int octant = 0; octant < 8; ++octant) {
+                if (nodes[i].childCounts[octant] == 0)
+                    continue;
+                BuildNode child;
+                child.cube = octantCube(nodes[i].cube, octant);
+                child.level = static_cast<uint8_t>(nodes[i].level + 1);
+                child.pointFile = childFile(path, i, octant);
+                child.pointCount = nodes[i].childCounts[octant];
+                if (nodes[i].childMask == 0)
+                    nodes[i].firstChild = static_cast<uint32_t>(nodes.size());
+                nodes[i].childMask |= static_cast<uint8_t>(1u << octant);
+                nodes.push_back(std::move(child));
+            }
+        }
+        if (nodes.size() > std::numeric_limits<uint32_t>::max()) {
+            std::cerr << "[LOD Build] Too many nodes for one octree: " << nodes.size() << std::endl;
+            return false;
+        }
+        levelBegin = levelEnd;
+    }
+    data.out.close();
+    if (!data.out) {
+        std::cerr << "[LOD Build] Failed to write file: " << path / "data" << std::endl;
+        return false;
+    }
+
+    LodFileHeader header{};
+    std::memcpy(header.magic, LOD_MAGIC, sizeof(header.magic));
+    header.version = LOD_VERSION;
+    header.nodeCount = static_cast<uint32_t>(nodes.size());
+    header.pointCount = nodes[0].pointCount;
+    for (int i = 0; i < 3; ++i) {
+        header.boundsMin[i] = nodes[0].cube.min[i];
+        header.boundsMax[i] = nodes[0].cube.max[i];
+        header.origin[i] = origin[i];
+    }
+    header.rootSpacing = rootSpacing;
+    header.dataOffset = sizeof(LodFileHeader) + nodes.size() * sizeof(LodFileNode);
+
+    std::vector<LodFileNode> table(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        LodFileNode &entry = table[i];
+        entry = LodFileNode{};
+        for (int k = 0; k < 3; ++k) {
+            entry.boundsMin[k] = nodes[i].cube.min[k];
+            entry.boundsMax[k] = nodes[i].cube.max[k];
+        }
+        entry.firstChild = nodes[i].firstChild;
+        entry.childMask = nodes[i].childMask;
+        entry.level = nodes[i].level;
+        entry.pointCount = nodes[i].keptCount;
+        entry.dataOffset = nodes[i].dataOffset;
+    }
+
+    std::ofstream out(outputFile, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "[LOD Build] Failed to create file: " << outputFile << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(LodFileNode));
+
+    // The node table is only known once all nodes are sampled, so the point data follows it as a copy.
+    std::ifstream in(path / "data", std::ios::binary);
+    std::vector<char> buffer(COPY_BYTES);
+    uint64_t copied = 0;
+    while (out && in.read(buffer.data(), buffer.size()).gcount() > 0) {
+        out.write(buffer.data(), in.gcount());
+        copied += static_cast<uint64_t>(in.gcount());
+    }
+    out.close();
+    if (!out || copied != data.size) {
+        std::cerr << "[LOD Build] Failed to write file: " << outputFile << std::endl;
+        return false;
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << "[LOD Build] Wrote " << header.pointCount << " points in " << nodes.size() << " nodes ("
+              << int(nodes.back().level) + 1 << " levels) to " << outputFile << " in " << seconds << " s" << std::endl;
+    return true;
+}
@@ -0,0 +1,28 @@
+﻿//
+// src/lod_builder.hpp
+//
+
+#ifndef LOD_BUILDER_HPP
+#define LOD_BUILDER_HPP
+
+#include <cstddef>
+#include <string>
+
+struct LodBuildOptions {
+    unsigned gridResolution = 128;  // sampling grid per node and axis
+    unsigned maxLeafPoints = 20000; // nodes with fewer points keep all of them
+    unsigned maxDepth = 16;         // deeper nodes keep all of their points
+    size_t batchPoints = 1 << 18;   // points read from a file at a time
+};
+
+// Build a level-of-detail octree over the points of the .pts or .ply file 'inputFile' and write it
+// to 'outputFile' (see lod_format.hpp). The build is out-of-core, so the cloud may be larger than
+// memory: the file is read in batches into a temporary file for the root node, and every node
+// is sampled from its own file, passing the points it does not keep on to files for its children.
+// Memory use depends on the batch size and the sampling grid, not on the size of the cloud. The
+// temporary files are kept in the directory 'outputFile' + ".build" and need up to twice the size
+// of the cloud at 40 bytes per point.
+bool buildLodOctree(const std::string& inputFile, const std::string& outputFile,
+                    const LodBuildOptions& options = LodBuildOptions());
+
+#endif // LOD_BUILDER_HPP
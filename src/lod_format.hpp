@@ -0,0 +1,49 @@
+﻿//
+// src/lod_format.hpp
+//
+
+#ifndef LOD_FORMAT_HPP
+#define LOD_FORMAT_HPP
+
+#include <cstdint>
+
+// On-disk layout of a level-of-detail octree (".lod"), written by buildLodOctree() and
+// streamed by LodOctree.
+//
+// Layout: LodFileHeader, 'nodeCount' LodFileNode records in breadth-first order (root first),
+// then the point data of every node as CompactPoint records quantized to the node's cube.
+// Each node holds a spatially uniform subsample of the points in its cube that were not
+// already taken by an ancestor, so drawing a node together with its ancestors adds detail.
+// All bounds are relative to 'origin', which is kept in double precision.
+constexpr char LOD_MAGIC[8] = {'P', 'C', 'L', 'O', 'D', '\0', '\0', '\0'};
+constexpr uint32_t LOD_VERSION = 2;   // 2: double-precision origin
+constexpr const char* LOD_EXTENSION = ".lod";
+
+struct LodFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nodeCount;
+    uint64_t pointCount;
+    float boundsMin[3];     // cube of the root node
+    float boundsMax[3];
+    float rootSpacing;      // sampling cell size of the root node, halved per level; the least point radius
+    uint32_t reserved;
+    uint64_t dataOffset;    // start of the point data
+    double origin[3];       // added to the bounds to get the coordinates of the source file
+};
+static_assert(sizeof(LodFileHeader) == 88, "LodFileHeader layout must not change");
+
+struct LodFileNode {
+    float boundsMin[3];     // cube of the node
+    float boundsMax[3];
+    uint32_t firstChild;    // index of the first child, children are stored consecutively
+    uint8_t childMask;      // bit i set: child for octant i exists (x = bit 0, y = bit 1, z = bit 2)
+    uint8_t level;
+    uint16_t reserved;
+    uint32_t pointCount;
+    uint32_t reserved2;
+    uint64_t dataOffset;    // relative to LodFileHeader::dataOffset
+};
+static_assert(sizeof(LodFileNode) == 48, "LodFileNode layout must not change");
+
+#endif // LOD_FORMAT_HPP
@@ -0,0 +1,301 @@
+﻿//
+// src/lod_octree.cpp
+//
+
+#include "lod_octree.hpp"
+#include "frustum.hpp"
+#include "vertex_layout.hpp"
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <glad/glad.h>
+
+namespace {
+
+Bounds nodeBounds(const LodFileNode &node)
+{
+    return {glm::vec3(node.boundsMin[0], node.boundsMin[1], node.boundsMin[2]),
+            glm::vec3(node.boundsMax[0], node.boundsMax[1], node.boundsMax[2])};
+}
+
+// Number of completed loads the loader thread may run ahead of the uploads.
+constexpr size_t MAX_COMPLETED_LOADS = 64;
+
+} // namespace
+
+LodOctree::~LodOctree()
+{
+    close();
+}
+
+bool LodOctree::open(const std::string &filename)
+{
+    close();
+    if (!file.open(filename))
+        return false;
+
+    if (file.size() < sizeof(LodFileHeader)) {
+        std::cerr << "[LOD] File too small: " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, LOD_MAGIC, sizeof(header.magic)) != 0 || header.version != LOD_VERSION) {
+        std::cerr << "[LOD] Not a version " << LOD_VERSION << " LOD file: " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    uint64_t tableEnd = sizeof(LodFileHeader) + uint64_t(header.nodeCount) * sizeof(LodFileNode);
+    if (header.nodeCount == 0 || tableEnd > file.size() || header.dataOffset < tableEnd || header.dataOffset > file.size()) {
+        std::cerr << "[LOD] Corrupt node table: " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    nodes = reinterpret_cast<const LodFileNode*>(file.data() + sizeof(LodFileHeader));
+    uint64_t dataSize = file.size() - header.dataOffset;
+    for (uint32_t i = 0; i < header.nodeCount; ++i) {
+        const LodFileNode &node = nodes[i];
+        bool childrenValid = node.childMask == 0 ||
+            (node.firstChild > i && node.firstChild + std::bitset<8>(node.childMask).count() <= header.nodeCount);
+        if (!childrenValid || node.dataOffset + uint64_t(node.pointCount) * sizeof(CompactPoint) > dataSize) {
+            std::cerr << "[LOD] Corrupt node " << i << " in: " << filename << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    states.assign(header.nodeCount, NodeState::Unloaded);
+    gpuNodes.assign(header.nodeCount, GpuNode());
+    stopLoader = false;
+    loader = std::thread(&LodOctree::loaderLoop, this);
+    std::cout << "[LOD] Opened " << filename << ": " << header.pointCount << " points in "
+              << header.nodeCount << " nodes" << std::endl;
+    return true;
+}
+
+void LodOctree::close()
+{
+    if (loader.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopLoader = true;
+        }
+        wakeLoader.notify_all();
+        loader.join();
+    }
+    for (uint32_t node : std::vector<uint32_t>(resident))
+        evict(node);
+    requests.clear();
+    completed.clear();
+    deferred.clear();
+    states.clear();
+    gpuNodes.clear();
+    drawList.clear();
+    nodes = nullptr;
+    header = LodFileHeader{};
+    stats = Stats();
+    file.close();
+}
+
+Bounds LodOctree::getBounds() const
+{
+    return {glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+            glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2])};
+}
+
+void LodOctree::loaderLoop()
+{
+    const char *data = file.data() + header.dataOffset;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeLoader.wait(lock, [this] {
+            return stopLoader || (!requests.empty() && completed.size() < MAX_COMPLETED_LOADS);
+        });
+        if (stopLoader)
+            return;
+        uint32_t index = requests.front();
+        requests.pop_front();
+        states[index] = NodeState::Loading;
+        lock.unlock();
+
+        // Touching the mapping is what reads the node from disk, so do it off the render thread.
+        LoadedNode loaded{index, std::vector<CompactPoint>(nodes[index].pointCount)};
+        std::memcpy(loaded.points.data(), data + nodes[index].dataOffset, loaded.points.size() * sizeof(CompactPoint));
+
+        lock.lock();
+        completed.push_back(std::move(loaded));
+    }
+}
+
+void LodOctree::update(const glm::mat4 &projection, const glm::mat4 &view, int viewportHeight)
+{
+    if (!nodes)
+        return;
+    ++frame;
+
+    // Traverse the hierarchy from the root, most important node first, until the point
+    // budget is used up. Importance is the projected size of the node in pixels.
+    Frustum frustum = extractFrustum(projection * view);
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(view)[3]);
+    float pixelScale = projection[1][1] * viewportHeight * 0.5f;
+
+    using Candidate = std::pair<float, uint32_t>;
+    std::priority_queue<Candidate> queue;
+    auto push = [&](uint32_t index) {
+        Bounds bounds = nodeBounds(nodes[index]);
+        if (!intersects(frustum, bounds))
+            return;
+        glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+        float radius = glm::length(bounds.extent()) * 0.5f;
+        float distance = glm::length(center - cameraPosition);
+        float pixels = distance > radius ? radius * pixelScale / distance : std::numeric_limits<float>::max();
+        if (pixels >= minNodePixels || index == 0)
+            queue.push({pixels, index});
+    };
+
+    std::vector<uint32_t> selected;
+    size_t selectedPoints = 0;
+    push(0);
+    while (!queue.empty()) {
+        uint32_t index = queue.top().second;
+        queue.pop();
+        const LodFileNode &node = nodes[index];
+        if (selectedPoints + node.pointCount > pointBudget)
+            break;
+        selected.push_back(index);
+        selectedPoints += node.pointCount;
+        uint32_t child = node.firstChild;
+        for (int octant = 0; octant < 8; ++octant)
+            if (node.childMask & (1u << octant))
+                push(child++);
+    }
+
+    // Draw what is resident and ask the loader for the rest. The request queue is rebuilt
+    // every frame, so nodes that went out of view are not loaded any more.
+    std::deque<LoadedNode> finished;
+    drawList.clear();
+    stats.pointsDrawn = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint32_t index : requests)
+            states[index] = NodeState::Unloaded;
+        requests.clear();
+        for (uint32_t index : selected) {
+            if (states[index] == NodeState::Resident) {
+                gpuNodes[index].lastUsedFrame = frame;
+                drawList.push_back(index);
+                stats.pointsDrawn += nodes[index].pointCount;
+            } else if (states[index] == NodeState::Unloaded) {
+                states[index] = NodeState::Queued;
+                requests.push_back(index);
+            }
+        }
+        // Deferred nodes are requested again from the next frame on, once they would fit.
+        size_t room = deferred.empty() ? 0 : reclaimableBytes();
+        auto fits = [&](uint32_t index) {
+            const size_t bytes = nodes[index].pointCount * sizeof(CompactPoint);
+            if (bytes > room)
+                return false;
+            room -= bytes;
+            states[index] = NodeState::Unloaded;
+            return true;
+        };
+        deferred.erase(std::remove_if(deferred.begin(), deferred.end(), fits), deferred.end());
+
+        size_t count = std::min<size_t>(completed.size(), maxUploadsPerFrame);
+        for (size_t i = 0; i < count; ++i) {
+            finished.push_back(std::move(completed.front()));
+            completed.pop_front();
+        }
+        stats.pendingLoads = static_cast<size_t>(std::count_if(states.begin(), states.end(), [](NodeState state) {
+            return state == NodeState::Queued || state == NodeState::Loading;
+        }));
+    }
+    wakeLoader.notify_one();
+
+    for (LoadedNode &loaded : finished)
+        upload(loaded);
+
+    stats.nodesSelected = selected.size();
+    stats.nodesDrawn = drawList.size();
+    stats.nodesResident = resident.size();
+}
+
+void LodOctree::upload(LoadedNode &loaded)
+{
+    size_t bytes = loaded.points.size() * sizeof(CompactPoint);
+    if (states[loaded.node] == NodeState::Resident)
+        return;
+    if (!makeRoom(bytes)) {
+        // Everything resident is still drawn; loading the node again every frame would not help.
+        states[loaded.node] = NodeState::Deferred;
+        deferred.push_back(loaded.node);
+        return;
+    }
+
+    GpuNode &gpu = gpuNodes[loaded.node];
+    glGenVertexArrays(1, &gpu.VAO);
+    glGenBuffers(1, &gpu.VBO);
+    glBindVertexArray(gpu.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.VBO);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(bytes), loaded.points.data(), GL_STATIC_DRAW);
+    applyVertexLayout(compactPointLayout());
+    glBindVertexArray(0);
+
+    gpu.lastUsedFrame = frame;
+    states[loaded.node] = NodeState::Resident;
+    resident.push_back(loaded.node);
+    stats.gpuBytes += bytes;
+}
+
+bool LodOctree::makeRoom(size_t bytes)
+{
+    if (stats.gpuBytes + bytes <= gpuBudgetBytes)
+        return true;
+    // Evict least recently used nodes, but never the ones drawn this frame.
+    std::sort(resident.begin(), resident.end(), [this](uint32_t a, uint32_t b) {
+        return gpuNodes[a].lastUsedFrame < gpuNodes[b].lastUsedFrame;
+    });
+    while (!resident.empty() && stats.gpuBytes + bytes > gpuBudgetBytes &&
+           gpuNodes[resident.front()].lastUsedFrame < frame)
+        evict(resident.front());
+    return stats.gpuBytes + bytes <= gpuBudgetBytes;
+}
+
+size_t LodOctree::reclaimableBytes() const
+{
+    size_t bytes = gpuBudgetBytes > stats.gpuBytes ? gpuBudgetBytes - stats.gpuBytes : 0;
+    for (uint32_t index : resident) {
+        if (gpuNodes[index].lastUsedFrame < frame)
+            bytes += nodes[index].pointCount * sizeof(CompactPoint);
+    }
+    return bytes;
+}
+
+void LodOctree::evict(uint32_t node)
+{
+    GpuNode &gpu = gpuNodes[node];
+    if (gpu.VBO) glDeleteBuffers(1, &gpu.VBO);
+    if (gpu.VAO) glDeleteVertexArrays(1, &gpu.VAO);
+    gpu = GpuNode();
+    states[node] = NodeState::Unloaded;
+    stats.gpuBytes -= nodes[node].pointCount * sizeof(CompactPoint);
+    resident.erase(std::find(resident.begin(), resident.end(), node));
+}
+
+void LodOctree::render(const Shader &shader, const glm::dvec3 &offset) const
+{
+    shader.setBool("compactVertices", true);
+    shader.setBool("sceneTiles", false);
+    for (uint32_t index : drawList) {
+        Bounds bounds = nodeBounds(nodes[index]);
+        shader.setVec3("boundsMin", glm::vec3(glm::dvec3(bounds.min) - offset));
+        shader.setVec3("boundsExtent", bounds.extent());
+        glBindVertexArray(gpuNodes[index].VAO);
+        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(nodes[index].pointCount));
+    }
+    glBindVertexArray(0);
+}
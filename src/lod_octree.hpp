@@ -0,0 +1,105 @@
+﻿//
+// src/lod_octree.hpp
+//
+
+#ifndef LOD_OCTREE_HPP
+#define LOD_OCTREE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "compact_vertex.hpp"
+#include "lod_format.hpp"
+#include "mapped_file.hpp"
+#include "point.hpp"
+#include "shader.hpp"
+
+// Streams a level-of-detail octree file (see lod_format.hpp) from disk.
+// Every frame update() picks the nodes worth drawing for the current view, a background
+// thread reads missing nodes from the memory-mapped file and a bounded number of them is
+// uploaded per frame. GPU memory is capped; the least recently used nodes are evicted.
+class LodOctree {
+public:
+    struct Stats {
+        size_t nodesSelected = 0;
+        size_t nodesDrawn = 0;
+        size_t nodesResident = 0;
+        size_t pointsDrawn = 0;
+        size_t pendingLoads = 0;
+        size_t gpuBytes = 0;
+    };
+
+    LodOctree() = default;
+    ~LodOctree();
+    LodOctree(const LodOctree&) = delete;
+    LodOctree& operator=(const LodOctree&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+
+    // Select the nodes for this view, queue missing ones for loading and upload finished loads.
+    void update(const glm::mat4& projection, const glm::mat4& view, int viewportHeight);
+    // Draw the nodes selected by the last update() that are on the GPU. 'offset' is subtracted
+    // from the node positions in double precision, for camera-relative rendering.
+    void render(const Shader& shader, const glm::dvec3& offset = glm::dvec3(0.0)) const;
+
+    const Stats& getStats() const { return stats; }
+    uint64_t getPointCount() const { return header.pointCount; }
+    Bounds getBounds() const;
+    // Offset of all positions in the file, see LodFileHeader::origin.
+    glm::dvec3 getOrigin() const { return glm::dvec3(header.origin[0], header.origin[1], header.origin[2]); }
+
+    size_t pointBudget = 5000000;          // points drawn per frame at most
+    float minNodePixels = 100.0f;          // skip nodes smaller than this on screen
+    unsigned maxUploadsPerFrame = 8;       // nodes uploaded per frame at most
+    size_t gpuBudgetBytes = size_t(512) << 20;
+
+private:
+    // Queued and Loading are only changed with 'mutex' held. Deferred nodes did not fit into
+    // gpuBudgetBytes and are not loaded again until evicting unused nodes would make room.
+    enum class NodeState : uint8_t { Unloaded, Queued, Loading, Resident, Deferred };
+
+    struct GpuNode {
+        unsigned int VAO = 0, VBO = 0;
+        uint64_t lastUsedFrame = 0;
+    };
+
+    struct LoadedNode {
+        uint32_t node;
+        std::vector<CompactPoint> points;
+    };
+
+    void loaderLoop();
+    void upload(LoadedNode& loaded);
+    bool makeRoom(size_t bytes);
+    void evict(uint32_t node);
+    // Bytes that are free or held by nodes not drawn this frame, i.e. what makeRoom() can reach.
+    size_t reclaimableBytes() const;
+
+    MappedFile file;
+    LodFileHeader header{};
+    const LodFileNode* nodes = nullptr;
+    std::vector<NodeState> states;          // per node
+    std::vector<GpuNode> gpuNodes;
+    std::vector<uint32_t> resident;
+    std::vector<uint32_t> deferred;
+    std::vector<uint32_t> drawList;
+    uint64_t frame = 0;
+    Stats stats;
+
+    // Shared with the loader thread.
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable wakeLoader;
+    std::deque<uint32_t> requests;          // in priority order
+    std::deque<LoadedNode> completed;
+    bool stopLoader = false;
+};
+
+#endif // LOD_OCTREE_HPP
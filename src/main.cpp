@@ -6,12 +6,27 @@
 #include "imgui_impl_opengl3.h"     // And this line
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 
 #include "shader.hpp"
+#include "benchmark.hpp"
+#include "debug_draw.hpp"
+#include "depth_range.hpp"
+#include "frame_uniforms.hpp"
+#include "gl_extensions.hpp"
+#include "lod_builder.hpp"
 #include "point_renderer.hpp"
 #include "camera.hpp"
 #include "menu.hpp"
+#include "profiler.hpp"
+#include "progressive_renderer.hpp"
+#include "simd_kernels.hpp"
+#include "splat_renderer.hpp"
+#include "stream_connection.hpp"
 
 // settings
 constexpr unsigned int SCR_WIDTH = 800;
@@ -34,6 +49,159 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 
 int main(int argc, char* argv[])
 {
+    std::string pointCloudFilePath = "resources/test.pts";
+    LoadOptions loadOptions;
+    bool gpuCulling = true;
+    bool reversedZ = true;
+    std::string lodInput, lodOutput;
+    bool benchmark = false;
+    BenchmarkOptions benchmarkOptions;
+    // Check arguments if any
+    if (argc > 1)
+    {
+        std::cout << "Arguments provided: ";
+        for (int i = 1; i < argc; ++i)
+        {
+            std::cout << argv[i] << " ";
+        }
+        std::cout << std::endl;
+        // Options start with "--", the first other argument is the file path.
+        bool fileGiven = false;
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--parallel")
+            {
+                loadOptions.parallel = true;
+            }
+            else if (arg == "--no-cache")
+            {
+                loadOptions.useCache = false;
+            }
+            else if (arg == "--verify-cache")
+            {
+                loadOptions.verifyCache = true;
+            }
+            else if (arg == "--compact")
+            {
+                loadOptions.vertexFormat = VertexFormat::Compact;
+            }
+            else if (arg == "--cpu-culling")
+            {
+                gpuCulling = false;
+                benchmarkOptions.gpuCulling = false;
+            }
+            else if (arg == "--no-reversed-z")
+            {
+                reversedZ = false;
+                benchmarkOptions.reversedZ = false;
+            }
+            else if (arg == "--camera-relative")
+            {
+                camera.CameraRelative = true;
+            }
+            else if ((arg == "--voxel-size" || arg == "--point-budget") && i + 1 < argc)
+            {
+                std::string value = argv[++i];
+                char *end = nullptr;
+                if (arg == "--voxel-size")
+                    loadOptions.voxelSize = std::strtof(value.c_str(), &end);
+                else
+                    loadOptions.pointBudget = std::strtoull(value.c_str(), &end, 10);
+                // strtoull would silently wrap a negative budget around, and strtof accepts "nan" and "inf".
+                if (end == value.c_str() || *end != '\0' || loadOptions.voxelSize < 0.0f
+                    || !std::isfinite(loadOptions.voxelSize)
+                    || (arg == "--point-budget" && value.find('-') != std::string::npos))
+                {
+                    std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+                    return -1;
+                }
+            }
+            else if (arg == "--simd" && i + 1 < argc)
+            {
+                // Cap the instruction set of the CPU kernels, e.g. to compare them.
+                SimdLevel level;
+                if (!parseSimdLevel(argv[++i], level))
+                {
+                    std::cerr << "Invalid value for --simd, expected avx2, sse2 or scalar: " << argv[i] << std::endl;
+                    return -1;
+                }
+                setSimdLevel(level);
+            }
+            else if (arg == "--compare-formats")
+            {
+                loadOptions.compareFormats = true;
+            }
+            else if (arg == "--build-lod")
+            {
+                if (i + 2 >= argc)
+                {
+                    std::cerr << "Usage: --build-lod <input> <output" << LOD_EXTENSION << ">" << std::endl;
+                    return -1;
+                }
+                lodInput = argv[++i];
+                lodOutput = argv[++i];
+            }
+            else if (arg == "--benchmark")
+            {
+                benchmark = true;
+            }
+            else if ((arg == "--frames" || arg == "--camera-path" || arg == "--output" || arg == "--size") && i + 1 < argc)
+            {
+                std::string value = argv[++i];
+                if (arg == "--frames")
+                {
+                    char *end = nullptr;
+                    long frames = std::strtol(value.c_str(), &end, 10);
+                    if (end == value.c_str() || *end != '\0' || frames <= 0 || frames > INT_MAX)
+                    {
+                        std::cerr << "Invalid frame count, expected a positive number: " << value << std::endl;
+                        return -1;
+                    }
+                    benchmarkOptions.frames = static_cast<int>(frames);
+                }
+                else if (arg == "--camera-path")
+                    benchmarkOptions.cameraPath = value;
+                else if (arg == "--output")
+                    benchmarkOptions.output = value;
+                else if (std::sscanf(value.c_str(), "%dx%d", &benchmarkOptions.width, &benchmarkOptions.height) != 2 ||
+                         benchmarkOptions.width <= 0 || benchmarkOptions.height <= 0)
+                {
+                    std::cerr << "Invalid size, expected WIDTHxHEIGHT: " << value << std::endl;
+                    return -1;
+                }
+            }
+            else if (!fileGiven)
+            {
+                // Stream addresses ("-", "tcp://host:port", named pipes) are read as live feeds.
+                std::filesystem::path filePath = arg;
+                if (!StreamConnection::isStreamAddress(arg) && !std::filesystem::exists(filePath))
+                {
+                    std::cerr << "File not found: " << filePath.string() << std::endl;
+                    return -1;
+                }
+                std::cout << "Using file: " << filePath.string() << std::endl;
+                pointCloudFilePath = filePath.string();
+                fileGiven = true;
+            }
+        }
+    }
+
+    std::cout << "[SIMD] CPU kernels use " << simdLevelName(getSimdLevel()) << std::endl;
+
+    // Build a LOD octree and exit without opening a window. The builder reads the file itself, in
+    // batches, so neither the cache nor the load options are used.
+    if (!lodInput.empty())
+        return buildLodOctree(lodInput, lodOutput) ? 0 : -1;
+
+    // Render a camera path without showing a window and write the timings to a file.
+    if (benchmark)
+    {
+        benchmarkOptions.file = pointCloudFilePath;
+        benchmarkOptions.loadOptions = loadOptions;
+        return runBenchmark(benchmarkOptions);
+    }
+
     // Initialize GLFW
     if (!glfwInit())
     {
@@ -73,10 +241,14 @@ int main(int argc, char* argv[])
         std::cerr << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    loadGlExtensions(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
 
     // Enable depth test and point size program
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_PROGRAM_POINT_SIZE);
+    // Reversed-Z where the driver has clip control; the scene is then drawn into a float depth buffer.
+    if (reversedZ)
+        enableReversedZ();
 
     // Check existence of shaders
     const std::filesystem::path vertexShaderPath = "shaders/point_cloud.vs";
@@ -91,30 +263,16 @@ int main(int argc, char* argv[])
     Shader pointShader("shaders/point_cloud.vs", "shaders/point_cloud.fs");
     // Create the shader for marker rendering
     Shader markerShader("shaders/marker.vs", "shaders/marker.fs");
-
-    std::string pointCloudFilePath = "resources/test.pts";
-    // Check arguments if any
-    if (argc > 1)
-    {
-        std::cout << "Arguments provided: ";
-        for (int i = 1; i < argc; ++i)
-        {
-            std::cout << argv[i] << " ";
-        }
-        std::cout << std::endl;
-        // Ignore all additional arguments, check first argument for valid file path
-        std::filesystem::path filePath = argv[1];
-        if (!std::filesystem::exists(filePath))
-        {
-            std::cerr << "File not found: " << filePath.string() << std::endl;
-            return -1;
-        }
-        std::cout << "Using file: " << filePath.string() << std::endl;
-        // Load the point cloud from the provided file
-        // TODO: The PointRenderer class should be modified to accept a file path
-        // and load the point cloud from that file.
-        pointCloudFilePath = filePath.string();
-    }
+    // Both take projection, view and lighting from one uniform buffer, written once per frame.
+    pointShader.bindUniformBlock("FrameUniforms", FRAME_UNIFORMS_BINDING);
+    markerShader.bindUniformBlock("FrameUniforms", FRAME_UNIFORMS_BINDING);
+    FrameUniformBuffer frameUniforms;
+    // Light markers and bounding boxes, drawn with the marker shader.
+    DebugDraw debugDraw;
+    // Deferred splatting pipeline, used instead of pointShader when enabled in the menu.
+    SplatRenderer splatRenderer;
+    // Forward rendering that refines the image over several frames while the view is still.
+    ProgressiveRenderer progressiveRenderer;
 
     // Setup ImGui context.
     IMGUI_CHECKVERSION();
@@ -129,20 +287,12 @@ int main(int argc, char* argv[])
 
     Menu menu;  // create an instance of the new Menu class
 
-    PointRenderer renderer(pointCloudFilePath);
-
-    // --- Alternative modes for comparison ---
-    // Parallel OpenCL loading mode (for text-based .pts files)
-    // if (renderer.loadPointCloudParallel(pointCloudFilePath))
-    // {
-    //     renderer.setupBuffers();
-    // }
-
-    // Binary mode loading (for .ply files)
-    // if (renderer.loadPointCloudPly("resources/test.ply"))
-    // {
-    //     renderer.setupBuffers();
-    // }
+    PointRenderer renderer(pointCloudFilePath, loadOptions);
+    renderer.setGpuCulling(gpuCulling);
+    Profiler profiler;
+    SceneFramebuffer sceneFramebuffer;
+    bool mouseWasDown = false;
+    uint64_t framedCloud = 0;
 
     // Main render loop
     while (!glfwWindowShouldClose(window))
@@ -151,6 +301,7 @@ int main(int argc, char* argv[])
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        profiler.beginFrame();
 
         // Process input (this includes menu.processInput which also handles camera updates, etc.)
         menu.processInput(window, camera, deltaTime);
@@ -161,79 +312,157 @@ int main(int argc, char* argv[])
         ImGui::NewFrame();
 
         // Render the menu. (Pass the window pointer so the menu can lock/unlock the mouse.)
-        menu.render(window, camera, renderer, deltaTime);
+        {
+            ProfileScope scope(profiler, "Menu", false);
+            menu.render(window, camera, renderer, profiler, deltaTime);
+        }
+
+        int framebufferWidth = 0, framebufferHeight = 0;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        const float aspect = framebufferHeight > 0 ? static_cast<float>(framebufferWidth) / framebufferHeight
+                                                   : static_cast<float>(SCR_WIDTH) / SCR_HEIGHT;
+
+        // Frame every newly loaded cloud, so large georeferenced clouds are not off-screen.
+        if (renderer.getCloudVersion() != framedCloud)
+        {
+            framedCloud = renderer.getCloudVersion();
+            BoundingSphere sphere = renderer.getBoundingSphere();
+            if (sphere.radius > 0.0f)
+                camera.Frame(sphere.center, sphere.radius, aspect);
+        }
 
         // Clear the screen.
+        if (isReversedZ())
+            sceneFramebuffer.bind(framebufferWidth, framebufferHeight);
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Setup transformation matrices.
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
-                                                static_cast<float>(SCR_WIDTH) / SCR_HEIGHT,
-                                                0.1f, 100.0f);
+        // Setup transformation matrices, with the near and far plane fitted to the cloud.
+        // 'view' is in world coordinates for picking and fitting; everything is drawn with
+        // 'renderView', which only rotates when rendering relative to the camera.
         glm::mat4 view = camera.GetViewMatrix();
+        glm::mat4 renderView = camera.GetRenderViewMatrix();
+        const glm::vec3 renderOrigin = glm::vec3(camera.GetRenderOrigin());
+        renderer.setCameraOrigin(camera.GetRenderOrigin());
+        DepthRange depthRange = fitDepthRange(renderer.getBounds(), renderer.getBoundingSphere(), view);
+        menu.setDepthRange(depthRange);
+        glm::mat4 projection = perspectiveProjection(glm::radians(camera.Zoom), aspect, depthRange);
         glm::mat4 model = glm::mat4(1.0f); // Identity
 
-        // --- Render the main point cloud ---
-        pointShader.use();
-        pointShader.setMat4("projection", projection);
-        pointShader.setMat4("view", view);
-        pointShader.setMat4("model", model);
-        pointShader.setFloat("pointSize", menu.getPointSize());
-        // Set lighting uniforms: pass the values from the menu.
-        pointShader.setBool("useLighting", menu.getLightingEnabled());
+        // Pick a point for the measurement on a left click into the view with the mouse unlocked.
+        bool mouseDown = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        if (mouseDown && !mouseWasDown && menu.getMeasuring() && !io.WantCaptureMouse &&
+            glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_NORMAL)
+        {
+            double cursorX = 0.0, cursorY = 0.0;
+            int windowWidth = 1, windowHeight = 1;
+            glfwGetCursorPos(window, &cursorX, &cursorY);
+            glfwGetWindowSize(window, &windowWidth, &windowHeight);
+            glm::vec2 ndc(2.0f * static_cast<float>(cursorX) / windowWidth - 1.0f,
+                          1.0f - 2.0f * static_cast<float>(cursorY) / windowHeight);
+            glm::mat4 inverse = glm::inverse(projection * view);
+            // A point on the far plane, or on the near plane with reversed-Z; either is on the ray.
+            glm::vec4 rayPoint = inverse * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+            glm::vec3 direction = glm::normalize(glm::vec3(rayPoint) / rayPoint.w - camera.Position);
+            // The pick radius in pixels as the tangent of the cone around the ray.
+            float tanAngle = menu.getPickRadius() * 2.0f * std::tan(glm::radians(camera.Zoom) * 0.5f) / windowHeight;
+            PointRenderer::PickResult pick;
+            if (renderer.pick(camera.Position, direction, tanAngle, pick))
+                menu.getMeasurement().add(pick.position);
+        }
+        mouseWasDown = mouseDown;
+
+        // Set the per-frame uniforms: pass the lighting values from the menu.
+        FrameUniforms uniforms;
+        uniforms.projection = projection;
+        uniforms.view = renderView;
+        uniforms.viewPos = glm::vec4(camera.Position - renderOrigin, 1.0f);
         glm::vec3 offset = glm::vec3(0.0f, 0.0f, -1.0f); // or any small offset in view direction
-        pointShader.setVec3("lightPos", menu.getLightingFollow() ? camera.Position + offset : menu.getLightPos());
-        pointShader.setVec3("viewPos", camera.Position);
-        pointShader.setVec3("lightColor", menu.getLightColor());
-        renderer.render();
+        glm::vec3 lightPos = menu.getLightingFollow() ? camera.Position + offset : menu.getLightPos();
+        uniforms.lightPos = glm::vec4(lightPos - renderOrigin, 1.0f);
+        uniforms.lightColor = glm::vec4(menu.getLightColor(), 1.0f);
+        uniforms.pointSize = menu.getPointSize();
+        uniforms.viewportHeight = static_cast<float>(framebufferHeight);
+        uniforms.adaptivePointSize = menu.getAdaptivePointSize();
+        uniforms.radiusScale = menu.getRadiusScale();
+        uniforms.useLighting = menu.getLightingEnabled();
+        frameUniforms.update(uniforms);
+
+        // Upload the next slice of a cloud that is loading in the background.
+        {
+            ProfileScope scope(profiler, "Upload");
+            renderer.update();
+        }
+
+        // --- Render the main point cloud ---
+        profiler.begin("Points");
+        if (menu.getSplatSettings().enabled)
+        {
+            splatRenderer.render(renderer, projection, renderView, menu.getSplatSettings());
+        }
+        else
+        {
+            pointShader.use();
+            pointShader.setMat4("model", model);
+            if (menu.getProgressiveSettings().enabled)
+                progressiveRenderer.render(renderer, pointShader, uniforms, menu.getProgressiveSettings());
+            else
+                renderer.render(pointShader, projection, renderView);
+        }
+        profiler.end();
 
         // --- Render light markers using a marker shader ---
+        profiler.begin("Markers");
         markerShader.use();
-        markerShader.setMat4("view", view);
-        markerShader.setMat4("projection", projection);
-        markerShader.setMat4("model", glm::mat4(1.0f)); // identity
 
-        // 1. Render the light position marker (10.0 point size)
-        glPointSize(10.0f);
+        // 1. The light position marker (10.0 point size)
         glm::vec3 lightMarker = menu.getLightingFollow() ? camera.Position : menu.getLightPos();
-        markerShader.setVec3("markerColor", menu.getLightColor());
-        {
-            unsigned int markerVAO, markerVBO;
-            glGenVertexArrays(1, &markerVAO);
-            glGenBuffers(1, &markerVBO);
-            glBindVertexArray(markerVAO);
-            glBindBuffer(GL_ARRAY_BUFFER, markerVBO);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3), &lightMarker, GL_STATIC_DRAW);
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-            glDrawArrays(GL_POINTS, 0, 1);
-            glDeleteBuffers(1, &markerVBO);
-            glDeleteVertexArrays(1, &markerVAO);
-        }
+        debugDraw.point(lightMarker, menu.getLightColor(), 10.0f);
 
-        // 2. Render the light direction marker (1.0 point size)
+        // 2. The light direction marker (1.0 point size)
         glm::vec3 lightDirNormalized = glm::normalize(menu.getLightDir());
         glm::vec3 dirMarker = menu.getLightPos() + lightDirNormalized * 1.0f;
-        markerShader.setVec3("markerColor", menu.getLightColor());
-        glPointSize(1.0f);
+        debugDraw.point(dirMarker, menu.getLightColor(), 1.0f);
+
+        // 3. Bounding boxes of the cloud, of its tiles and of their chunks.
+        if (menu.getShowBounds())
         {
-            unsigned int markerVAO, markerVBO;
-            glGenVertexArrays(1, &markerVAO);
-            glGenBuffers(1, &markerVBO);
-            glBindVertexArray(markerVAO);
-            glBindBuffer(GL_ARRAY_BUFFER, markerVBO);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3), &dirMarker, GL_STATIC_DRAW);
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-            glDrawArrays(GL_POINTS, 0, 1);
-            glDeleteBuffers(1, &markerVBO);
-            glDeleteVertexArrays(1, &markerVAO);
+            Bounds cloudBounds = renderer.getBounds();
+            debugDraw.box(cloudBounds.min, cloudBounds.max, glm::vec3(1.0f, 1.0f, 0.0f));
+            const ChunkGrid &chunks = renderer.getChunks();
+            for (const PointRenderer::Tile &tile : renderer.getTiles())
+            {
+                if (renderer.getTiles().size() > 1)
+                    debugDraw.box(tile.bounds.min, tile.bounds.max, glm::vec3(0.0f, 1.0f, 1.0f), tile.transform);
+                for (size_t i = tile.firstChunk; i < tile.firstChunk + tile.chunkCount; ++i)
+                {
+                    glm::vec3 color = renderer.isChunkDrawn(i) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+                    debugDraw.box(glm::vec3(chunks.minX[i], chunks.minY[i], chunks.minZ[i]),
+                                  glm::vec3(chunks.maxX[i], chunks.maxY[i], chunks.maxZ[i]), color, tile.transform);
+                }
+            }
         }
+        // 4. The picked points and the path or polygon through them.
+        const std::vector<glm::vec3> &picked = menu.getMeasurement().getPoints();
+        for (size_t i = 0; i < picked.size(); ++i)
+        {
+            debugDraw.point(picked[i], glm::vec3(1.0f, 0.0f, 1.0f), 8.0f);
+            if (i > 0)
+                debugDraw.line(picked[i - 1], picked[i], glm::vec3(1.0f, 0.0f, 1.0f));
+        }
+        if (menu.getMeasurement().mode == Measurement::Mode::Area && picked.size() > 2)
+            debugDraw.line(picked.back(), picked.front(), glm::vec3(1.0f, 0.0f, 1.0f));
+        debugDraw.flush(renderOrigin);
+
+        profiler.end();
 
-        // Render the ImGui interface on top.
+        // Render the ImGui interface on top, in the window itself.
+        if (isReversedZ())
+            sceneFramebuffer.present();
+        profiler.begin("ImGui");
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        profiler.end();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -0,0 +1,25 @@
+﻿//
+// src/measurement.cpp
+//
+
+#include "measurement.hpp"
+
+float Measurement::length() const
+{
+    float total = 0.0f;
+    for (size_t i = 1; i < points.size(); ++i)
+        total += glm::length(points[i] - points[i - 1]);
+    return total;
+}
+
+float Measurement::area() const
+{
+    if (points.size() < 3)
+        return 0.0f;
+    // Newell's method: half the length of the sum of the edge cross products, taken relative to
+    // the first point to keep the products small.
+    glm::vec3 normal(0.0f);
+    for (size_t i = 1; i + 1 < points.size(); ++i)
+        normal += glm::cross(points[i] - points[0], points[i + 1] - points[0]);
+    return 0.5f * glm::length(normal);
+}
@@ -0,0 +1,34 @@
+﻿//
+// src/measurement.hpp
+//
+
+#ifndef MEASUREMENT_HPP
+#define MEASUREMENT_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Points picked in the view (see PointRenderer::pick()) and what they measure: the length of
+// the path through them, or the area of the polygon they outline.
+class Measurement {
+public:
+    enum class Mode { Distance, Area };
+
+    Mode mode = Mode::Distance;
+
+    void add(const glm::vec3& point) { points.push_back(point); }
+    void removeLast() { if (!points.empty()) points.pop_back(); }
+    void clear() { points.clear(); }
+    const std::vector<glm::vec3>& getPoints() const { return points; }
+
+    // Length of the path from the first to the last point.
+    float length() const;
+    // Area of the polygon through all points, closed back to the first one. Points that are not
+    // in one plane are projected onto the plane that fits them best.
+    float area() const;
+
+private:
+    std::vector<glm::vec3> points;   // world coordinates
+};
+
+#endif // MEASUREMENT_HPP
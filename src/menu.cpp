@@ -3,12 +3,17 @@
 //
 
 #include "menu.hpp"
+#include "lod_format.hpp"
+#include "point_cache.hpp"
+#include "scene_file.hpp"
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
+#include <algorithm>
 #include <filesystem>
 #include <vector>
+#include <cfloat>
 #include <cstdio>
 
 extern bool firstMouse;
@@ -17,12 +22,18 @@ namespace fs = std::filesystem;
 
 Menu::Menu()
     : pointSize(5.0f),
+      adaptivePointSize(false),
+      radiusScale(1.0f),
       lightColor(glm::vec3(1.0f, 1.0f, 1.0f)), // white light
       lightPos(glm::vec3(10.0f, 10.0f, 10.0f)), // light position in world space
       lightDir(glm::vec3(0.0f, -1.0f, 0.0f)), // light direction (default downward)
       lightingEnabled(true), // lighting enabled by default
       lightingFollow(true), // light follows camera by default
+      showBounds(false),
+      measuring(false),
+      pickRadius(5.0f),
       openFileDialog(false),
+      streamAddress("tcp://127.0.0.1:5555"),
       useFpsAverage(true), fpsHistoryMax(60) // average over last 60 frames
 {
 }
@@ -31,11 +42,12 @@ Menu::~Menu()
 {
 }
 
-void Menu::render(GLFWwindow *window, Camera &camera, PointRenderer &renderer, float deltaTime)
+void Menu::render(GLFWwindow *window, Camera &camera, PointRenderer &renderer, Profiler &profiler, float deltaTime)
 {
     // Force menu window to appear at (10,10) with fixed size (300x500)
     ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_Always);
-    ImGui::SetNextWindowSize(ImVec2(350, 470), ImGuiCond_Always);
+    float height = (renderer.getLod() ? 685.0f : 675.0f) + (renderer.isLoading() ? 50.0f : 0.0f);
+    ImGui::SetNextWindowSize(ImVec2(350, height), ImGuiCond_Always);
     ImGui::Begin("Menu");
 
     // Lock mouse button: When clicked, fix the mouse cursor to the camera.
@@ -52,6 +64,7 @@ void Menu::render(GLFWwindow *window, Camera &camera, PointRenderer &renderer, f
     ImGui::BulletText("Up/Down: Increase/Decrease camera speed");
     ImGui::BulletText("Mouse: Look around (when locked)");
     ImGui::BulletText("SPACEBAR: Unlock mouse");
+    ImGui::BulletText("Left click: Pick a point (when measuring)");
     ImGui::BulletText("Load File: Choose a new model");
     ImGui::BulletText("ESC: Exit");
 
@@ -74,11 +87,116 @@ void Menu::render(GLFWwindow *window, Camera &camera, PointRenderer &renderer, f
     }
     ImGui::Checkbox("Average FPS", &useFpsAverage);
 
-    // Point size slider.
-    ImGui::SliderFloat("Point Size", &pointSize, 1.0f, 100.0f, "%.0f");
+    // Per-pass CPU and GPU times (last frame and p50/p95/p99 of the kept history).
+    if (ImGui::CollapsingHeader("Profiler"))
+    {
+        bool profiling = profiler.isEnabled();
+        if (ImGui::Checkbox("Enable Profiler", &profiling))
+            profiler.setEnabled(profiling);
+        ImGui::SameLine();
+        if (ImGui::Button("Dump Profile"))
+            profiler.dump("profile.csv");
+        for (const Profiler::Pass &pass : profiler.getPasses())
+        {
+            Profiler::Summary cpu = profiler.summarize(pass, false);
+            ImGui::Text("%s CPU %.2f ms (p50 %.2f, p95 %.2f, p99 %.2f)", pass.name.c_str(), cpu.last, cpu.p50, cpu.p95, cpu.p99);
+            std::vector<float> samples = profiler.history(pass, pass.gpu);
+            if (pass.gpu)
+            {
+                Profiler::Summary gpu = profiler.summarize(pass, true);
+                ImGui::Text("%*s GPU %.2f ms (p50 %.2f, p95 %.2f, p99 %.2f)", static_cast<int>(pass.name.size()), "",
+                            gpu.last, gpu.p50, gpu.p95, gpu.p99);
+            }
+            std::string label = "##" + pass.name;
+            ImGui::PlotHistogram(label.c_str(), samples.data(), static_cast<int>(samples.size()), 0,
+                                 pass.gpu ? "GPU ms" : "CPU ms", 0.0f, FLT_MAX, ImVec2(0, 40));
+        }
+    }
+
+    // Loaded cloud and vertex format.
+    ImGui::Text("Points: %zu (%.1f MiB on GPU)", renderer.getPointCount(), renderer.getGpuBytes() / (1024.0 * 1024.0));
+    bool compactVertices = renderer.getVertexFormat() == VertexFormat::Compact;
+    if (ImGui::Checkbox("Compact vertices (next load)", &compactVertices))
+        renderer.setVertexFormat(compactVertices ? VertexFormat::Compact : VertexFormat::Full);
+
+    // Bounding boxes of the cloud and its chunks (drawn chunks green, culled ones red).
+    ImGui::Checkbox("Show Bounds", &showBounds);
 
-    // Camera speed slider.
-    ImGui::SliderFloat("Camera Speed", &camera.MovementSpeed, 1.0f, 25.0f, "%.1f");
+    // Frustum culling of the chunks of the loaded cloud.
+    if (!renderer.getLod() && !renderer.getStream())
+    {
+        bool culling = renderer.getFrustumCulling();
+        if (ImGui::Checkbox("Frustum Culling", &culling))
+            renderer.setFrustumCulling(culling);
+        if (renderer.isGpuCullingAvailable())
+        {
+            ImGui::SameLine();
+            bool gpuCulling = renderer.getGpuCulling();
+            if (ImGui::Checkbox("On GPU", &gpuCulling))
+                renderer.setGpuCulling(gpuCulling);
+        }
+        const PointRenderer::ChunkStats &chunkStats = renderer.getChunkStats();
+        ImGui::Text("Chunks: %zu / %zu drawn (%zu ranges), %zu points", chunkStats.chunksDrawn,
+                    chunkStats.chunksTotal, chunkStats.drawRanges, chunkStats.pointsDrawn);
+        ImGui::Text("Tiles: %zu, %zu draw calls (%s)", renderer.getTiles().size(), chunkStats.drawCalls,
+                    renderer.isIndirectDraw() ? "multi-draw indirect" : "multi-draw per tile");
+    }
+
+    // Level of detail controls, only for streamed octree files.
+    if (LodOctree *lod = renderer.getLod())
+    {
+        int budget = static_cast<int>(lod->pointBudget / 1000);
+        if (ImGui::SliderInt("LOD Budget (k points)", &budget, 100, 20000))
+            lod->pointBudget = static_cast<size_t>(budget) * 1000;
+        ImGui::SliderFloat("LOD Min Node Size", &lod->minNodePixels, 10.0f, 500.0f, "%.0f px");
+        const LodOctree::Stats &stats = lod->getStats();
+        ImGui::Text("Nodes: %zu drawn / %zu selected, %zu resident", stats.nodesDrawn, stats.nodesSelected, stats.nodesResident);
+        ImGui::Text("Drawn: %zu points, %zu loads pending", stats.pointsDrawn, stats.pendingLoads);
+    }
+
+    // Live stream controls: the oldest points are evicted past the budget.
+    if (PointStream *stream = renderer.getStream())
+    {
+        int budget = static_cast<int>(stream->pointBudget / 1000);
+        if (ImGui::SliderInt("Stream Budget (k points)", &budget, 100, 50000))
+            stream->pointBudget = static_cast<size_t>(budget) * 1000;
+        const PointStream::Stats &stats = stream->getStats();
+        ImGui::Text("Received: %llu points in %llu batches%s", static_cast<unsigned long long>(stats.pointsReceived),
+                    static_cast<unsigned long long>(stats.batchesReceived),
+                    stats.ended ? " (ended)" : !stats.connected ? " (connecting)" : "");
+        ImGui::Text("Resident: %zu, evicted %llu, dropped %llu", stats.pointsResident,
+                    static_cast<unsigned long long>(stats.pointsEvicted),
+                    static_cast<unsigned long long>(stats.pointsDropped));
+    }
+
+    // Point size: fixed in pixels, or from the point radius (estimated from the neighbour spacing on load).
+    ImGui::Checkbox("Adaptive Point Size", &adaptivePointSize);
+    if (adaptivePointSize)
+        ImGui::SliderFloat("Radius Scale", &radiusScale, 0.25f, 4.0f, "%.2f");
+    else
+        ImGui::SliderFloat("Point Size", &pointSize, 1.0f, 100.0f, "%.0f");
+
+    // Camera speed slider, logarithmic as framing the cloud scales the speed to its size.
+    ImGui::SliderFloat("Camera Speed", &camera.MovementSpeed, MIN_SPEED, MAX_SPEED, "%.2f",
+                       ImGuiSliderFlags_Logarithmic);
+    // Fly back until the whole cloud is in view, as on load.
+    if (ImGui::Button("Frame Cloud"))
+    {
+        BoundingSphere sphere = renderer.getBoundingSphere();
+        int framebufferWidth = 0, framebufferHeight = 0;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        if (sphere.radius > 0.0f && framebufferHeight > 0)
+            camera.Frame(sphere.center, sphere.radius, static_cast<float>(framebufferWidth) / framebufferHeight);
+    }
+    ImGui::SameLine();
+    ImGui::Text("Depth %.3g to %.3g%s", depthRange.nearPlane, depthRange.farPlane,
+                isReversedZ() ? " (reversed-Z)" : "");
+    // Large coordinates are kept in double precision: the cloud relative to its origin, and the
+    // camera subtracted before the transforms are rounded to float.
+    ImGui::Checkbox("Camera-Relative", &camera.CameraRelative);
+    ImGui::SameLine();
+    const glm::dvec3 origin = renderer.getOrigin();
+    ImGui::Text("Origin %.3f, %.3f, %.3f", origin.x, origin.y, origin.z);
 
     ImGui::Separator();
     ImGui::Text("Lighting Controls");
@@ -112,12 +230,93 @@ void Menu::render(GLFWwindow *window, Camera &camera, PointRenderer &renderer, f
     // Follow camera checkbox.
     ImGui::Checkbox("Follow Camera", &lightingFollow);
 
+    // Deferred splatting: lighting per pixel instead of per splat, with optional eye-dome lighting.
+    if (ImGui::CollapsingHeader("Splatting"))
+    {
+        ImGui::Checkbox("Deferred Splatting", &splatSettings.enabled);
+        if (splatSettings.enabled)
+        {
+            ImGui::SliderFloat("Blend Depth", &splatSettings.depthOffset, 0.0f, 0.05f, "%.3f");
+            ImGui::Checkbox("Eye-Dome Lighting", &splatSettings.eyeDomeLighting);
+            ImGui::SliderFloat("EDL Strength", &splatSettings.edlStrength, 0.0f, 5.0f, "%.2f");
+            ImGui::SliderFloat("EDL Radius", &splatSettings.edlRadius, 0.5f, 4.0f, "%.1f");
+        }
+    }
+
+    // Progressive rendering: a share of the points while moving, the rest added while still.
+    if (ImGui::CollapsingHeader("Progressive"))
+    {
+        ImGui::Checkbox("Progressive Rendering", &progressiveSettings.enabled);
+        if (progressiveSettings.enabled)
+        {
+            ImGui::SliderFloat("Moving Density", &progressiveSettings.movingFraction, 0.01f, 1.0f, "%.2f");
+            ImGui::SliderFloat("Refine Step", &progressiveSettings.refineFraction, 0.01f, 1.0f, "%.2f");
+            if (splatSettings.enabled)
+                ImGui::TextDisabled("Not used with deferred splatting");
+        }
+    }
+
+    // Distance and area between points picked with the mouse, found with the k-d trees of the cloud.
+    if (ImGui::CollapsingHeader("Measure"))
+    {
+        ImGui::Checkbox("Pick Points", &measuring);
+        ImGui::SameLine();
+        int mode = static_cast<int>(measurement.mode);
+        ImGui::RadioButton("Distance", &mode, static_cast<int>(Measurement::Mode::Distance));
+        ImGui::SameLine();
+        ImGui::RadioButton("Area", &mode, static_cast<int>(Measurement::Mode::Area));
+        measurement.mode = static_cast<Measurement::Mode>(mode);
+        ImGui::SliderFloat("Pick Radius", &pickRadius, 1.0f, 20.0f, "%.0f px");
+        const std::vector<glm::vec3> &picked = measurement.getPoints();
+        if (measurement.mode == Measurement::Mode::Distance)
+            ImGui::Text("%zu points, distance %.4f", picked.size(), measurement.length());
+        else
+            ImGui::Text("%zu points, area %.4f", picked.size(), measurement.area());
+        if (!picked.empty())
+        {
+            // In the coordinates of the file, which may be too large for float.
+            const glm::dvec3 last = renderer.getOrigin() + glm::dvec3(picked.back());
+            ImGui::Text("Last: %.3f, %.3f, %.3f", last.x, last.y, last.z);
+        }
+        if (renderer.getLod() || renderer.getStream())
+            ImGui::TextDisabled("Picking is not available for LOD files and streams");
+        if (ImGui::Button("Undo"))
+            measurement.removeLast();
+        ImGui::SameLine();
+        if (ImGui::Button("Clear"))
+            measurement.clear();
+    }
+
     // Load file button.
     if (ImGui::Button("Load File"))
     {
         openFileDialog = true;
     }
 
+    // Progress of a background load. The current cloud is shown until the new one is ready.
+    if (renderer.isLoading())
+    {
+        const LoadProgress &progress = renderer.getLoadProgress();
+        float upload = renderer.getUploadProgress();
+        char overlay[96];
+        if (upload > 0.0f)
+        {
+            snprintf(overlay, sizeof(overlay), "Uploading %.0f%%", upload * 100.0f);
+            ImGui::ProgressBar(upload, ImVec2(-1, 0), overlay);
+        }
+        else
+        {
+            double mib = 1024.0 * 1024.0;
+            uint64_t total = progress.bytesTotal;
+            float fraction = total > 0 ? static_cast<float>(static_cast<double>(progress.bytesRead) / total) : 0.0f;
+            snprintf(overlay, sizeof(overlay), "%.0f / %.0f MiB, %llu points", progress.bytesRead / mib, total / mib,
+                     static_cast<unsigned long long>(progress.pointsParsed));
+            ImGui::ProgressBar(fraction, ImVec2(-1, 0), overlay);
+        }
+        if (ImGui::Button("Cancel Load"))
+            renderer.cancelLoad();
+    }
+
     // Reset to defaults button.
     if (ImGui::Button("Reset"))
     {
@@ -137,14 +336,19 @@ void Menu::render(GLFWwindow *window, Camera &camera, PointRenderer &renderer, f
         if (fs::exists(resourceDir) && fs::is_directory(resourceDir))
         {
             ImGui::Text("Files in: %s", resourceDir.string().c_str());
-            // List .pts and .ply files in the current directory.
+            // List .pts, .ply, .pcc (cache), .lod (octree) and .scene files and named pipes in the current directory.
             std::vector<std::string> files;
             for (const auto &entry : fs::directory_iterator(resourceDir))
             {
-                if (entry.is_regular_file())
+                if (entry.is_fifo())
+                {
+                    files.push_back(entry.path().string());
+                }
+                else if (entry.is_regular_file())
                 {
                     auto ext = entry.path().extension().string();
-                    if (ext == ".pts" || ext == ".ply")
+                    if (ext == ".pts" || ext == ".ply" || ext == POINT_CACHE_EXTENSION || ext == LOD_EXTENSION ||
+                        ext == SCENE_EXTENSION)
                     {
                         files.push_back(entry.path().string());
                     }
@@ -158,10 +362,7 @@ void Menu::render(GLFWwindow *window, Camera &camera, PointRenderer &renderer, f
                 {
                     selectedFile = f;
                     openFileDialog = false;
-                    if (!renderer.loadPointCloud(selectedFile))
-                    {
-                        printf("Failed to load file: %s\n", selectedFile.c_str());
-                    }
+                    renderer.loadPointCloudAsync(selectedFile);
                 }
             }
         }
@@ -169,6 +370,17 @@ void Menu::render(GLFWwindow *window, Camera &camera, PointRenderer &renderer, f
         {
             ImGui::Text("Resources folder not found: %s", resourceDir.string().c_str());
         }
+
+        // Live stream from a scanner or PointStreamGenerator: "-", tcp://host:port or a named pipe.
+        ImGui::Separator();
+        ImGui::InputText("Stream", streamAddress, sizeof(streamAddress));
+        ImGui::SameLine();
+        if (ImGui::Button("Connect"))
+        {
+            selectedFile = streamAddress;
+            openFileDialog = false;
+            renderer.loadPointCloudAsync(selectedFile);
+        }
         ImGui::End();
     }
     ImGui::End();
@@ -205,18 +417,13 @@ void Menu::processInput(GLFWwindow *window, Camera &camera, float deltaTime)
             pointSize -= 1.0f;
         }
     }
+    // Relative steps, so the speed changes as quickly on a city as on a statue.
     if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
     {
-        if (camera.MovementSpeed < 25.0f)
-        {
-            camera.MovementSpeed += 0.1f;
-        }
+        camera.MovementSpeed = std::min(camera.MovementSpeed * 1.02f, MAX_SPEED);
     }
     if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
     {
-        if (camera.MovementSpeed > 1.0f)
-        {
-            camera.MovementSpeed -= 0.1f;
-        }
+        camera.MovementSpeed = std::max(camera.MovementSpeed / 1.02f, MIN_SPEED);
     }
 }
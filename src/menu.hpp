@@ -7,7 +7,12 @@
 
 #include <string>
 #include <vector>
+#include "depth_range.hpp"
+#include "measurement.hpp"
 #include "point_renderer.hpp"
+#include "profiler.hpp"
+#include "progressive_renderer.hpp"
+#include "splat_renderer.hpp"
 #include <GLFW/glfw3.h> // Needed for GLFWwindow*
 #include <camera.hpp>
 
@@ -23,8 +28,9 @@ public:
     // 'window' is used for locking/unlocking the mouse.
     // 'camera' is used for adjusting camera properties.
     // 'renderer' is used for model reloading.
+    // 'profiler' provides the per-pass frame timings.
     // 'deltaTime' is time elapsed since last frame.
-    void Menu::render(GLFWwindow *window, Camera &camera, PointRenderer &renderer, float deltaTime);
+    void render(GLFWwindow *window, Camera &camera, PointRenderer &renderer, Profiler &profiler, float deltaTime);
 
     // Returns the current point size, as set in the slider.
     float getPointSize() const { return pointSize; }
@@ -35,21 +41,42 @@ public:
     void setLightColor(glm::vec3 color) { lightColor = color; }
     glm::vec3 getLightPos() const { return lightPos; }
     void setLightPos(glm::vec3 pos) { lightPos = pos; }
-    void Menu::processInput(GLFWwindow *window, Camera &camera, float deltaTime);
+    void processInput(GLFWwindow *window, Camera &camera, float deltaTime);
     glm::vec3 getLightDir() const { return lightDir; }
     void setLightDir(const glm::vec3 &dir) { lightDir = dir; }
     bool getLightingEnabled() const { return lightingEnabled; }
     bool getLightingFollow() const { return lightingFollow; }
+    bool getShowBounds() const { return showBounds; }
+    bool getAdaptivePointSize() const { return adaptivePointSize; }
+    float getRadiusScale() const { return radiusScale; }
+    const SplatSettings& getSplatSettings() const { return splatSettings; }
+    const ProgressiveSettings& getProgressiveSettings() const { return progressiveSettings; }
+    // Whether a left click into the view picks a point for 'measurement'.
+    bool getMeasuring() const { return measuring; }
+    float getPickRadius() const { return pickRadius; }
+    Measurement& getMeasurement() { return measurement; }
+    // Near and far plane of the last frame, shown next to the camera controls.
+    void setDepthRange(const DepthRange& range) { depthRange = range; }
 
 private:
     float pointSize;           // Current point size (1 to 100)
+    bool adaptivePointSize;    // Size points by their radius and distance instead of pointSize
+    float radiusScale;         // Factor on the point radius with adaptivePointSize
     glm::vec3 lightColor;      // Light color (RGB) for the light source
     glm::vec3 lightPos;        // Light position (XYZ) in world space
     glm::vec3 lightDir;        // Light direction (XYZ) for the marker
     bool lightingEnabled;      // Toggle for lighting (true = enabled, default)
     bool lightingFollow;       // Toggle for light position following the camera
+    bool showBounds;           // Toggle for drawing the cloud and chunk bounding boxes
+    SplatSettings splatSettings; // Forward or deferred point rendering and eye-dome lighting
+    ProgressiveSettings progressiveSettings; // Refining the forward rendering over several frames
+    bool measuring;            // Pick points with the mouse (when unlocked)
+    float pickRadius;          // How far from the cursor a point may be picked, in pixels
+    Measurement measurement;   // Picked points, drawn as a path or polygon
+    DepthRange depthRange;     // Near and far plane fitted to the cloud
     bool openFileDialog;       // Whether the file chooser dialog is open
     std::string selectedFile;  // Stores the selected file path
+    char streamAddress[256];   // Live stream to connect to from the file chooser
 
     // FPS averaging members.
     bool useFpsAverage;               // If true, display averaged FPS (default: true)
@@ -0,0 +1,124 @@
+﻿//
+// src/neighborhood.cpp
+//
+
+#include "neighborhood.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace {
+
+// Upper limit for 'k', so the neighbour lists fit on the stack.
+constexpr unsigned MAX_NEIGHBOURS = 64;
+
+// Unit eigenvector of the smallest eigenvalue of the symmetric matrix
+// [xx xy xz; xy yy yz; xz yz zz], or zero if the matrix is isotropic.
+glm::vec3 smallestEigenvector(double xx, double xy, double xz, double yy, double yz, double zz)
+{
+    // Eigenvalues in closed form (trigonometric solution of the characteristic polynomial).
+    const double offDiagonal = xy * xy + xz * xz + yz * yz;
+    const double q = (xx + yy + zz) / 3.0;
+    const double p2 = (xx - q) * (xx - q) + (yy - q) * (yy - q) + (zz - q) * (zz - q) + 2.0 * offDiagonal;
+    const double p = std::sqrt(p2 / 6.0);
+    if (p <= 0.0)
+        return glm::vec3(0.0f);
+    const double bxx = (xx - q) / p, byy = (yy - q) / p, bzz = (zz - q) / p;
+    const double bxy = xy / p, bxz = xz / p, byz = yz / p;
+    const double det = bxx * (byy * bzz - byz * byz) - bxy * (bxy * bzz - byz * bxz) + bxz * (bxy * byz - byy * bxz);
+    const double phi = std::acos(std::clamp(det / 2.0, -1.0, 1.0)) / 3.0;
+    const double smallest = q + 2.0 * p * std::cos(phi + 2.0 * 3.14159265358979323846 / 3.0);
+
+    // The eigenvector is orthogonal to the rows of (A - smallest * I); take the most stable cross product.
+    const glm::dvec3 r0(xx - smallest, xy, xz);
+    const glm::dvec3 r1(xy, yy - smallest, yz);
+    const glm::dvec3 r2(xz, yz, zz - smallest);
+    const glm::dvec3 c0 = glm::cross(r0, r1), c1 = glm::cross(r0, r2), c2 = glm::cross(r1, r2);
+    const double d0 = glm::dot(c0, c0), d1 = glm::dot(c1, c1), d2 = glm::dot(c2, c2);
+    const glm::dvec3 &best = d0 >= d1 && d0 >= d2 ? c0 : (d1 >= d2 ? c1 : c2);
+    const double length2 = std::max({d0, d1, d2});
+    if (length2 <= 0.0)
+        return glm::vec3(0.0f);
+    return glm::vec3(best / std::sqrt(length2));
+}
+
+} // namespace
+
+void estimatePointRadii(std::vector<Point> &points, const KdTree &tree, unsigned k)
+{
+    k = std::min(std::max(k, 1u), MAX_NEIGHBOURS);
+    ThreadPool::instance().parallelFor(0, points.size(), [&](size_t first, size_t last) {
+        uint32_t indices[MAX_NEIGHBOURS + 1];
+        float distances2[MAX_NEIGHBOURS + 1];
+        for (size_t i = first; i < last; ++i) {
+            // The point itself is its own nearest neighbour.
+            size_t found = tree.nearest(points[i].position, k + 1, indices, distances2);
+            float sum = 0.0f;
+            for (size_t n = 1; n < found; ++n)
+                sum += std::sqrt(distances2[n]);
+            points[i].radius = found > 1 ? sum / static_cast<float>(found - 1) : 0.0f;
+        }
+    }, 1 << 12);
+}
+
+bool hasNormals(const std::vector<Point> &points)
+{
+    std::atomic<bool> found{false};
+    ThreadPool::instance().parallelFor(0, points.size(), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last && !found.load(std::memory_order_relaxed); ++i) {
+            if (points[i].normal != glm::vec3(0.0f)) {
+                found = true;
+                return;
+            }
+        }
+    }, 1 << 16);
+    return found;
+}
+
+void estimateNormals(std::vector<Point> &points, const KdTree &tree, unsigned k)
+{
+    k = std::min(std::max(k, 3u), MAX_NEIGHBOURS);
+    const Bounds bounds = computeBounds(points);
+    const glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    ThreadPool::instance().parallelFor(0, points.size(), [&](size_t first, size_t last) {
+        uint32_t indices[MAX_NEIGHBOURS];
+        float distances2[MAX_NEIGHBOURS];
+        // Neighbour coordinates as separate arrays, so the sums below vectorize.
+        float x[MAX_NEIGHBOURS], y[MAX_NEIGHBOURS], z[MAX_NEIGHBOURS];
+        for (size_t i = first; i < last; ++i) {
+            const glm::vec3 origin = points[i].position;
+            const size_t found = tree.nearest(origin, k, indices, distances2);
+            if (found < 3) {
+                points[i].normal = glm::vec3(0.0f);
+                continue;
+            }
+            // Relative to the point itself, which keeps the sums precise far from the origin.
+            for (size_t n = 0; n < found; ++n) {
+                const glm::vec3 d = points[indices[n]].position - origin;
+                x[n] = d.x;
+                y[n] = d.y;
+                z[n] = d.z;
+            }
+            float sx = 0, sy = 0, sz = 0, sxx = 0, sxy = 0, sxz = 0, syy = 0, syz = 0, szz = 0;
+            for (size_t n = 0; n < found; ++n) {
+                sx += x[n];
+                sy += y[n];
+                sz += z[n];
+                sxx += x[n] * x[n];
+                sxy += x[n] * y[n];
+                sxz += x[n] * z[n];
+                syy += y[n] * y[n];
+                syz += y[n] * z[n];
+                szz += z[n] * z[n];
+            }
+            const double inv = 1.0 / static_cast<double>(found);
+            const double mx = sx * inv, my = sy * inv, mz = sz * inv;
+            glm::vec3 normal = smallestEigenvector(sxx * inv - mx * mx, sxy * inv - mx * my, sxz * inv - mx * mz,
+                                                   syy * inv - my * my, syz * inv - my * mz, szz * inv - mz * mz);
+            if (glm::dot(normal, origin - center) < 0.0f)
+                normal = -normal;
+            points[i].normal = normal;
+        }
+    }, 1 << 12);
+}
@@ -0,0 +1,29 @@
+﻿//
+// src/neighborhood.hpp
+//
+
+#ifndef NEIGHBORHOOD_HPP
+#define NEIGHBORHOOD_HPP
+
+#include <vector>
+#include "kd_tree.hpp"
+#include "point.hpp"
+
+// Number of neighbours the per-point estimates look at.
+constexpr unsigned DEFAULT_NEIGHBOURS = 8;
+constexpr unsigned DEFAULT_NORMAL_NEIGHBOURS = 16;
+
+// Set the radius of every point to the mean distance to its 'k' nearest neighbours, so splats
+// of that radius just cover the surface. 'tree' must be built over 'points'. Runs on the thread pool.
+void estimatePointRadii(std::vector<Point>& points, const KdTree& tree, unsigned k = DEFAULT_NEIGHBOURS);
+
+// True if any point has a non-zero normal.
+bool hasNormals(const std::vector<Point>& points);
+
+// Set the normal of every point to the direction of least variance of its 'k' nearest
+// neighbours (the eigenvector of the smallest eigenvalue of their covariance). The sign is
+// chosen to point away from the center of the cloud bounds, as the scanner position is unknown.
+// 'tree' must be built over 'points'. Runs on the thread pool.
+void estimateNormals(std::vector<Point>& points, const KdTree& tree, unsigned k = DEFAULT_NORMAL_NEIGHBOURS);
+
+#endif // NEIGHBORHOOD_HPP
@@ -0,0 +1,573 @@
+﻿//
+// src/ply_reader.cpp
+//
+
+#include "ply_reader.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// Points are decoded in blocks of this many vertices per task.
+constexpr size_t VERTICES_PER_BLOCK = 1 << 16;
+
+bool parsePlyType(const std::string &name, PlyType &type)
+{
+    if (name == "char" || name == "int8")          type = PlyType::Int8;
+    else if (name == "uchar" || name == "uint8")   type = PlyType::UInt8;
+    else if (name == "short" || name == "int16")   type = PlyType::Int16;
+    else if (name == "ushort" || name == "uint16") type = PlyType::UInt16;
+    else if (name == "int" || name == "int32")     type = PlyType::Int32;
+    else if (name == "uint" || name == "uint32")   type = PlyType::UInt32;
+    else if (name == "float" || name == "float32") type = PlyType::Float32;
+    else if (name == "double" || name == "float64") type = PlyType::Float64;
+    else return false;
+    return true;
+}
+
+size_t plyTypeSize(PlyType type)
+{
+    switch (type) {
+        case PlyType::Int8:    case PlyType::UInt8:  return 1;
+        case PlyType::Int16:   case PlyType::UInt16: return 2;
+        case PlyType::Int32:   case PlyType::UInt32: case PlyType::Float32: return 4;
+        case PlyType::Float64: return 8;
+    }
+    return 0;
+}
+
+// Scale that maps the full range of an integer color channel to [0,1].
+float colorScale(PlyType type)
+{
+    switch (type) {
+        case PlyType::Int8:    return 1.0f / 127.0f;
+        case PlyType::UInt8:   return 1.0f / 255.0f;
+        case PlyType::Int16:   return 1.0f / 32767.0f;
+        case PlyType::UInt16:  return 1.0f / 65535.0f;
+        case PlyType::Int32:   return 1.0f / 2147483647.0f;
+        case PlyType::UInt32:  return 1.0f / 4294967295.0f;
+        default:               return 1.0f;
+    }
+}
+
+bool hostIsLittleEndian()
+{
+    const uint16_t probe = 1;
+    unsigned char firstByte;
+    std::memcpy(&firstByte, &probe, 1);
+    return firstByte == 1;
+}
+
+template <typename T>
+T loadScalar(const char *p, bool swap)
+{
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, p, sizeof(T));
+    if (swap)
+        std::reverse(bytes, bytes + sizeof(T));
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+double loadValue(const char *p, PlyType type, bool swap)
+{
+    switch (type) {
+        case PlyType::Int8:    return loadScalar<int8_t>(p, swap);
+        case PlyType::UInt8:   return loadScalar<uint8_t>(p, swap);
+        case PlyType::Int16:   return loadScalar<int16_t>(p, swap);
+        case PlyType::UInt16:  return loadScalar<uint16_t>(p, swap);
+        case PlyType::Int32:   return loadScalar<int32_t>(p, swap);
+        case PlyType::UInt32:  return loadScalar<uint32_t>(p, swap);
+        case PlyType::Float32: return loadScalar<float>(p, swap);
+        case PlyType::Float64: return loadScalar<double>(p, swap);
+    }
+    return 0.0;
+}
+
+// Index of a Point member component written by a vertex property (see Point in point.hpp).
+enum PointField {
+    FIELD_X, FIELD_Y, FIELD_Z,
+    FIELD_R, FIELD_G, FIELD_B,
+    FIELD_NX, FIELD_NY, FIELD_NZ,
+    FIELD_COUNT,
+    FIELD_NONE = FIELD_COUNT
+};
+
+int pointField(const std::string &name)
+{
+    if (name == "x") return FIELD_X;
+    if (name == "y") return FIELD_Y;
+    if (name == "z") return FIELD_Z;
+    if (name == "red" || name == "r" || name == "diffuse_red") return FIELD_R;
+    if (name == "green" || name == "g" || name == "diffuse_green") return FIELD_G;
+    if (name == "blue" || name == "b" || name == "diffuse_blue") return FIELD_B;
+    if (name == "nx") return FIELD_NX;
+    if (name == "ny") return FIELD_NY;
+    if (name == "nz") return FIELD_NZ;
+    return FIELD_NONE;
+}
+
+// How one vertex property ends up in a Point.
+struct FieldDecoder {
+    size_t offset;  // byte offset inside a binary vertex record
+    PlyType type;
+    int field;
+    float scale;
+};
+
+bool isPositionField(int field)
+{
+    return field >= FIELD_X && field <= FIELD_Z;
+}
+
+// Positions are kept in double until the origin is subtracted, see writePosition().
+void writeField(Point &pt, int field, float value)
+{
+    switch (field) {
+        case FIELD_R:  pt.color.r = value; break;
+        case FIELD_G:  pt.color.g = value; break;
+        case FIELD_B:  pt.color.b = value; break;
+        case FIELD_NX: pt.normal.x = value; break;
+        case FIELD_NY: pt.normal.y = value; break;
+        case FIELD_NZ: pt.normal.z = value; break;
+        default: break;
+    }
+}
+
+void writePosition(Point &pt, const glm::dvec3 &position, const glm::dvec3 &origin)
+{
+    pt.position = glm::vec3(position - origin);
+}
+
+// Decode the position of one binary record in double precision.
+glm::dvec3 decodePosition(const char *record, const std::vector<FieldDecoder> &decoders, bool swap)
+{
+    glm::dvec3 position(0.0);
+    for (const FieldDecoder &decoder : decoders) {
+        if (isPositionField(decoder.field))
+            position[decoder.field] = loadValue(record + decoder.offset, decoder.type, swap);
+    }
+    return position;
+}
+
+Point defaultPoint()
+{
+    Point pt;
+    pt.position = glm::vec3(0.0f);
+    pt.color = glm::vec3(1.0f);
+    pt.normal = glm::vec3(0.0f);
+    return pt;
+}
+
+// Checks a list count read from the file before it is used as a size: it has to be a whole,
+// non-negative number of at most 'maxItems' items.
+bool readListCount(double count, size_t maxItems, size_t &items)
+{
+    if (!(count >= 0.0) || count != std::floor(count) || count > static_cast<double>(maxItems))
+        return false;
+    items = static_cast<size_t>(count);
+    return true;
+}
+
+// Advance past one binary element record, following list counts where present.
+bool skipBinaryRecord(const char *&p, const char *end, const PlyElement &element, bool swap)
+{
+    for (const PlyProperty &prop : element.properties) {
+        if (prop.isList) {
+            size_t countSize = plyTypeSize(prop.countType);
+            if (static_cast<size_t>(end - p) < countSize)
+                return false;
+            double count = loadValue(p, prop.countType, swap);
+            p += countSize;
+            const size_t itemSize = plyTypeSize(prop.type);
+            size_t items = 0;
+            if (!readListCount(count, static_cast<size_t>(end - p) / itemSize, items))
+                return false;
+            p += items * itemSize;
+        } else {
+            size_t size = plyTypeSize(prop.type);
+            if (static_cast<size_t>(end - p) < size)
+                return false;
+            p += size;
+        }
+    }
+    return true;
+}
+
+bool hasListProperty(const PlyElement &element)
+{
+    return std::any_of(element.properties.begin(), element.properties.end(),
+                       [](const PlyProperty &prop) { return prop.isList; });
+}
+
+// Decode the vertices [first, first + count) into 'points'. 'origin' is chosen from the first
+// vertex of the element when 'first' is 0, and used as it is otherwise.
+bool readBinaryVertices(const char *data, const char *end, const PlyElement &vertex, bool swap, size_t first,
+                        size_t count, std::vector<Point> &points, glm::dvec3 &origin, LoadProgress *progress)
+{
+    if (hasListProperty(vertex)) {
+        std::cerr << "[PLY Mode] List properties in the vertex element are not supported." << std::endl;
+        return false;
+    }
+
+    std::vector<FieldDecoder> decoders;
+    size_t stride = 0;
+    for (const PlyProperty &prop : vertex.properties) {
+        int field = pointField(prop.name);
+        if (field != FIELD_NONE) {
+            bool isColor = field >= FIELD_R && field <= FIELD_B;
+            decoders.push_back({stride, prop.type, field, isColor ? colorScale(prop.type) : 1.0f});
+        }
+        stride += plyTypeSize(prop.type);
+    }
+
+    if (stride == 0 || static_cast<size_t>(end - data) / stride < vertex.count) {
+        std::cerr << "[PLY Mode] Error reading binary PLY data." << std::endl;
+        return false;
+    }
+
+    points.resize(count);
+    ThreadPool &pool = ThreadPool::instance();
+    if (first == 0)
+        origin = vertex.count > 0 ? chooseOrigin(decodePosition(data, decoders, swap)) : glm::dvec3(0.0);
+    data += first * stride;
+    const bool rebase = origin != glm::dvec3(0.0);
+
+    // When the records are laid out exactly like the file attributes of Point (nine floats in
+    // member order, host byte order), each record is copied into its Point with one memcpy instead
+    // of decoding its fields. The records are 36 bytes and Points 40, so this is not a bulk copy,
+    // and the points still get radii and are sorted into chunks before they are uploaded. Only a
+    // load from the .pcc cache uploads the file data without converting it.
+    constexpr size_t RECORD_BYTES = offsetof(Point, radius);
+    bool matchesPointLayout = !swap && stride == RECORD_BYTES && decoders.size() == FIELD_COUNT;
+    for (size_t i = 0; matchesPointLayout && i < decoders.size(); ++i) {
+        matchesPointLayout = decoders[i].type == PlyType::Float32 && decoders[i].field == static_cast<int>(i)
+                             && decoders[i].offset == i * sizeof(float);
+    }
+    if (matchesPointLayout) {
+        pool.parallelFor(0, count, [&](size_t begin, size_t last) {
+            if (progress && progress->cancelled())
+                return;
+            for (size_t i = begin; i < last; ++i)
+                std::memcpy(reinterpret_cast<char*>(&points[i]), data + i * RECORD_BYTES, RECORD_BYTES);
+            // Float positions far from zero are already rounded in the file, but are still rebased
+            // so the whole cloud shares one origin.
+            for (size_t i = begin; rebase && i < last; ++i)
+                writePosition(points[i], glm::dvec3(points[i].position), origin);
+            reportProgress(progress, (last - begin) * RECORD_BYTES, last - begin);
+        }, VERTICES_PER_BLOCK);
+        if (progress && progress->cancelled())
+            return false;
+        if (first == 0)
+            std::cout << "[PLY Mode] Vertex layout matches Point, copied without decoding the fields." << std::endl;
+        return true;
+    }
+
+    pool.parallelFor(0, count, [&](size_t begin, size_t last) {
+        if (progress && progress->cancelled())
+            return;
+        const char *record = data + begin * stride;
+        for (size_t i = begin; i < last; ++i, record += stride) {
+            Point pt = defaultPoint();
+            glm::dvec3 position(0.0);
+            for (const FieldDecoder &decoder : decoders) {
+                double value = loadValue(record + decoder.offset, decoder.type, swap);
+                if (isPositionField(decoder.field))
+                    position[decoder.field] = value;
+                else
+                    writeField(pt, decoder.field, static_cast<float>(value) * decoder.scale);
+            }
+            writePosition(pt, position, origin);
+            points[i] = pt;
+        }
+        reportProgress(progress, (last - begin) * stride, last - begin);
+    }, VERTICES_PER_BLOCK);
+    return !(progress && progress->cancelled());
+}
+
+// Returns the start of the next line, or 'end'.
+const char *nextLine(const char *p, const char *end)
+{
+    const char *newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+bool readAsciiValue(const char *&p, const char *lineEnd, double &value)
+{
+    while (p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r'))
+        ++p;
+    if (p < lineEnd && *p == '+')
+        ++p;
+    auto [ptr, ec] = std::from_chars(p, lineEnd, value);
+    if (ec != std::errc())
+        return false;
+    p = ptr;
+    return true;
+}
+
+// Decode 'count' vertices starting at 'p', which are the vertices [first, first + count) of the
+// element, and leave 'p' after them. 'origin' is chosen from vertex 0 as in readBinaryVertices().
+bool readAsciiVertices(const char *&p, const char *end, const PlyElement &vertex, size_t first, size_t count,
+                       std::vector<Point> &points, glm::dvec3 &origin, LoadProgress *progress)
+{
+    std::vector<int> fields;
+    std::vector<float> scales;
+    for (const PlyProperty &prop : vertex.properties) {
+        int field = prop.isList ? FIELD_NONE : pointField(prop.name);
+        fields.push_back(field);
+        bool isColor = field >= FIELD_R && field <= FIELD_B;
+        scales.push_back(isColor ? colorScale(prop.type) : 1.0f);
+    }
+
+    // Every vertex takes at least one byte, so a header claiming more vertices than that is
+    // rejected before allocating for them.
+    if (static_cast<size_t>(end - p) < count) {
+        std::cerr << "[PLY Mode] File is too short for " << first + count << " vertices." << std::endl;
+        return false;
+    }
+    points.resize(count);
+    const char *reported = p;
+    for (size_t i = 0; i < count; ++i) {
+        if (i % VERTICES_PER_BLOCK == 0 && i > 0) {
+            if (!reportProgress(progress, p - reported, VERTICES_PER_BLOCK))
+                return false;
+            reported = p;
+        }
+        if (p >= end) {
+            std::cerr << "[PLY Mode] Unexpected end of file at vertex " << first + i << std::endl;
+            return false;
+        }
+        const char *lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!lineEnd)
+            lineEnd = end;
+        Point pt = defaultPoint();
+        glm::dvec3 position(0.0);
+        for (size_t j = 0; j < vertex.properties.size(); ++j) {
+            const PlyProperty &prop = vertex.properties[j];
+            double value;
+            if (!readAsciiValue(p, lineEnd, value)) {
+                std::cerr << "[PLY Mode] Failed to read vertex " << first + i << std::endl;
+                return false;
+            }
+            if (prop.isList) {
+                // Skip the list items, each of which takes at least one byte of the line.
+                size_t items = 0;
+                if (!readListCount(value, static_cast<size_t>(lineEnd - p), items)) {
+                    std::cerr << "[PLY Mode] Invalid list count at vertex " << first + i << std::endl;
+                    return false;
+                }
+                for (size_t k = 0; k < items; ++k) {
+                    double item;
+                    if (!readAsciiValue(p, lineEnd, item)) {
+                        std::cerr << "[PLY Mode] Failed to read vertex " << first + i << std::endl;
+                        return false;
+                    }
+                }
+                continue;
+            }
+            if (isPositionField(fields[j]))
+                position[fields[j]] = value;
+            else
+                writeField(pt, fields[j], static_cast<float>(value) * scales[j]);
+        }
+        if (first + i == 0)
+            origin = chooseOrigin(position);
+        writePosition(pt, position, origin);
+        points[i] = pt;
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+    size_t lastBlock = count == 0 ? 0 : (count - 1) % VERTICES_PER_BLOCK + 1;
+    reportProgress(progress, p - reported, lastBlock);
+    return true;
+}
+
+} // namespace
+
+bool parsePlyHeader(const char *begin, const char *end, PlyHeader &header)
+{
+    header = PlyHeader();
+    const char *p = begin;
+    bool first = true;
+    bool formatFound = false;
+    while (p < end) {
+        const char *next = nextLine(p, end);
+        std::string line(p, next);
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+            line.pop_back();
+        p = next;
+
+        if (first) {
+            if (line != "ply") {
+                std::cerr << "[PLY Mode] Missing 'ply' magic at the start of the file." << std::endl;
+                return false;
+            }
+            first = false;
+            continue;
+        }
+
+        std::istringstream iss(line);
+        std::string keyword;
+        iss >> keyword;
+        if (keyword == "format") {
+            std::string format;
+            iss >> format;
+            if (format == "ascii")
+                header.format = PlyFormat::Ascii;
+            else if (format == "binary_little_endian")
+                header.format = PlyFormat::BinaryLittleEndian;
+            else if (format == "binary_big_endian")
+                header.format = PlyFormat::BinaryBigEndian;
+            else {
+                std::cerr << "[PLY Mode] Unsupported format: " << format << std::endl;
+                return false;
+            }
+            formatFound = true;
+        } else if (keyword == "element") {
+            PlyElement element;
+            if (!(iss >> element.name >> element.count)) {
+                std::cerr << "[PLY Mode] Malformed element line: " << line << std::endl;
+                return false;
+            }
+            header.elements.push_back(element);
+        } else if (keyword == "property") {
+            if (header.elements.empty()) {
+                std::cerr << "[PLY Mode] Property outside of an element: " << line << std::endl;
+                return false;
+            }
+            PlyProperty prop;
+            std::string type;
+            iss >> type;
+            bool ok;
+            if (type == "list") {
+                std::string countType, itemType;
+                prop.isList = true;
+                ok = static_cast<bool>(iss >> countType >> itemType >> prop.name)
+                     && parsePlyType(countType, prop.countType) && parsePlyType(itemType, prop.type);
+            } else {
+                ok = static_cast<bool>(iss >> prop.name) && parsePlyType(type, prop.type);
+            }
+            if (!ok) {
+                std::cerr << "[PLY Mode] Malformed property line: " << line << std::endl;
+                return false;
+            }
+            header.elements.back().properties.push_back(prop);
+        } else if (keyword == "end_header") {
+            if (!formatFound) {
+                std::cerr << "[PLY Mode] 'format' line not found in header." << std::endl;
+                return false;
+            }
+            header.dataOffset = static_cast<size_t>(p - begin);
+            return true;
+        }
+        // "comment" and "obj_info" lines are ignored.
+    }
+    std::cerr << "[PLY Mode] 'end_header' not found in file." << std::endl;
+    return false;
+}
+
+namespace {
+
+// Find the "vertex" element and the start of its data, skipping the elements before it.
+// Returns nullptr with a message if the element is missing, has no position or cannot be reached.
+const PlyElement *findVertexData(const char *begin, const char *end, const PlyHeader &header, const char *&data,
+                                 bool &swap)
+{
+    auto vertexIt = std::find_if(header.elements.begin(), header.elements.end(),
+                                 [](const PlyElement &element) { return element.name == "vertex"; });
+    if (vertexIt == header.elements.end()) {
+        std::cerr << "[PLY Mode] No 'vertex' element in header." << std::endl;
+        return nullptr;
+    }
+    const PlyElement &vertex = *vertexIt;
+    auto hasProperty = [&](const char *name) {
+        return std::any_of(vertex.properties.begin(), vertex.properties.end(),
+                           [&](const PlyProperty &prop) { return prop.name == name; });
+    };
+    if (!hasProperty("x") || !hasProperty("y") || !hasProperty("z")) {
+        std::cerr << "[PLY Mode] Vertex element has no x/y/z properties." << std::endl;
+        return nullptr;
+    }
+
+    const char *p = begin + header.dataOffset;
+    swap = header.format != PlyFormat::Ascii
+           && (header.format == PlyFormat::BinaryLittleEndian) != hostIsLittleEndian();
+    if (header.format == PlyFormat::Ascii) {
+        // Every record of an ASCII element is one line.
+        for (auto it = header.elements.begin(); it != vertexIt; ++it) {
+            for (size_t i = 0; i < it->count && p < end; ++i)
+                p = nextLine(p, end);
+        }
+        data = p;
+        return &vertex;
+    }
+
+    for (auto it = header.elements.begin(); it != vertexIt; ++it) {
+        if (!hasListProperty(*it)) {
+            size_t stride = 0;
+            for (const PlyProperty &prop : it->properties)
+                stride += plyTypeSize(prop.type);
+            if (static_cast<size_t>(end - p) / std::max<size_t>(stride, 1) < it->count) {
+                std::cerr << "[PLY Mode] Error skipping element: " << it->name << std::endl;
+                return nullptr;
+            }
+            p += stride * it->count;
+            continue;
+        }
+        for (size_t i = 0; i < it->count; ++i) {
+            if (!skipBinaryRecord(p, end, *it, swap)) {
+                std::cerr << "[PLY Mode] Error skipping element: " << it->name << std::endl;
+                return nullptr;
+            }
+        }
+    }
+    data = p;
+    return &vertex;
+}
+
+} // namespace
+
+bool readPlyVertices(const char *begin, const char *end, const PlyHeader &header, std::vector<Point> &points,
+                     glm::dvec3 &origin, LoadProgress *progress)
+{
+    origin = glm::dvec3(0.0);
+    const char *p = nullptr;
+    bool swap = false;
+    const PlyElement *vertex = findVertexData(begin, end, header, p, swap);
+    if (!vertex)
+        return false;
+    if (header.format == PlyFormat::Ascii)
+        return readAsciiVertices(p, end, *vertex, 0, vertex->count, points, origin, progress);
+    return readBinaryVertices(p, end, *vertex, swap, 0, vertex->count, points, origin, progress);
+}
+
+bool readPlyVertexBatches(const char *begin, const char *end, const PlyHeader &header, size_t batchPoints,
+                          const std::function<bool(std::vector<Point>&)> &onBatch, glm::dvec3 &origin,
+                          LoadProgress *progress)
+{
+    origin = glm::dvec3(0.0);
+    const char *p = nullptr;
+    bool swap = false;
+    const PlyElement *vertex = findVertexData(begin, end, header, p, swap);
+    if (!vertex)
+        return false;
+    batchPoints = std::max<size_t>(batchPoints, 1);
+    std::vector<Point> batch;
+    for (size_t first = 0; first < vertex->count; first += batchPoints) {
+        const size_t count = std::min(batchPoints, vertex->count - first);
+        // ASCII records have no fixed size, so 'p' moves on batch by batch.
+        bool read = header.format == PlyFormat::Ascii
+                    ? readAsciiVertices(p, end, *vertex, first, count, batch, origin, progress)
+                    : readBinaryVertices(p, end, *vertex, swap, first, count, batch, origin, progress);
+        if (!read || !onBatch(batch))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+﻿//
+// src/ply_reader.hpp
+//
+
+#ifndef PLY_READER_HPP
+#define PLY_READER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include "load_progress.hpp"
+#include "point.hpp"
+
+enum class PlyFormat {
+    Ascii,
+    BinaryLittleEndian,
+    BinaryBigEndian
+};
+
+enum class PlyType {
+    Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64
+};
+
+struct PlyProperty {
+    std::string name;
+    PlyType type = PlyType::Float32;   // value type, or item type for lists
+    bool isList = false;
+    PlyType countType = PlyType::UInt8; // only used for lists
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+};
+
+struct PlyHeader {
+    PlyFormat format = PlyFormat::Ascii;
+    std::vector<PlyElement> elements;
+    size_t dataOffset = 0; // first byte after "end_header"
+};
+
+// Parse the header of an in-memory PLY file.
+bool parsePlyHeader(const char* begin, const char* end, PlyHeader& header);
+
+// Decode the "vertex" element into points, using the property list of the header.
+// Any property order and type is accepted. x/y/z are required; colors (red/green/blue) default
+// to white and normals (nx/ny/nz) to zero when missing. Integer colors are scaled to [0,1].
+// Elements other than "vertex" (faces, edges, ...) are skipped. Positions are decoded in double
+// precision and stored relative to 'origin', which is chosen from the first vertex.
+// Decoded bytes and points are added to 'progress'; returns false without a message if it gets cancelled.
+bool readPlyVertices(const char* begin, const char* end, const PlyHeader& header, std::vector<Point>& points,
+                     glm::dvec3& origin, LoadProgress* progress = nullptr);
+
+// Decode the "vertex" element like readPlyVertices(), but in batches of at most 'batchPoints' points,
+// which are handed to 'onBatch' in file order; it returns false to stop. Only one batch is held at
+// a time, so the element may be larger than memory. 'origin' is set before the first batch.
+bool readPlyVertexBatches(const char* begin, const char* end, const PlyHeader& header, size_t batchPoints,
+                          const std::function<bool(std::vector<Point>&)>& onBatch, glm::dvec3& origin,
+                          LoadProgress* progress = nullptr);
+
+#endif // PLY_READER_HPP
@@ -0,0 +1,70 @@
+﻿//
+// src/point.cpp
+//
+
+#include "point.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+glm::dvec3 chooseOrigin(const glm::dvec3 &firstPosition)
+{
+    const glm::dvec3 components = glm::abs(firstPosition);
+    const double magnitude = std::max({components.x, components.y, components.z});
+    // NaN and infinite positions, which fail to load anyway, keep the origin at zero as well.
+    if (!(magnitude >= LARGE_COORDINATE) || std::isinf(magnitude))
+        return glm::dvec3(0.0);
+    return glm::round(firstPosition);
+}
+
+Bounds computeBounds(const std::vector<Point> &points)
+{
+    if (points.empty())
+        return {glm::vec3(0.0f), glm::vec3(0.0f)};
+
+    Bounds bounds{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+    std::mutex mutex;
+    ThreadPool::instance().parallelFor(0, points.size(), [&](size_t first, size_t last) {
+        Bounds local = bounds;
+        for (size_t i = first; i < last; ++i) {
+            local.min = glm::min(local.min, points[i].position);
+            local.max = glm::max(local.max, points[i].position);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        bounds.min = glm::min(bounds.min, local.min);
+        bounds.max = glm::max(bounds.max, local.max);
+    }, 1 << 16);
+    return bounds;
+}
+
+Bounds transformBounds(const Bounds &box, const glm::mat4 &transform)
+{
+    Bounds result{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 corner(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+        glm::vec3 transformed = glm::vec3(transform * glm::vec4(corner, 1.0f));
+        result.min = glm::min(result.min, transformed);
+        result.max = glm::max(result.max, transformed);
+    }
+    return result;
+}
+
+BoundingSphere transformSphere(const BoundingSphere &sphere, const glm::mat4 &transform)
+{
+    float scale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                            glm::length(glm::vec3(transform[2]))});
+    return {glm::vec3(transform * glm::vec4(sphere.center, 1.0f)), sphere.radius * scale};
+}
+
+BoundingSphere mergeSpheres(const BoundingSphere &a, const BoundingSphere &b)
+{
+    float distance = glm::length(b.center - a.center);
+    if (distance + b.radius <= a.radius)
+        return a;
+    if (distance + a.radius <= b.radius)
+        return b;
+    float radius = 0.5f * (distance + a.radius + b.radius);
+    return {a.center + (b.center - a.center) * ((radius - a.radius) / distance), radius};
+}
@@ -0,0 +1,53 @@
+﻿//
+// src/point.hpp
+//
+
+#ifndef POINT_HPP
+#define POINT_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Point {
+    glm::vec3 position;
+    glm::vec3 color;
+    glm::vec3 normal;
+    float radius = 0.0f;   // splat radius in world units from the neighbour spacing, 0 if unknown
+};
+
+// Coordinates beyond this magnitude are coarser than a millimetre as floats (the float step is
+// 0.98 mm at 10^4), e.g. survey data in UTM coordinates around 10^6.
+constexpr double LARGE_COORDINATE = 1e4;
+
+// The origin the float positions of a cloud are stored relative to, picked from its first
+// position as read from the file in double precision: zero while that position is small, so
+// ordinary clouds keep their coordinates, and the position rounded to whole units otherwise.
+glm::dvec3 chooseOrigin(const glm::dvec3& firstPosition);
+
+// Axis-aligned bounding box.
+struct Bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    glm::vec3 extent() const { return max - min; }
+};
+
+// Bounds of all point positions, reduced in parallel. Empty input gives a zero box.
+Bounds computeBounds(const std::vector<Point>& points);
+
+// Axis-aligned box around the eight corners of 'box' transformed by 'transform'.
+Bounds transformBounds(const Bounds& box, const glm::mat4& transform);
+
+// Sphere around a set of points, not necessarily the smallest one.
+struct BoundingSphere {
+    glm::vec3 center{0.0f};
+    float radius = 0.0f;
+};
+
+// The sphere transformed by 'transform'. Non-uniform scales grow the radius by the largest one.
+BoundingSphere transformSphere(const BoundingSphere& sphere, const glm::mat4& transform);
+
+// The smallest sphere around both spheres.
+BoundingSphere mergeSpheres(const BoundingSphere& a, const BoundingSphere& b);
+
+#endif // POINT_HPP
@@ -0,0 +1,71 @@
+﻿//
+// src/point_arrays.cpp
+//
+
+#include "point_arrays.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+// Points per block of the parallel loops.
+constexpr size_t BLOCK_POINTS = 1 << 16;
+
+} // namespace
+
+void PointArrays::resize(size_t count)
+{
+    for (std::vector<float> *array : {&x, &y, &z, &r, &g, &b, &nx, &ny, &nz, &radius})
+        array->resize(count);
+}
+
+void PointArrays::clear()
+{
+    for (std::vector<float> *array : {&x, &y, &z, &r, &g, &b, &nx, &ny, &nz, &radius})
+        std::vector<float>().swap(*array);
+}
+
+void PointArrays::releaseAttributes()
+{
+    for (std::vector<float> *array : {&r, &g, &b, &nx, &ny, &nz, &radius})
+        std::vector<float>().swap(*array);
+}
+
+void splitPoints(const std::vector<Point> &points, PointArrays &arrays)
+{
+    arrays.resize(points.size());
+    splitPoints(points.data(), points.size(), arrays, 0);
+}
+
+void splitPoints(const Point *points, size_t count, PointArrays &arrays, size_t first)
+{
+    ThreadPool::instance().parallelFor(0, count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const Point &pt = points[i];
+            const size_t j = first + i;
+            arrays.x[j] = pt.position.x;
+            arrays.y[j] = pt.position.y;
+            arrays.z[j] = pt.position.z;
+            arrays.r[j] = pt.color.r;
+            arrays.g[j] = pt.color.g;
+            arrays.b[j] = pt.color.b;
+            arrays.nx[j] = pt.normal.x;
+            arrays.ny[j] = pt.normal.y;
+            arrays.nz[j] = pt.normal.z;
+            arrays.radius[j] = pt.radius;
+        }
+    }, BLOCK_POINTS);
+}
+
+void interleavePoints(const PointArrays &arrays, size_t first, size_t count, std::vector<Point> &points)
+{
+    points.resize(count);
+    ThreadPool::instance().parallelFor(0, count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const size_t j = first + i;
+            points[i].position = glm::vec3(arrays.x[j], arrays.y[j], arrays.z[j]);
+            points[i].color = glm::vec3(arrays.r[j], arrays.g[j], arrays.b[j]);
+            points[i].normal = glm::vec3(arrays.nx[j], arrays.ny[j], arrays.nz[j]);
+            points[i].radius = arrays.radius[j];
+        }
+    }, BLOCK_POINTS);
+}
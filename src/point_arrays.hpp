@@ -0,0 +1,42 @@
+﻿//
+// src/point_arrays.hpp
+//
+
+#ifndef POINT_ARRAYS_HPP
+#define POINT_ARRAYS_HPP
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "point.hpp"
+
+// CPU-side point cloud as a structure of arrays: one array per component, so passes over one
+// attribute read only that attribute and run as SIMD loops (see simd_kernels.hpp). The loops
+// start at arbitrary tile offsets and use unaligned loads, so the arrays need no alignment.
+// Points are interleaved (Point, CompactPoint) only when they are packed for the GPU.
+struct PointArrays {
+    std::vector<float> x, y, z;
+    std::vector<float> r, g, b;
+    std::vector<float> nx, ny, nz;
+    std::vector<float> radius;
+
+    size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+    void resize(size_t count);
+    void clear();
+    // Free all but the positions, e.g. once the other attributes are on the GPU.
+    void releaseAttributes();
+
+    glm::vec3 position(size_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+    glm::vec3 color(size_t i) const { return glm::vec3(r[i], g[i], b[i]); }
+    glm::vec3 normal(size_t i) const { return glm::vec3(nx[i], ny[i], nz[i]); }
+};
+
+// Split interleaved points into arrays, on the thread pool.
+void splitPoints(const std::vector<Point>& points, PointArrays& arrays);
+// Split 'count' points into [first, first + count) of 'arrays', which must be large enough.
+void splitPoints(const Point* points, size_t count, PointArrays& arrays, size_t first);
+// Interleave the points [first, first + count) of 'arrays' into 'points', on the thread pool.
+void interleavePoints(const PointArrays& arrays, size_t first, size_t count, std::vector<Point>& points);
+
+#endif // POINT_ARRAYS_HPP
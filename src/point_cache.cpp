@@ -0,0 +1,305 @@
+﻿//
+// src/point_cache.cpp
+//
+
+#include "point_cache.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t CHECKSUM_BLOCK_BYTES = 1 << 20;
+constexpr size_t WRITE_BATCH_POINTS = 1 << 16;
+constexpr uint64_t HASH_PRIME_1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t HASH_PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+
+// The attributes a cache stores, each as one tightly packed block of floats, and the member of
+// Point they are read into. Writing, validating and reading all take the element sizes from here.
+struct CacheAttribute {
+    uint32_t location;
+    uint32_t components;
+    size_t member;          // offset in Point
+};
+constexpr CacheAttribute CACHE_ATTRIBUTES[] = {
+    {LOCATION_POSITION, 3, offsetof(Point, position)},
+    {LOCATION_COLOR,    3, offsetof(Point, color)},
+    {LOCATION_NORMAL,   3, offsetof(Point, normal)},
+    {LOCATION_RADIUS,   1, offsetof(Point, radius)},
+};
+
+// The entry of CACHE_ATTRIBUTES for 'location', or null if caches do not store it.
+const CacheAttribute *findCacheAttribute(uint32_t location)
+{
+    for (const CacheAttribute &attribute : CACHE_ATTRIBUTES) {
+        if (attribute.location == location)
+            return &attribute;
+    }
+    return nullptr;
+}
+
+uint64_t rotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t hashBlock(const char *data, size_t size, uint64_t seed)
+{
+    uint64_t h = seed ^ HASH_PRIME_1;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        h = rotateLeft(h ^ (word * HASH_PRIME_2), 31) * HASH_PRIME_1;
+    }
+    for (; i < size; ++i)
+        h = rotateLeft(h ^ (static_cast<unsigned char>(data[i]) * HASH_PRIME_2), 11) * HASH_PRIME_1;
+    h ^= h >> 33;
+    h *= HASH_PRIME_2;
+    h ^= h >> 29;
+    return h;
+}
+
+// Checksum of the header, with both checksums taken as zero, and of the attribute table after it.
+uint64_t layoutChecksum(PointCacheHeader header, const VertexAttribute *attributes)
+{
+    header.checksum = 0;
+    header.layoutChecksum = 0;
+    uint64_t h = hashBlock(reinterpret_cast<const char*>(&header), sizeof(header), 0);
+    return hashBlock(reinterpret_cast<const char*>(attributes), header.attributeCount * sizeof(VertexAttribute), h);
+}
+
+uint64_t alignUp(uint64_t value)
+{
+    return (value + POINT_CACHE_ALIGNMENT - 1) / POINT_CACHE_ALIGNMENT * POINT_CACHE_ALIGNMENT;
+}
+
+bool sourceStamp(const std::string &sourceFile, uint64_t &size, int64_t &modified)
+{
+    std::error_code ec;
+    size = fs::file_size(sourceFile, ec);
+    if (ec)
+        return false;
+    auto time = fs::last_write_time(sourceFile, ec);
+    if (ec)
+        return false;
+    modified = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+void writePadding(std::ofstream &out, uint64_t to)
+{
+    static const char zeros[POINT_CACHE_ALIGNMENT] = {};
+    uint64_t at = static_cast<uint64_t>(out.tellp());
+    if (to > at)
+        out.write(zeros, static_cast<std::streamsize>(to - at));
+}
+
+} // namespace
+
+uint64_t pointCacheChecksum(const char *data, size_t size)
+{
+    size_t numBlocks = (size + CHECKSUM_BLOCK_BYTES - 1) / CHECKSUM_BLOCK_BYTES;
+    std::vector<uint64_t> blockHashes(numBlocks);
+    ThreadPool::instance().parallelFor(0, numBlocks, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            size_t offset = i * CHECKSUM_BLOCK_BYTES;
+            blockHashes[i] = hashBlock(data + offset, std::min(CHECKSUM_BLOCK_BYTES, size - offset), i);
+        }
+    });
+    return hashBlock(reinterpret_cast<const char*>(blockHashes.data()), blockHashes.size() * sizeof(uint64_t), size);
+}
+
+std::string pointCachePath(const std::string &sourceFile)
+{
+    return sourceFile + POINT_CACHE_EXTENSION;
+}
+
+bool openPointCache(const std::string &cacheFile, const std::string &sourceFile, PointCache &cache, bool verifyData)
+{
+    if (!cache.file.open(cacheFile))
+        return false;
+
+    const char *begin = cache.file.data();
+    size_t size = cache.file.size();
+    if (size < sizeof(PointCacheHeader)) {
+        std::cerr << "[Cache] File too small: " << cacheFile << std::endl;
+        return false;
+    }
+    PointCacheHeader &header = cache.header;
+    std::memcpy(&header, begin, sizeof(header));
+    if (std::memcmp(header.magic, POINT_CACHE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != POINT_CACHE_VERSION || header.byteOrder != POINT_CACHE_BYTE_ORDER) {
+        std::cerr << "[Cache] Not a compatible point cache: " << cacheFile << std::endl;
+        return false;
+    }
+    uint64_t tableEnd = sizeof(header) + uint64_t(header.attributeCount) * sizeof(VertexAttribute);
+    if (tableEnd > header.dataOffset || header.dataOffset > size || header.dataSize > size - header.dataOffset) {
+        std::cerr << "[Cache] Truncated point cache: " << cacheFile << std::endl;
+        return false;
+    }
+
+    if (!sourceFile.empty()) {
+        uint64_t sourceSize = 0;
+        int64_t sourceModified = 0;
+        if (!sourceStamp(sourceFile, sourceSize, sourceModified)
+            || sourceSize != header.sourceSize || sourceModified != header.sourceModified) {
+            std::cout << "[Cache] Source changed, ignoring cache: " << cacheFile << std::endl;
+            return false;
+        }
+    }
+
+    cache.attributes.resize(header.attributeCount);
+    std::memcpy(cache.attributes.data(), begin + sizeof(header), header.attributeCount * sizeof(VertexAttribute));
+    if (layoutChecksum(header, cache.attributes.data()) != header.layoutChecksum) {
+        std::cerr << "[Cache] Header checksum mismatch: " << cacheFile << std::endl;
+        return false;
+    }
+    for (const VertexAttribute &attribute : cache.attributes) {
+        // Each element is copied into the Point member of its location, so it must have that size.
+        const CacheAttribute *known = findCacheAttribute(attribute.location);
+        if (!known || attribute.components != known->components || attribute.type != GL_FLOAT) {
+            std::cerr << "[Cache] Unsupported attribute " << attribute.location << ": " << cacheFile << std::endl;
+            return false;
+        }
+        // offset + (pointCount - 1) * stride + elementSize <= dataSize, without overflowing.
+        const uint64_t elementSize = uint64_t(known->components) * sizeof(float);
+        if (attribute.stride < elementSize) {
+            std::cerr << "[Cache] Invalid attribute stride " << attribute.stride << ": " << cacheFile << std::endl;
+            return false;
+        }
+        if (header.pointCount > 0
+            && (attribute.offset > header.dataSize || elementSize > header.dataSize - attribute.offset
+                || header.pointCount - 1 > (header.dataSize - attribute.offset - elementSize) / attribute.stride)) {
+            std::cerr << "[Cache] Attribute block out of range: " << cacheFile << std::endl;
+            return false;
+        }
+    }
+
+    // Reading every byte again on each load is slow for large clouds, so it is only done on request.
+    if (verifyData && pointCacheChecksum(cache.data(), header.dataSize) != header.checksum) {
+        std::cerr << "[Cache] Checksum mismatch: " << cacheFile << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void readPointCache(const PointCache &cache, std::vector<Point> &points)
+{
+    // openPointCache() only accepts the attributes of CACHE_ATTRIBUTES, with their sizes.
+    points.resize(cache.header.pointCount);
+    for (const VertexAttribute &attribute : cache.attributes) {
+        const CacheAttribute *known = findCacheAttribute(attribute.location);
+        const char *src = cache.data() + attribute.offset;
+        char *dst = reinterpret_cast<char*>(points.data()) + known->member;
+        const size_t elementSize = known->components * sizeof(float);
+        ThreadPool::instance().parallelFor(0, points.size(), [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i)
+                std::memcpy(dst + i * sizeof(Point), src + i * attribute.stride, elementSize);
+        }, WRITE_BATCH_POINTS);
+    }
+}
+
+bool writePointCache(const std::string &cacheFile, const std::string &sourceFile, const std::vector<Point> &points,
+                     const glm::dvec3 &origin)
+{
+    PointCacheHeader header{};
+    std::memcpy(header.magic, POINT_CACHE_MAGIC, sizeof(header.magic));
+    header.version = POINT_CACHE_VERSION;
+    header.byteOrder = POINT_CACHE_BYTE_ORDER;
+    header.pointCount = points.size();
+    if (!sourceStamp(sourceFile, header.sourceSize, header.sourceModified)) {
+        std::cerr << "[Cache] Failed to stat source file: " << sourceFile << std::endl;
+        return false;
+    }
+
+    Bounds bounds = computeBounds(points);
+    for (int i = 0; i < 3; ++i) {
+        header.boundsMin[i] = bounds.min[i];
+        header.boundsMax[i] = bounds.max[i];
+        header.origin[i] = origin[i];
+    }
+
+    // One tightly packed block per attribute.
+    std::vector<VertexAttribute> attributes;
+    uint64_t blockOffset = 0;
+    for (const CacheAttribute &attribute : CACHE_ATTRIBUTES) {
+        const uint64_t elementSize = attribute.components * sizeof(float);
+        attributes.push_back({attribute.location, attribute.components, GL_FLOAT, GL_FALSE, blockOffset, elementSize});
+        blockOffset = alignUp(blockOffset + points.size() * elementSize);
+    }
+    header.attributeCount = static_cast<uint32_t>(attributes.size());
+    header.dataOffset = alignUp(sizeof(header) + attributes.size() * sizeof(VertexAttribute));
+    header.dataSize = blockOffset;
+
+    const std::string tempFile = cacheFile + ".tmp";
+    {
+        std::ofstream out(tempFile, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "[Cache] Failed to create cache file: " << tempFile << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(attributes.data()), attributes.size() * sizeof(VertexAttribute));
+
+        std::vector<char> batch;
+        for (size_t a = 0; a < attributes.size(); ++a) {
+            writePadding(out, header.dataOffset + attributes[a].offset);
+            const size_t elementSize = attributes[a].stride;
+            const size_t member = CACHE_ATTRIBUTES[a].member;
+            for (size_t first = 0; first < points.size(); first += WRITE_BATCH_POINTS) {
+                size_t last = std::min(points.size(), first + WRITE_BATCH_POINTS);
+                batch.resize((last - first) * elementSize);
+                for (size_t i = first; i < last; ++i) {
+                    std::memcpy(batch.data() + (i - first) * elementSize,
+                                reinterpret_cast<const char*>(&points[i]) + member, elementSize);
+                }
+                out.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+            }
+        }
+        writePadding(out, header.dataOffset + header.dataSize);
+        if (!out) {
+            std::cerr << "[Cache] Failed to write cache file: " << tempFile << std::endl;
+            out.close();
+            fs::remove(tempFile);
+            return false;
+        }
+    }
+
+    // The checksum runs over the written bytes and is patched into the header afterwards.
+    {
+        MappedFile written;
+        if (!written.open(tempFile)) {
+            fs::remove(tempFile);
+            return false;
+        }
+        header.checksum = pointCacheChecksum(written.data() + header.dataOffset, header.dataSize);
+    }
+    header.layoutChecksum = layoutChecksum(header, attributes.data());
+    {
+        std::fstream patch(tempFile, std::ios::binary | std::ios::in | std::ios::out);
+        patch.seekp(0);
+        patch.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!patch) {
+            std::cerr << "[Cache] Failed to finalize cache file: " << tempFile << std::endl;
+            patch.close();
+            fs::remove(tempFile);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tempFile, cacheFile, ec);
+    if (ec) {
+        std::cerr << "[Cache] Failed to move cache into place: " << cacheFile << " (" << ec.message() << ")" << std::endl;
+        fs::remove(tempFile, ec);
+        return false;
+    }
+    std::cout << "[Cache] Wrote " << points.size() << " points to " << cacheFile << std::endl;
+    return true;
+}
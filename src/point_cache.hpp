@@ -0,0 +1,81 @@
+﻿//
+// src/point_cache.hpp
+//
+
+#ifndef POINT_CACHE_HPP
+#define POINT_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "mapped_file.hpp"
+#include "point.hpp"
+#include "vertex_layout.hpp"
+
+// Native binary point cloud container (".pcc").
+//
+// Layout: PointCacheHeader, 'attributeCount' VertexAttribute records, then one block per
+// attribute (positions, colors, normals as tightly packed float triplets, radii as floats),
+// each aligned to POINT_CACHE_ALIGNMENT. Attribute offsets are relative to 'dataOffset', so the whole range
+// [dataOffset, dataOffset + dataSize) can be handed to glBufferData as one vertex buffer.
+// Positions and bounds are relative to 'origin', which is kept in double precision.
+constexpr char POINT_CACHE_MAGIC[8] = {'P', 'C', 'C', 'A', 'C', 'H', 'E', '\0'};
+// 2: per-point radius block, 3: points shuffled within chunks, 4: double-precision origin,
+// 5: checksum of the header and attribute table
+constexpr uint32_t POINT_CACHE_VERSION = 5;
+constexpr uint32_t POINT_CACHE_BYTE_ORDER = 0x01020304;
+constexpr uint64_t POINT_CACHE_ALIGNMENT = 64;
+constexpr const char* POINT_CACHE_EXTENSION = ".pcc";
+
+struct PointCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;       // POINT_CACHE_BYTE_ORDER as written by the creating machine
+    uint64_t pointCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t attributeCount;
+    uint32_t reserved;
+    uint64_t sourceSize;      // size of the .pts/.ply file the cache was built from
+    int64_t sourceModified;   // last write time of that file (filesystem clock ticks)
+    uint64_t dataOffset;      // start of the attribute blocks
+    uint64_t dataSize;
+    uint64_t checksum;        // pointCacheChecksum() of the attribute blocks
+    double origin[3];         // added to the positions to get the coordinates of the source file
+    uint64_t layoutChecksum;  // of this header (both checksums zero) and the attribute table
+};
+static_assert(sizeof(PointCacheHeader) == 128, "PointCacheHeader layout must not change");
+
+// A validated, memory-mapped cache file.
+struct PointCache {
+    MappedFile file;
+    PointCacheHeader header{};
+    std::vector<VertexAttribute> attributes;
+
+    const char* data() const { return file.data() + header.dataOffset; }
+    glm::dvec3 origin() const { return glm::dvec3(header.origin[0], header.origin[1], header.origin[2]); }
+};
+
+// Path of the cache file belonging to a source file ("scan.pts" -> "scan.pts.pcc").
+std::string pointCachePath(const std::string& sourceFile);
+
+// Map and validate a cache file. If 'sourceFile' is not empty, the cache is only accepted
+// while that file still has the size and modification time recorded in the header.
+// The header and attribute table are always checked; the checksum of the attribute blocks
+// only with 'verifyData'.
+bool openPointCache(const std::string& cacheFile, const std::string& sourceFile, PointCache& cache,
+                    bool verifyData = false);
+
+// Copy the attribute blocks of a cache opened by openPointCache() back into interleaved points.
+void readPointCache(const PointCache& cache, std::vector<Point>& points);
+
+// Write 'points' as a cache file for 'sourceFile'. The file is written under a temporary name
+// and renamed once complete, so a crash never leaves a truncated cache behind.
+bool writePointCache(const std::string& cacheFile, const std::string& sourceFile, const std::vector<Point>& points,
+                     const glm::dvec3& origin);
+
+// 64-bit checksum of a memory range, computed in parallel.
+uint64_t pointCacheChecksum(const char* data, size_t size);
+
+#endif // POINT_CACHE_HPP
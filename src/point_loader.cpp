@@ -0,0 +1,395 @@
+﻿//
+// src/point_loader.cpp
+//
+
+#include "point_loader.hpp"
+#include "chunk_grid.hpp"
+#include "downsample.hpp"
+#include "kd_tree.hpp"
+#include "mapped_file.hpp"
+#include "neighborhood.hpp"
+#include "ply_reader.hpp"
+#include "pts_parser.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Points read between two progress reports of the stream parser.
+constexpr int PROGRESS_POINTS = 1 << 16;
+
+// Read the point count of a .pts stream from its first line that is not a comment ("//").
+bool readPtsCount(std::istream &file, uint64_t &numPoints)
+{
+    numPoints = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.size() >= 2 && line[0]=='/' && line[1]=='/')
+            continue;
+        std::istringstream iss(line);
+        long long count = 0;
+        if (!(iss >> count) || count < 0) {
+            std::cerr << "Failed to parse number of points from line: " << line << std::endl;
+            return false;
+        }
+        numPoints = static_cast<uint64_t>(count);
+        break;
+    }
+    return true;
+}
+
+// Read point 'index' of a .pts stream. Blank lines are skipped; every other line holds one record
+// of as many values as the first one, whose count is kept in 'recordSize'. 'origin' is chosen
+// from point 0. Colors are returned as in the file.
+bool readPtsPoint(std::istream &file, std::string &line, uint64_t index, size_t &recordSize, glm::dvec3 &origin,
+                  Point &pt)
+{
+    // One value more than a record holds, to notice lines with too many.
+    double position[3];
+    float attributes[MAX_PTS_VALUES - 2];
+    size_t count = 0;
+    bool read = false, malformed = false;
+    while (!read && std::getline(file, line)) {
+        std::istringstream iss(line);
+        while (count <= MAX_PTS_VALUES && (count < 3 ? iss >> position[count] : iss >> attributes[count - 3]))
+            ++count;
+        // Anything but numbers (or too many of them) stops before the end of the line.
+        malformed = !iss.eof();
+        read = count > 0 || malformed;
+    }
+    if (!read || malformed || !isPtsRecordSize(count) || (recordSize != 0 && count != recordSize)) {
+        std::cerr << "Failed to read point " << index << std::endl;
+        return false;
+    }
+    recordSize = count;
+    if (index == 0)
+        origin = chooseOrigin(glm::dvec3(position[0], position[1], position[2]));
+    pt = ptsRecordToPoint(position, attributes, count, origin);
+    float length = glm::length(pt.normal);
+    if (length > 0.0f)
+        pt.normal /= length;
+    return true;
+}
+
+bool readPts(const std::string &filename, std::vector<Point> &points, glm::dvec3 &origin, LoadProgress *progress)
+{
+    std::ifstream file(filename);
+    if (!file.is_open()){
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return false;
+    }
+
+    uint64_t numPoints = 0;
+    if (!readPtsCount(file, numPoints))
+        return false;
+    // Every record takes at least six bytes ("x y z" and a newline), so a larger count in the
+    // header is not reserved for.
+    points.reserve(std::min<uint64_t>(numPoints, fs::file_size(filename) / 6));
+
+    float maxColor = 0.0f;
+    size_t recordSize = 0;
+    std::string line;
+    std::streamoff reported = 0;
+    for (uint64_t i = 0; i < numPoints; ++i) {
+        if (progress && i % PROGRESS_POINTS == 0 && i > 0) {
+            std::streamoff position = file.tellg();
+            if (!reportProgress(progress, position - reported, PROGRESS_POINTS))
+                return false;
+            reported = position;
+        }
+        Point pt;
+        if (!readPtsPoint(file, line, i, recordSize, origin, pt))
+            return false;
+        if (recordSize >= 6)
+            maxColor = std::max({maxColor, pt.color.r, pt.color.g, pt.color.b});
+        points.push_back(pt);
+    }
+    if (progress) {
+        uint64_t lastBlock = numPoints == 0 ? 0 : (numPoints - 1) % PROGRESS_POINTS + 1;
+        uint64_t size = fs::file_size(filename);
+        reportProgress(progress, size > uint64_t(reported) ? size - uint64_t(reported) : 0, lastBlock);
+    }
+    // Colors given in 0-255 are scaled to [0,1], same as in the parallel loader.
+    if (maxColor > 1.0f) {
+        for (Point &pt : points)
+            pt.color /= 255.0f;
+    }
+    std::cout << "Loaded " << points.size() << " points from PTS file." << std::endl;
+    return true;
+}
+
+// Like readPts(), but hands the points to 'onBatch' and keeps only one batch in memory.
+bool readPtsBatches(const std::string &filename, size_t batchPoints, const PointBatchFunction &onBatch,
+                    glm::dvec3 &origin, float &colorScale, LoadProgress *progress)
+{
+    std::ifstream file(filename);
+    if (!file.is_open()){
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return false;
+    }
+
+    uint64_t numPoints = 0;
+    if (!readPtsCount(file, numPoints))
+        return false;
+    const uint64_t fileBytes = fs::file_size(filename);
+    std::vector<Point> batch;
+    batch.reserve(std::min<uint64_t>(numPoints, batchPoints));
+    float maxColor = 0.0f;
+    size_t recordSize = 0;
+    std::string line;
+    uint64_t reported = 0;
+    for (uint64_t i = 0; i < numPoints; ++i) {
+        Point pt;
+        if (!readPtsPoint(file, line, i, recordSize, origin, pt))
+            return false;
+        if (recordSize >= 6)
+            maxColor = std::max({maxColor, pt.color.r, pt.color.g, pt.color.b});
+        batch.push_back(pt);
+        if (batch.size() < batchPoints && i + 1 < numPoints)
+            continue;
+        // tellg() fails once the last line has been read up to the end of the file.
+        const std::streamoff position = file.tellg();
+        const uint64_t read = i + 1 < numPoints && position >= 0 ? uint64_t(position) : fileBytes;
+        if (!reportProgress(progress, read - std::min(read, reported), batch.size()) || !onBatch(batch))
+            return false;
+        reported = read;
+        batch.clear();
+    }
+    colorScale = maxColor > 1.0f ? 1.0f / 255.0f : 1.0f;
+    std::cout << "Read " << numPoints << " points from PTS file in batches." << std::endl;
+    return true;
+}
+
+bool readPtsParallel(const std::string &filename, std::vector<Point> &points, glm::dvec3 &origin,
+                     LoadProgress *progress)
+{
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "[Parallel Mode] Failed to open file: " << filename << std::endl;
+        return false;
+    }
+
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+    int numPoints = 0;
+    const char *body = nullptr;
+    if (!parsePtsHeader(begin, end, numPoints, body))
+        return false;
+    reportProgress(progress, body - begin, 0);
+    if (!parsePtsPoints(body, end, numPoints, points, origin, progress))
+        return false;
+
+    std::cout << "Loaded " << points.size() << " points from PTS file." << std::endl;
+    return true;
+}
+
+bool readPly(const std::string &filename, std::vector<Point> &points, glm::dvec3 &origin, LoadProgress *progress)
+{
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "[PLY Mode] Failed to open file: " << filename << std::endl;
+        return false;
+    }
+
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+    PlyHeader header;
+    if (!parsePlyHeader(begin, end, header))
+        return false;
+
+    reportProgress(progress, header.dataOffset, 0);
+    if (!readPlyVertices(begin, end, header, points, origin, progress))
+        return false;
+
+    std::cout << "[PLY Mode] Loaded " << points.size() << " points." << std::endl;
+    return true;
+}
+
+bool readPlyBatches(const std::string &filename, size_t batchPoints, const PointBatchFunction &onBatch,
+                    glm::dvec3 &origin, LoadProgress *progress)
+{
+    MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "[PLY Mode] Failed to open file: " << filename << std::endl;
+        return false;
+    }
+
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+    PlyHeader header;
+    if (!parsePlyHeader(begin, end, header))
+        return false;
+
+    reportProgress(progress, header.dataOffset, 0);
+    return readPlyVertexBatches(begin, end, header, batchPoints, onBatch, origin, progress);
+}
+
+// Whether the load reporting to 'progress' was cancelled. Checked between the processing
+// stages, which do not report progress themselves, so a cancel never waits for all of them.
+bool cancelled(const LoadProgress *progress)
+{
+    return progress && progress->cancelled();
+}
+
+// Apply the voxel size and point budget of 'options'. The reduced points are sorted into chunks
+// again and get new radii, as they are further apart than the ones they replace.
+// Returns true if the points were reduced.
+bool reducePoints(std::vector<Point> &points, const LoadOptions &options, const LoadProgress *progress)
+{
+    if (points.empty() || (options.voxelSize <= 0.0f && (options.pointBudget == 0 || points.size() <= options.pointBudget)))
+        return false;
+
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    const size_t before = points.size();
+    float voxelSize = std::max(options.voxelSize, voxelSizeForBudget(points, options.pointBudget));
+    voxelSize = downsampleVoxelGrid(points, voxelSize);
+    if (voxelSize == 0.0f)
+        return false;
+    if (cancelled(progress))
+        return true;
+    ChunkGrid chunks;
+    buildChunkGrid(points, chunks);
+    shuffleChunks(points, chunks);
+    if (cancelled(progress))
+        return true;
+    KdTree tree;
+    if (tree.build(points))
+        estimatePointRadii(points, tree);
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << "[Downsample] Reduced " << before << " to " << points.size() << " points ("
+              << 100.0 * points.size() / before << "%) with voxel size " << voxelSize << " in " << ms << " ms"
+              << std::endl;
+    return true;
+}
+
+} // namespace
+
+bool readPointFile(const std::string &filename, bool parallel, std::vector<Point> &points, glm::dvec3 &origin,
+                   LoadProgress *progress)
+{
+    std::string ext = fs::path(filename).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    points.clear();
+    origin = glm::dvec3(0.0);
+
+    if (ext == ".pts")
+        return parallel ? readPtsParallel(filename, points, origin, progress) : readPts(filename, points, origin, progress);
+    if (ext == ".ply")
+        return readPly(filename, points, origin, progress);
+    std::cerr << "Unsupported file extension: " << ext << std::endl;
+    return false;
+}
+
+bool readPointFileBatches(const std::string &filename, size_t batchPoints, const PointBatchFunction &onBatch,
+                          glm::dvec3 &origin, float &colorScale, LoadProgress *progress)
+{
+    std::string ext = fs::path(filename).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    origin = glm::dvec3(0.0);
+    colorScale = 1.0f;
+    batchPoints = std::max<size_t>(batchPoints, 1);
+
+    if (ext == ".pts")
+        return readPtsBatches(filename, batchPoints, onBatch, origin, colorScale, progress);
+    if (ext == ".ply")
+        return readPlyBatches(filename, batchPoints, onBatch, origin, progress);
+    std::cerr << "Unsupported file extension: " << ext << std::endl;
+    return false;
+}
+
+bool loadPoints(const std::string &filename, const LoadOptions &options, std::vector<Point> &points, glm::dvec3 &origin,
+                PointCache *cache, LoadProgress *progress)
+{
+    fs::path filePath(filename);
+    if (!fs::exists(filePath)) {
+        std::cerr << "File does not exist: " << filename << std::endl;
+        return false;
+    }
+
+    std::string ext = filePath.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    points.clear();
+    origin = glm::dvec3(0.0);
+    // Added rather than set, so the tiles of a scene can report into one progress.
+    const uint64_t fileBytes = fs::file_size(filePath);
+    if (progress)
+        progress->bytesTotal += fileBytes;
+
+    PointCache localCache;
+    PointCache &mapped = cache ? *cache : localCache;
+    if (ext == POINT_CACHE_EXTENSION) {
+        if (!openPointCache(filename, "", mapped, options.verifyCache))
+            return false;
+        readPointCache(mapped, points);
+        origin = mapped.origin();
+        reportProgress(progress, mapped.file.size(), points.size());
+        std::cout << "[Cache] Loaded " << points.size() << " points from " << filename << std::endl;
+        // Reduced points no longer match the mapping, they are uploaded from 'points' instead.
+        if (reducePoints(points, options, progress))
+            mapped.file.close();
+        return !cancelled(progress);
+    }
+
+    // Reuse the cache written by an earlier run while the source file is unchanged.
+    const std::string cacheFile = pointCachePath(filename);
+    if ((ext == ".pts" || ext == ".ply") && options.useCache && fs::exists(cacheFile)) {
+        if (openPointCache(cacheFile, filename, mapped, options.verifyCache)) {
+            readPointCache(mapped, points);
+            origin = mapped.origin();
+            // The cache replaces the source file in the total, and may be smaller or larger.
+            if (progress && mapped.file.size() >= fileBytes)
+                progress->bytesTotal += mapped.file.size() - fileBytes;
+            else if (progress)
+                progress->bytesTotal -= fileBytes - mapped.file.size();
+            reportProgress(progress, mapped.file.size(), points.size());
+            std::cout << "[Cache] Loaded " << points.size() << " points from " << cacheFile << std::endl;
+            if (reducePoints(points, options, progress))
+                mapped.file.close();
+            return !cancelled(progress);
+        }
+        mapped.file.close();
+    }
+
+    if (!readPointFile(filename, options.parallel, points, origin, progress))
+        return false;
+    // Store the points in chunk order, so PointRenderer can upload the cache as is, and in random
+    // order within each chunk for progressive rendering.
+    ChunkGrid chunks;
+    buildChunkGrid(points, chunks);
+    shuffleChunks(points, chunks);
+    if (cancelled(progress))
+        return false;
+
+    // Splat radii from the neighbour spacing, and normals for files without them. Both are
+    // stored in the cache with the points, so this runs once per file.
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    KdTree tree;
+    if (!tree.build(points))
+        return false;
+    estimatePointRadii(points, tree);
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << "[Radius] Estimated radii of " << points.size() << " points in " << ms << " ms" << std::endl;
+    if (cancelled(progress))
+        return false;
+    if (!hasNormals(points)) {
+        start = Clock::now();
+        estimateNormals(points, tree);
+        ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::cout << "[Normals] Estimated normals of " << points.size() << " points in " << ms << " ms" << std::endl;
+    }
+    // A cancelled load writes no cache, so the next one does not pick up half-processed points.
+    if (cancelled(progress))
+        return false;
+    if (options.useCache)
+        writePointCache(cacheFile, filename, points, origin);
+    reducePoints(points, options, progress);
+    return !cancelled(progress);
+}
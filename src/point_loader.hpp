@@ -0,0 +1,56 @@
+﻿//
+// src/point_loader.hpp
+//
+
+#ifndef POINT_LOADER_HPP
+#define POINT_LOADER_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "compact_vertex.hpp"
+#include "load_progress.hpp"
+#include "point.hpp"
+#include "point_cache.hpp"
+
+// Options that control how point cloud files are loaded.
+struct LoadOptions {
+    bool parallel = false;  // use the multithreaded .pts loader
+    bool useCache = true;   // read/write the binary .pcc cache next to .pts/.ply files
+    bool verifyCache = false; // check the checksum of the whole cache on every load, not only its layout
+    VertexFormat vertexFormat = VertexFormat::Full; // layout of the GPU vertex buffer
+    float voxelSize = 0.0f; // average the points of every cell of this size into one, 0 keeps all points
+    size_t pointBudget = 0; // grow the voxel size until at most this many points remain, 0 for no limit
+    bool compareFormats = false; // upload each loaded cloud in both vertex formats and print their cost
+};
+
+// Parse a .pts or .ply file, without touching any cache. The positions are parsed in double
+// precision and stored relative to 'origin' (see chooseOrigin() in point.hpp).
+bool readPointFile(const std::string& filename, bool parallel, std::vector<Point>& points, glm::dvec3& origin,
+                   LoadProgress* progress = nullptr);
+
+// Receives the points read by readPointFileBatches(); returns false to stop reading.
+using PointBatchFunction = std::function<bool(std::vector<Point>& batch)>;
+
+// Parse a .pts or .ply file like readPointFile(), but hand the points to 'onBatch' in file order,
+// at most 'batchPoints' at a time, so the file may be larger than memory (see buildLodOctree()).
+// 'origin' is set before the first batch. Colors given in 0-255 in a .pts file are only recognized
+// at its end, so they are passed on as read and 'colorScale' is then set to 1/255; it is 1 otherwise.
+bool readPointFileBatches(const std::string& filename, size_t batchPoints, const PointBatchFunction& onBatch,
+                          glm::dvec3& origin, float& colorScale, LoadProgress* progress = nullptr);
+
+// Load a .pts, .ply or .pcc file. For .pts/.ply files the cache next to the file is used while
+// it is valid, and written after parsing otherwise (if options.useCache is set).
+// Freshly parsed points are returned sorted into chunks and shuffled within each chunk
+// (see chunk_grid.hpp), with their radius estimated from the neighbour spacing and normals
+// estimated if the file has none, and cached in that order.
+// A voxel size or point budget in 'options' reduces the points after loading (see downsample.hpp);
+// the cache always holds the full cloud, so the reduction can be changed without parsing again.
+// When the points came from a cache file unreduced and 'cache' is given, the mapping is left open
+// in it so the caller can upload the attribute blocks directly.
+// The positions are relative to 'origin', which is stored in the cache along with them.
+// Progress is reported to 'progress' if given. A cancelled load returns false without a message.
+bool loadPoints(const std::string& filename, const LoadOptions& options, std::vector<Point>& points,
+                glm::dvec3& origin, PointCache* cache = nullptr, LoadProgress* progress = nullptr);
+
+#endif // POINT_LOADER_HPP
@@ -3,395 +3,801 @@
 //
 
 #include "point_renderer.hpp"
-#include <fstream>
-#include <sstream>
+#include "frame_uniforms.hpp"
+#include "frustum.hpp"
+#include "lod_format.hpp"
+#include "point_cache.hpp"
+#include "scene_file.hpp"
+#include "simd_kernels.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
 #include <iostream>
+#include <limits>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <vector>
-#include <filesystem>  // C++17 filesystem header
-#ifdef HAVE_OPENCL
-  #include <CL/cl.h>
-#endif
 
-namespace fs = std::filesystem;
+static_assert(sizeof(int32_t) == sizeof(GLint) && sizeof(int32_t) == sizeof(GLsizei),
+              "chunk ranges are passed to glMultiDrawArrays as is");
 
-PointRenderer::PointRenderer(const std::string &file, bool parallel)
-    : VAO(0), VBO(0), filename(file), parallelLoading(parallel)
+namespace {
+
+// Points interleaved at a time when the Full format is uploaded from the arrays (5 MiB).
+constexpr size_t INTERLEAVE_POINTS = size_t(1) << 17;
+
+// Scale of a transform that rotates, translates and scales uniformly.
+float uniformScale(const glm::mat4 &transform)
+{
+    return std::cbrt(std::abs(glm::determinant(glm::mat3(transform))));
+}
+
+// Whether 'transform' only scales and translates, so it maps axis-aligned boxes onto such boxes.
+bool keepsAxes(const glm::mat4 &transform)
+{
+    return transform[0][1] == 0.0f && transform[0][2] == 0.0f && transform[1][0] == 0.0f
+           && transform[1][2] == 0.0f && transform[2][0] == 0.0f && transform[2][1] == 0.0f;
+}
+
+// 'transform' of a tile whose positions are relative to 'tileOrigin', changed to place them
+// relative to 'sceneOrigin'. Computed in double, as both origins may be far from zero.
+glm::mat4 rebaseTransform(const glm::mat4 &transform, const glm::dvec3 &tileOrigin, const glm::dvec3 &sceneOrigin)
+{
+    glm::dmat4 rebased(transform);
+    rebased[3] = glm::dvec4(glm::dvec3(rebased * glm::dvec4(tileOrigin, 1.0)) - sceneOrigin, 1.0);
+    return glm::mat4(rebased);
+}
+
+} // namespace
+
+PointRenderer::PointRenderer(const std::string &file, const LoadOptions &loadOptions)
+    : VAO(0), VBO(0), filename(file), options(loadOptions)
 {
     if (!loadPointCloud())
         std::cerr << "Failed to load point cloud from file: " << file << std::endl;
 }
 
 PointRenderer::~PointRenderer() {
+    // The loads stop at their next progress report or processing stage.
+    cancelLoad();
+    if (asyncLoad.valid())
+        asyncLoad.wait();
+    cancelledLoads.clear();
     if (VBO) glDeleteBuffers(1, &VBO);
     if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (tileTexture) glDeleteTextures(1, &tileTexture);
+    if (tileBuffer) glDeleteBuffers(1, &tileBuffer);
+    if (tileIndexVBO) glDeleteBuffers(1, &tileIndexVBO);
+    if (indirectBuffer) glDeleteBuffers(1, &indirectBuffer);
 }
 
 
-void PointRenderer::render() const {
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(points.size()));
-    glBindVertexArray(0);
-}
-
-void PointRenderer::setupBuffers() {
-    if (VAO) glDeleteVertexArrays(1, &VAO);
-    if (VBO) glDeleteBuffers(1, &VBO);
-
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+void PointRenderer::render(const Shader &shader, const glm::mat4 &projection, const glm::mat4 &view,
+                           float sliceBegin, float sliceEnd) {
+    if (lod) {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        // Nodes are selected in world coordinates, where float precision is plenty for that.
+        lod->update(projection, view * glm::translate(glm::mat4(1.0f), -glm::vec3(cameraOrigin)), viewport[3]);
+        lod->render(shader, cameraOrigin);
+        return;
+    }
+    if (stream) {
+        stream->render(shader, cameraOrigin);
+        return;
+    }
 
-    glBindVertexArray(VAO);
+    if (tileUniformsDirty)
+        uploadTileUniforms();
+    chunkStats = ChunkStats();
+    chunkStats.chunksTotal = chunks.size();
+    gpuCulled = frustumCulling && gpuCulling && indirectDraw && isGpuCullingAvailable() && !tiles.empty();
+    if (gpuCulled) {
+        // One command per chunk from the compute shader, empty ones for the culled chunks.
+        tileFrustums.clear();
+        for (const Tile &tile : tiles)
+            tileFrustums.push_back(extractFrustum(projection * view * renderTransform(tile)));
+        gpuCuller->cull(tileFrustums, sliceBegin, sliceEnd);
+        shader.use();
+        chunkStats.chunksDrawn = gpuCuller->getStats().chunksDrawn;
+        chunkStats.pointsDrawn = gpuCuller->getStats().pointsDrawn;
+        chunkStats.drawRanges = gpuCuller->getCommandCount();
+        chunkStats.drawCalls = 1;
+        draw(shader);
+        return;
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(Point), points.data(), GL_STATIC_DRAW);
+    drawFirst.clear();
+    drawCount.clear();
+    drawTileEnd.clear();
+    chunkVisible.resize(chunks.size());
+    const bool sliced = sliceBegin > 0.0f || sliceEnd < 1.0f;
+    for (const Tile &tile : tiles) {
+        if ((!frustumCulling && !sliced) || tile.chunkCount == 0) {
+            if (tile.count > 0) {
+                drawFirst.push_back(static_cast<int32_t>(tile.first));
+                drawCount.push_back(static_cast<int32_t>(tile.count));
+            }
+            chunkStats.chunksDrawn += tile.chunkCount;
+            chunkStats.pointsDrawn += tile.count;
+            drawTileEnd.push_back(drawFirst.size());
+            continue;
+        }
 
-    // Position attribute (location 0)
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Point), (void*)offsetof(Point, position));
+        // Draw the visible chunks, merging chunks that are next to each other in the buffer.
+        // The chunk bounds are in tile coordinates, so the frustum is taken there as well.
+        const size_t end = tile.firstChunk + tile.chunkCount;
+        const size_t tileRanges = drawFirst.size();
+        if (frustumCulling) {
+            chunkStats.chunksDrawn += cullChunks(chunks, extractFrustum(projection * view * renderTransform(tile)),
+                                                 chunkVisible, tile.firstChunk, end);
+        } else {
+            std::fill(chunkVisible.begin() + tile.firstChunk, chunkVisible.begin() + end, uint8_t(1));
+            chunkStats.chunksDrawn += tile.chunkCount;
+        }
+        for (size_t i = tile.firstChunk; i < end; ++i) {
+            if (!chunkVisible[i])
+                continue;
+            // The slice of the chunk; its points are shuffled, so this is an even subset.
+            const int32_t first = chunks.first[i] + static_cast<int32_t>(chunks.count[i] * double(sliceBegin));
+            const int32_t count = chunks.first[i] + static_cast<int32_t>(chunks.count[i] * double(sliceEnd)) - first;
+            if (count <= 0)
+                continue;
+            chunkStats.pointsDrawn += count;
+            if (drawFirst.size() > tileRanges && drawFirst.back() + drawCount.back() == first) {
+                drawCount.back() += count;
+            } else {
+                drawFirst.push_back(first);
+                drawCount.push_back(count);
+            }
+        }
+        drawTileEnd.push_back(drawFirst.size());
+    }
+    chunkStats.drawRanges = drawFirst.size();
+
+    if (indirectDraw) {
+        // One command per range; baseInstance selects the tile index the range is drawn with.
+        drawCommands.clear();
+        size_t begin = 0;
+        for (size_t t = 0; t < drawTileEnd.size(); begin = drawTileEnd[t++]) {
+            for (size_t i = begin; i < drawTileEnd[t]; ++i) {
+                drawCommands.push_back({static_cast<GLuint>(drawCount[i]), 1, static_cast<GLuint>(drawFirst[i]),
+                                        static_cast<GLuint>(t)});
+            }
+        }
+        size_t bytes = drawCommands.size() * sizeof(DrawArraysIndirectCommand);
+        if (!indirectBuffer) glGenBuffers(1, &indirectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        if (bytes > indirectCapacity) {
+            indirectCapacity = std::max(bytes, indirectCapacity * 2);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, static_cast<GLsizeiptr>(indirectCapacity), nullptr, GL_STREAM_DRAW);
+        }
+        if (bytes > 0)
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, static_cast<GLsizeiptr>(bytes), drawCommands.data());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        chunkStats.drawCalls = drawCommands.empty() ? 0 : 1;
+    } else {
+        for (size_t t = 0; t < drawTileEnd.size(); ++t)
+            chunkStats.drawCalls += drawTileEnd[t] > (t == 0 ? 0 : drawTileEnd[t - 1]) ? 1 : 0;
+    }
+    draw(shader);
+}
 
-    // Color attribute (location 1)
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Point), (void*)offsetof(Point, color));
+void PointRenderer::draw(const Shader &shader) const {
+    if (lod) {
+        lod->render(shader, cameraOrigin);
+        return;
+    }
+    if (stream) {
+        stream->render(shader, cameraOrigin);
+        return;
+    }
+    setShaderUniforms(shader);
+    glBindVertexArray(VAO);
+    if (gpuCulled) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gpuCuller->getCommandBuffer());
+        glExtensions().MultiDrawArraysIndirect(GL_POINTS, nullptr, static_cast<GLsizei>(gpuCuller->getCommandCount()), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    } else if (indirectDraw) {
+        if (!drawCommands.empty()) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glExtensions().MultiDrawArraysIndirect(GL_POINTS, nullptr, static_cast<GLsizei>(drawCommands.size()), 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+    } else {
+        // Without base instances the tile index is a constant attribute, set before each tile.
+        size_t begin = 0;
+        for (size_t t = 0; t < drawTileEnd.size(); begin = drawTileEnd[t++]) {
+            if (drawTileEnd[t] == begin)
+                continue;
+            glVertexAttrib1f(LOCATION_TILE, static_cast<float>(t));
+            glMultiDrawArrays(GL_POINTS, drawFirst.data() + begin, drawCount.data() + begin,
+                              static_cast<GLsizei>(drawTileEnd[t] - begin));
+        }
+    }
+    glBindVertexArray(0);
+}
 
-    // Normal attribute (location 2)
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Point), (void*)offsetof(Point, normal));
+void PointRenderer::setShaderUniforms(const Shader &shader) const {
+    shader.setBool("compactVertices", uploadedFormat == VertexFormat::Compact);
+    shader.setBool("sceneTiles", true);
+    shader.setInt("sceneTileData", SCENE_TILES_TEXTURE_UNIT);
+    glActiveTexture(GL_TEXTURE0 + SCENE_TILES_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, tileTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
 
-    glBindVertexArray(0);
+glm::mat4 PointRenderer::renderTransform(const Tile &tile) const
+{
+    glm::dmat4 transform(tile.transform);
+    transform[3] -= glm::dvec4(cameraOrigin, 0.0);
+    return glm::mat4(transform);
 }
 
+void PointRenderer::setCameraOrigin(const glm::dvec3 &position)
+{
+    if (position == cameraOrigin)
+        return;
+    cameraOrigin = position;
+    tileUniformsDirty = true;
+}
 
-bool PointRenderer::loadPointCloud()
+void PointRenderer::uploadTileUniforms()
 {
-    fs::path filePath(filename);
-    if (!fs::exists(filePath)) {
-        std::cerr << "File does not exist: " << filename << std::endl;
-        return false;
+    std::vector<TileUniforms> tileUniforms(tiles.size());
+    for (size_t t = 0; t < tileUniforms.size(); ++t) {
+        tileUniforms[t].model = renderTransform(tiles[t]);
+        tileUniforms[t].boundsMin = glm::vec4(tiles[t].quantizationBounds.min, 0.0f);
+        tileUniforms[t].boundsExtent = glm::vec4(tiles[t].quantizationBounds.extent(), 0.0f);
+    }
+    const size_t bytes = tileUniforms.size() * sizeof(TileUniforms);
+    if (!tileBuffer) {
+        glGenBuffers(1, &tileBuffer);
+        glGenTextures(1, &tileTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, tileTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, tileBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
     }
+    // Sized to the scene; the texture follows the new storage of its buffer.
+    glBindBuffer(GL_TEXTURE_BUFFER, tileBuffer);
+    if (bytes != tileBufferBytes) {
+        glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(bytes), tileUniforms.data(), GL_DYNAMIC_DRAW);
+        tileBufferBytes = bytes;
+    } else if (bytes > 0) {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, static_cast<GLsizeiptr>(bytes), tileUniforms.data());
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    tileUniformsDirty = false;
+}
 
-    std::string ext = filePath.extension().string();
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-    bool loadOk = false;
-    points.clear();
+bool PointRenderer::pick(const glm::vec3 &origin, const glm::vec3 &direction, float tanAngle,
+                         PickResult &result) const
+{
+    bool found = false;
+    for (size_t t = 0; t < trees.size(); ++t) {
+        // The cone keeps its angle in tile coordinates, only distances along it are scaled.
+        glm::mat4 inverse = glm::inverse(tiles[t].transform);
+        glm::vec3 tileOrigin = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+        glm::vec3 tileDirection = glm::normalize(glm::vec3(inverse * glm::vec4(direction, 0.0f)));
+        uint32_t index = 0;
+        float distance = 0.0f;
+        if (!trees[t].pick(tileOrigin, tileDirection, tanAngle, index, distance))
+            continue;
+        distance *= uniformScale(tiles[t].transform);
+        if (!found || distance < result.distance) {
+            result.index = tiles[t].first + index;
+            result.position = getWorldPosition(result.index);
+            result.distance = distance;
+            found = true;
+        }
+    }
+    return found;
+}
 
-    if (ext == ".pts") {
-        if (parallelLoading)
-            loadOk = loadPointCloudParallel(filename);
-        else
-            loadOk = loadPointCloudPts(filename);
-    } else if (ext == ".ply") {
-        loadOk = loadPointCloudPly(filename);
-    } else {
-        std::cerr << "Unsupported file extension: " << ext << std::endl;
-        return false;
+size_t PointRenderer::findNearest(const glm::vec3 &center, size_t k, std::vector<size_t> &indices) const
+{
+    indices.clear();
+    std::vector<std::pair<float, size_t>> candidates;
+    std::vector<uint32_t> tileIndices(k);
+    std::vector<float> distances2(k);
+    for (size_t t = 0; t < trees.size(); ++t) {
+        glm::vec3 tileCenter = glm::vec3(glm::inverse(tiles[t].transform) * glm::vec4(center, 1.0f));
+        float scale = uniformScale(tiles[t].transform);
+        size_t found = trees[t].nearest(tileCenter, k, tileIndices.data(), distances2.data());
+        for (size_t i = 0; i < found; ++i)
+            candidates.emplace_back(distances2[i] * scale * scale, tiles[t].first + tileIndices[i]);
     }
+    // The nearest of every tile, merged.
+    size_t count = std::min(k, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+    for (size_t i = 0; i < count; ++i)
+        indices.push_back(candidates[i].second);
+    return count;
+}
 
-    if (loadOk)
-        setupBuffers();
+size_t PointRenderer::findWithinRadius(const glm::vec3 &center, float radius, std::vector<size_t> &indices) const
+{
+    indices.clear();
+    std::vector<uint32_t> tileIndices;
+    for (size_t t = 0; t < trees.size(); ++t) {
+        glm::vec3 tileCenter = glm::vec3(glm::inverse(tiles[t].transform) * glm::vec4(center, 1.0f));
+        tileIndices.clear();
+        trees[t].withinRadius(tileCenter, radius / uniformScale(tiles[t].transform), tileIndices);
+        for (uint32_t index : tileIndices)
+            indices.push_back(tiles[t].first + index);
+    }
+    return indices.size();
+}
 
-    return loadOk;
+glm::vec3 PointRenderer::getWorldPosition(size_t index) const
+{
+    auto tile = std::upper_bound(tiles.begin(), tiles.end(), index,
+                                 [](size_t i, const Tile &tile) { return i < tile.first + tile.count; });
+    if (tile == tiles.end() || index >= points.size())
+        return glm::vec3(0.0f);
+    return glm::vec3(tile->transform * glm::vec4(points.position(index), 1.0f));
 }
 
-bool PointRenderer::loadPointCloud(const std::string &newFilename)
+BoundingSphere PointRenderer::getBoundingSphere() const
 {
-    // Update the member filename.
-    filename = newFilename;
-    points.clear();
+    if (!lod && !stream)
+        return sphere;
+    Bounds box = getBounds();
+    return {0.5f * (box.min + box.max), 0.5f * glm::length(box.extent())};
+}
+
+void PointRenderer::compareVertexFormats(const PointArrays &points) {
+    using Clock = std::chrono::steady_clock;
+    auto uploadMs = [](const void *data, size_t size) {
+        unsigned int buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glFinish();
+        auto start = Clock::now();
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(size), data, GL_STATIC_DRAW);
+        glFinish();
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        return ms;
+    };
 
-    return loadPointCloud();
+    const double mib = 1024.0 * 1024.0;
+    std::vector<Point> interleaved;
+    interleavePoints(points, 0, points.size(), interleaved);
+    double fullUpload = uploadMs(interleaved.data(), interleaved.size() * sizeof(Point));
+
+    auto packStart = Clock::now();
+    std::vector<CompactPoint> packed(points.size());
+    Bounds packBounds = computeBounds(points.x.data(), points.y.data(), points.z.data(), points.size());
+    packCompactPoints(points, 0, points.size(), packBounds, packed.data());
+    double packMs = std::chrono::duration<double, std::milli>(Clock::now() - packStart).count();
+    double compactUpload = uploadMs(packed.data(), packed.size() * sizeof(CompactPoint));
+
+    std::cout << "[Vertex Format] " << points.size() << " points" << std::endl;
+    std::cout << "[Vertex Format] Full:    " << sizeof(Point) << " B/point, "
+              << points.size() * sizeof(Point) / mib << " MiB, upload " << fullUpload << " ms" << std::endl;
+    std::cout << "[Vertex Format] Compact: " << sizeof(CompactPoint) << " B/point, "
+              << packed.size() * sizeof(CompactPoint) / mib << " MiB, pack " << packMs
+              << " ms, upload " << compactUpload << " ms" << std::endl;
 }
 
-bool PointRenderer::loadPointCloudPts(const std::string &filename)
+bool PointRenderer::prepareCloud(const std::string &file, const LoadOptions &loadOptions, LoadedCloud &cloud,
+                                 LoadProgress *progress)
 {
-    std::ifstream file(filename);
-    if (!file.is_open()){
-        std::cerr << "Failed to open file: " << filename << std::endl;
-        return false;
-    }
-
-    int numPoints = 0;
-    std::string line;
-    // Read the first non-comment line to get the point count.
-    while (std::getline(file, line)) {
-        if (line.size() >= 2 && line[0]=='/' && line[1]=='/')
-            continue;
-        std::istringstream iss(line);
-        if (!(iss >> numPoints)) {
-            std::cerr << "Failed to parse number of points from line: " << line << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    cloud.filename = file;
+    std::vector<SceneEntry> entries;
+    if (std::filesystem::path(file).extension() == SCENE_EXTENSION) {
+        if (!readSceneFile(file, entries))
             return false;
-        }
-        break;
-    }
-    points.reserve(numPoints);
-
-    for (int i = 0; i < numPoints; ++i) {
-        Point pt;
-        file >> pt.position.x >> pt.position.y >> pt.position.z
-             >> pt.color.r >> pt.color.g >> pt.color.b
-             >> pt.normal.x >> pt.normal.y >> pt.normal.z;
-        if (file.fail()) {
-            std::cerr << "Failed to read point " << i << std::endl;
+        if (entries.size() > MAX_SCENE_TILES) {
+            std::cerr << "[Scene] " << entries.size() << " tiles, at most " << MAX_SCENE_TILES << " are supported"
+                      << std::endl;
             return false;
         }
-        points.push_back(pt);
+    } else {
+        entries.push_back({file, glm::mat4(1.0f)});
     }
-    std::cout << "Loaded " << points.size() << " points from PTS file." << std::endl;
-    return true;
-}
 
-#ifdef HAVE_OPENCL
-bool PointRenderer::loadPointCloudParallel(const std::string &filename)
-{
-    std::ifstream file(filename);
-    if (!file.is_open()){
-        std::cerr << "[Parallel Mode] Failed to open file: " << filename << std::endl;
+    // The tiles are loaded in parallel, each one chunked on its own. Only a single file keeps
+    // its cache mapping for the upload.
+    const size_t tileCount = entries.size();
+    std::vector<std::vector<Point>> tilePoints(tileCount);
+    std::vector<ChunkGrid> tileChunks(tileCount);
+    std::vector<glm::dvec3> tileOrigins(tileCount);
+    std::vector<uint8_t> loaded(tileCount, 0), reordered(tileCount, 0);
+    ThreadPool::instance().parallelFor(0, tileCount, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            PointCache *cache = tileCount == 1 ? &cloud.cache : nullptr;
+            if (!loadPoints(entries[t].file, loadOptions, tilePoints[t], tileOrigins[t], cache, progress))
+                continue;
+            // Caches written before chunking was added are in file order and need sorting first.
+            reordered[t] = buildChunkGrid(tilePoints[t], tileChunks[t]);
+            loaded[t] = 1;
+        }
+    });
+    if (progress && progress->cancelled())
         return false;
-    }
-    int numPoints = 0;
-    std::string line;
-    // Read first non-comment line for number of points.
-    while (std::getline(file, line)) {
-        if (line.size() >= 2 && line[0]=='/' && line[1]=='/')
-            continue;
-        std::istringstream iss(line);
-        if (!(iss >> numPoints)) {
-            std::cerr << "[Parallel Mode] Failed to parse number of points from line: " << line << std::endl;
+    if (std::find(loaded.begin(), loaded.end(), 0) != loaded.end())
+        return false;
+
+    // World coordinates are relative to where the first tile's origin ends up, so the tile
+    // transforms stay small even when all tiles are far from zero.
+    cloud.origin = glm::dvec3(glm::dmat4(entries[0].transform) * glm::dvec4(tileOrigins[0], 1.0));
+    cloud.tiles.resize(tileCount);
+    size_t pointCount = 0;
+    for (size_t t = 0; t < tileCount; ++t) {
+        Tile &tile = cloud.tiles[t];
+        tile.filename = entries[t].file;
+        tile.origin = tileOrigins[t];
+        tile.transform = rebaseTransform(entries[t].transform, tile.origin, cloud.origin);
+        tile.first = pointCount;
+        tile.count = tilePoints[t].size();
+        tile.firstChunk = cloud.chunks.size();
+        tile.chunkCount = tileChunks[t].size();
+        pointCount += tile.count;
+        if (pointCount > size_t(std::numeric_limits<int32_t>::max())) {
+            std::cerr << "[Scene] More than " << std::numeric_limits<int32_t>::max() << " points in " << file
+                      << std::endl;
             return false;
         }
-        break;
-    }
-    // Read all remaining float values.
-    std::vector<float> floatData;
-    floatData.reserve(numPoints * 9);
-    float value;
-    while (file >> value)
-        floatData.push_back(value);
-    file.close();
-
-    if (floatData.size() != static_cast<size_t>(numPoints * 9)) {
-        std::cerr << "[Parallel Mode] Expected " << (numPoints * 9)
-                  << " values, but got " << floatData.size() << std::endl;
-        return false;
-    }
 
-    cl_int clStatus;
-    cl_uint numPlatforms;
-    clStatus = clGetPlatformIDs(0, nullptr, &numPlatforms);
-    if (clStatus != CL_SUCCESS || numPlatforms == 0) {
-        std::cerr << "[Parallel Mode] No OpenCL platforms found." << std::endl;
-        return false;
+        // Chunks of all tiles in one grid, their ranges shifted to where the tile starts.
+        const ChunkGrid &grid = tileChunks[t];
+        for (size_t c = 0; c < grid.size(); ++c) {
+            cloud.chunks.minX.push_back(grid.minX[c]);
+            cloud.chunks.minY.push_back(grid.minY[c]);
+            cloud.chunks.minZ.push_back(grid.minZ[c]);
+            cloud.chunks.maxX.push_back(grid.maxX[c]);
+            cloud.chunks.maxY.push_back(grid.maxY[c]);
+            cloud.chunks.maxZ.push_back(grid.maxZ[c]);
+            cloud.chunks.first.push_back(grid.first[c] + static_cast<int32_t>(tile.first));
+            cloud.chunks.count.push_back(grid.count[c]);
+        }
     }
-    std::vector<cl_platform_id> platforms(numPlatforms);
-    clStatus = clGetPlatformIDs(numPlatforms, platforms.data(), nullptr);
-    cl_platform_id platform = platforms[0];
-
-    cl_uint numDevices;
-    clStatus = clGetDeviceIDs(platform, CL_DEVICE_TYPE_DEFAULT, 0, nullptr, &numDevices);
-    if (clStatus != CL_SUCCESS || numDevices == 0) {
-        std::cerr << "[Parallel Mode] No OpenCL devices found." << std::endl;
+    if (progress && progress->cancelled())
         return false;
-    }
-    std::vector<cl_device_id> devices(numDevices);
-    clStatus = clGetDeviceIDs(platform, CL_DEVICE_TYPE_DEFAULT, numDevices, devices.data(), nullptr);
-    cl_device_id device = devices[0];
 
-    cl_context context = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &clStatus);
-    if (clStatus != CL_SUCCESS) {
-        std::cerr << "[Parallel Mode] Failed to create OpenCL context." << std::endl;
-        return false;
+    // From here on the points are kept as arrays only. Each tile is freed once it is split, so
+    // at most one tile is held twice.
+    cloud.arrays.resize(pointCount);
+    for (size_t t = 0; t < tileCount; ++t) {
+        splitPoints(tilePoints[t].data(), tilePoints[t].size(), cloud.arrays, cloud.tiles[t].first);
+        std::vector<Point>().swap(tilePoints[t]);
     }
-    cl_command_queue queue = clCreateCommandQueue(context, device, 0, &clStatus);
-    if (clStatus != CL_SUCCESS) {
-        std::cerr << "[Parallel Mode] Failed to create OpenCL command queue." << std::endl;
-        clReleaseContext(context);
-        return false;
+    for (size_t t = 0; t < tileCount; ++t) {
+        Tile &tile = cloud.tiles[t];
+        const size_t first = tile.first;
+        tile.bounds = computeBounds(cloud.arrays.x.data() + first, cloud.arrays.y.data() + first,
+                                    cloud.arrays.z.data() + first, tile.count);
+        tile.quantizationBounds = tile.bounds;
+        tile.sphere.center = 0.5f * (tile.bounds.min + tile.bounds.max);
+        tile.sphere.radius = computeMaxDistance(cloud.arrays.x.data() + first, cloud.arrays.y.data() + first,
+                                                cloud.arrays.z.data() + first, tile.count, tile.sphere.center);
+        // The box around a rotated tile box can be far larger than the rotated points, so those
+        // tiles transform every point instead.
+        Bounds world = keepsAxes(tile.transform)
+                       ? transformBounds(tile.bounds, tile.transform)
+                       : computeTransformedBounds(tile.transform, cloud.arrays.x.data() + first,
+                                                  cloud.arrays.y.data() + first, cloud.arrays.z.data() + first,
+                                                  tile.count);
+        BoundingSphere worldSphere = transformSphere(tile.sphere, tile.transform);
+        if (t > 0) {
+            world = {glm::min(cloud.bounds.min, world.min), glm::max(cloud.bounds.max, world.max)};
+            worldSphere = mergeSpheres(cloud.sphere, worldSphere);
+        }
+        cloud.bounds = world;
+        cloud.sphere = worldSphere;
     }
 
-    size_t dataSize = floatData.size() * sizeof(float);
-    cl_mem inputBuffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, dataSize, floatData.data(), &clStatus);
-    if (clStatus != CL_SUCCESS) {
-        std::cerr << "[Parallel Mode] Failed to create input buffer." << std::endl;
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
-        return false;
+    if (cloud.cache.file.isOpen() && !reordered[0] && loadOptions.vertexFormat == VertexFormat::Full) {
+        // The attribute blocks go to the GPU straight from the mapping.
+        cloud.data = cloud.cache.data();
+        cloud.size = cloud.cache.header.dataSize;
+        cloud.attributes = cloud.cache.attributes;
+        cloud.format = VertexFormat::Full;
+    } else if (loadOptions.vertexFormat == VertexFormat::Compact) {
+        // Each tile is quantized to its own bounds.
+        cloud.packed.resize(cloud.arrays.size());
+        for (const Tile &tile : cloud.tiles) {
+            packCompactPoints(cloud.arrays, tile.first, tile.count, tile.quantizationBounds,
+                              cloud.packed.data() + tile.first);
+        }
+        cloud.data = reinterpret_cast<const char*>(cloud.packed.data());
+        cloud.size = cloud.packed.size() * sizeof(CompactPoint);
+        cloud.attributes = compactPointLayout();
+        cloud.format = VertexFormat::Compact;
+    } else {
+        // Interleaved from the arrays slice by slice while uploading (see uploadCloud()).
+        cloud.data = nullptr;
+        cloud.size = cloud.arrays.size() * sizeof(Point);
+        cloud.attributes = interleavedPointLayout();
+        cloud.format = VertexFormat::Full;
     }
-    cl_mem outputBuffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, dataSize, nullptr, &clStatus);
-    if (clStatus != CL_SUCCESS) {
-        std::cerr << "[Parallel Mode] Failed to create output buffer." << std::endl;
-        clReleaseMemObject(inputBuffer);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
+
+    if (progress && progress->cancelled())
         return false;
-    }
 
-    // Define a simple kernel that copies data.
-    const char* kernelSource = R"CLC(
-        __kernel void copy_data(__global const float* input, __global float* output) {
-            int i = get_global_id(0);
-            output[i] = input[i];
+    // One k-d tree per tile for picking and measuring, in tile coordinates. The point count is
+    // limited to INT32_MAX above, so the builds cannot fail.
+    auto indexStart = std::chrono::steady_clock::now();
+    cloud.trees.resize(tileCount);
+    ThreadPool::instance().parallelFor(0, tileCount, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            const size_t begin = cloud.tiles[t].first;
+            cloud.trees[t].build(cloud.arrays.x.data() + begin, cloud.arrays.y.data() + begin,
+                                 cloud.arrays.z.data() + begin, cloud.tiles[t].count);
         }
-    )CLC";
-    cl_program program = clCreateProgramWithSource(context, 1, &kernelSource, nullptr, &clStatus);
-    if (clStatus != CL_SUCCESS) {
-        std::cerr << "[Parallel Mode] Failed to create program." << std::endl;
-        clReleaseMemObject(outputBuffer);
-        clReleaseMemObject(inputBuffer);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
-        return false;
+    });
+    auto end = std::chrono::steady_clock::now();
+    cloud.timings.indexMs = std::chrono::duration<double, std::milli>(end - indexStart).count();
+    cloud.timings.prepareMs = std::chrono::duration<double, std::milli>(end - start).count();
+    return true;
+}
+
+bool PointRenderer::uploadCloud(LoadedCloud &cloud, size_t maxBytes)
+{
+    if (!cloud.VBO) {
+        // Only allocate here, the data follows in slices.
+        glGenBuffers(1, &cloud.VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, cloud.VBO);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(cloud.size), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        cloud.capacity = cloud.size;
+        uploader.resetStats();
     }
-    clStatus = clBuildProgram(program, 1, &device, nullptr, nullptr, nullptr);
-    if (clStatus != CL_SUCCESS) {
-        size_t logSize;
-        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &logSize);
-        std::vector<char> buildLog(logSize);
-        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, logSize, buildLog.data(), nullptr);
-        std::cerr << "[Parallel Mode] Error in kernel: " << buildLog.data() << std::endl;
-        clReleaseProgram(program);
-        clReleaseMemObject(outputBuffer);
-        clReleaseMemObject(inputBuffer);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
-        return false;
+    auto start = std::chrono::steady_clock::now();
+    const size_t end = cloud.uploaded + std::min(maxBytes, cloud.size - cloud.uploaded);
+    if (cloud.data) {
+        uploader.upload(cloud.VBO, cloud.uploaded, cloud.data + cloud.uploaded, end - cloud.uploaded);
+        cloud.uploaded = end;
     }
-    cl_kernel kernel = clCreateKernel(program, "copy_data", &clStatus);
-    if (clStatus != CL_SUCCESS) {
-        std::cerr << "[Parallel Mode] Failed to create kernel." << std::endl;
-        clReleaseProgram(program);
-        clReleaseMemObject(outputBuffer);
-        clReleaseMemObject(inputBuffer);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
-        return false;
+    // Without 'data' the Full format is interleaved from the arrays, a few MiB at a time, so the
+    // whole cloud never exists twice on the CPU. A slice may start and end inside a point.
+    while (cloud.uploaded < end) {
+        const size_t firstPoint = cloud.uploaded / sizeof(Point);
+        const size_t sliceEnd = std::min(end, (firstPoint + INTERLEAVE_POINTS) * sizeof(Point));
+        const size_t lastPoint = (sliceEnd + sizeof(Point) - 1) / sizeof(Point);
+        interleavePoints(cloud.arrays, firstPoint, lastPoint - firstPoint, cloud.interleaved);
+        uploader.upload(cloud.VBO, cloud.uploaded,
+                        reinterpret_cast<const char*>(cloud.interleaved.data()) + (cloud.uploaded - firstPoint * sizeof(Point)),
+                        sliceEnd - cloud.uploaded);
+        cloud.uploaded = sliceEnd;
     }
-    clStatus  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &inputBuffer);
-    clStatus |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &outputBuffer);
-    if (clStatus != CL_SUCCESS) {
-        std::cerr << "[Parallel Mode] Failed to set kernel arguments." << std::endl;
-        clReleaseKernel(kernel);
-        clReleaseProgram(program);
-        clReleaseMemObject(outputBuffer);
-        clReleaseMemObject(inputBuffer);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
-        return false;
+    if (cloud.uploaded == cloud.size)
+        std::vector<Point>().swap(cloud.interleaved);
+    cloud.timings.uploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return cloud.uploaded == cloud.size;
+}
+
+void PointRenderer::installCloud(LoadedCloud &cloud)
+{
+    lod.reset();
+    stream.reset();
+    if (VBO && VBO != cloud.VBO) glDeleteBuffers(1, &VBO);
+
+    ++cloudVersion;
+    VBO = cloud.VBO;
+    vboCapacity = cloud.capacity;
+    cloud.VBO = 0;
+    if (!VAO) glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    // Position (location 0), color (location 1) and normal (location 2) attributes.
+    applyVertexLayout(cloud.attributes);
+
+    // The tile index comes per instance from a buffer of 0, 1, 2, ... when the draw commands can
+    // pick the instance, and is set as a constant attribute before each tile otherwise.
+    indirectDraw = glExtensions().multiDrawIndirect;
+    if (indirectDraw) {
+        std::vector<float> indices(cloud.tiles.size());
+        for (size_t t = 0; t < indices.size(); ++t)
+            indices[t] = static_cast<float>(t);
+        if (!tileIndexVBO) glGenBuffers(1, &tileIndexVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, tileIndexVBO);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(float)), indices.data(),
+                     GL_STATIC_DRAW);
+        glEnableVertexAttribArray(LOCATION_TILE);
+        glVertexAttribPointer(LOCATION_TILE, 1, GL_FLOAT, GL_FALSE, sizeof(float), nullptr);
+        glVertexAttribDivisor(LOCATION_TILE, 1);
+    } else {
+        glDisableVertexAttribArray(LOCATION_TILE);
     }
-    size_t globalSize = floatData.size();
-    clStatus = clEnqueueNDRangeKernel(queue, kernel, 1, nullptr, &globalSize, nullptr, 0, nullptr, nullptr);
-    if (clStatus != CL_SUCCESS) {
-        std::cerr << "[Parallel Mode] Failed to enqueue kernel." << std::endl;
-        clReleaseKernel(kernel);
-        clReleaseProgram(program);
-        clReleaseMemObject(outputBuffer);
-        clReleaseMemObject(inputBuffer);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
-        return false;
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (GpuChunkCuller::isSupported()) {
+        if (!gpuCuller)
+            gpuCuller = std::make_unique<GpuChunkCuller>();
+        if (gpuCuller->isValid()) {
+            std::vector<uint32_t> chunkTile(cloud.chunks.size());
+            for (size_t t = 0; t < cloud.tiles.size(); ++t) {
+                const Tile &tile = cloud.tiles[t];
+                std::fill(chunkTile.begin() + tile.firstChunk, chunkTile.begin() + tile.firstChunk + tile.chunkCount,
+                          static_cast<uint32_t>(t));
+            }
+            gpuCuller->setChunks(cloud.chunks, chunkTile);
+        }
     }
-    clFinish(queue);
-    std::vector<float> outputData(floatData.size());
-    clStatus = clEnqueueReadBuffer(queue, outputBuffer, CL_TRUE, 0, dataSize, outputData.data(), 0, nullptr, nullptr);
-    if (clStatus != CL_SUCCESS) {
-        std::cerr << "[Parallel Mode] Failed to read output buffer." << std::endl;
-        clReleaseKernel(kernel);
-        clReleaseProgram(program);
-        clReleaseMemObject(outputBuffer);
-        clReleaseMemObject(inputBuffer);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
+
+    if (options.compareFormats)
+        compareVertexFormats(cloud.arrays);
+    filename = cloud.filename;
+    // Only the positions are needed on the CPU, for picking and measuring.
+    points = std::move(cloud.arrays);
+    points.releaseAttributes();
+    tiles = std::move(cloud.tiles);
+    trees = std::move(cloud.trees);
+    chunks = std::move(cloud.chunks);
+    uploadedFormat = cloud.format;
+    bounds = cloud.bounds;
+    sphere = cloud.sphere;
+    origin = cloud.origin;
+    gpuBytes = cloud.size;
+    loadTimings = cloud.timings;
+    uploadTileUniforms();
+}
+
+void PointRenderer::discardCloud(std::unique_ptr<LoadedCloud> &cloud)
+{
+    if (cloud && cloud->VBO)
+        glDeleteBuffers(1, &cloud->VBO);
+    cloud.reset();
+}
+
+void PointRenderer::releaseCloud()
+{
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (VBO) glDeleteBuffers(1, &VBO);
+    VAO = VBO = 0;
+    vboCapacity = 0;
+    gpuBytes = 0;
+    points.clear();
+    tiles.clear();
+    trees.clear();
+    chunks.clear();
+    drawTileEnd.clear();
+    loadTimings = LoadTimings();
+    lod.reset();
+    stream.reset();
+}
+
+bool PointRenderer::loadLod(const std::string &file)
+{
+    auto octree = std::make_unique<LodOctree>();
+    if (!octree->open(file))
         return false;
-    }
-    clReleaseKernel(kernel);
-    clReleaseProgram(program);
-    clReleaseMemObject(outputBuffer);
-    clReleaseMemObject(inputBuffer);
-    clReleaseCommandQueue(queue);
-    clReleaseContext(context);
-
-    points.resize(numPoints);
-    for (int i = 0; i < numPoints; ++i) {
-        int base = i * 9;
-        points[i].position = glm::vec3(outputData[base], outputData[base + 1], outputData[base + 2]);
-        points[i].color    = glm::vec3(outputData[base + 3], outputData[base + 4], outputData[base + 5]);
-        points[i].normal   = glm::vec3(outputData[base + 6], outputData[base + 7], outputData[base + 8]);
-    }
-    std::cout << "[Parallel Mode] Loaded " << points.size() << " points." << std::endl;
+    releaseCloud();
+    filename = file;
+    lod = std::move(octree);
+    ++cloudVersion;
+    return true;
+}
+
+bool PointRenderer::openStream(const std::string &address)
+{
+    auto feed = std::make_unique<PointStream>();
+    if (!feed->open(address))
+        return false;
+    releaseCloud();
+    filename = address;
+    stream = std::move(feed);
+    streamFramed = false;
+    ++cloudVersion;
     return true;
 }
-#else
-// If OpenCL is not available, provide a stub implementation.
-bool PointRenderer::loadPointCloudParallel(const std::string &filename)
+
+bool PointRenderer::loadPointCloud()
 {
-    std::cerr << "Parallel loading disabled: OpenCL not found." << std::endl;
-    return false;
+    return loadPointCloud(filename);
 }
-#endif // HAVE_OPENCL
 
-bool PointRenderer::loadPointCloudPly(const std::string &filename)
+bool PointRenderer::loadPointCloud(const std::string &newFilename)
 {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file.is_open()){
-        std::cerr << "[PLY Mode] Failed to open file: " << filename << std::endl;
+    cancelLoad();
+    // LOD files are not loaded as a whole but streamed node by node while rendering.
+    if (std::filesystem::path(newFilename).extension() == LOD_EXTENSION)
+        return loadLod(newFilename);
+    if (StreamConnection::isStreamAddress(newFilename))
+        return openStream(newFilename);
+
+    LoadedCloud cloud;
+    if (!prepareCloud(newFilename, options, cloud, nullptr))
         return false;
+    // Nothing has to be drawn while loading here, so the current buffer can be overwritten
+    // if it is big enough.
+    if (VBO && vboCapacity >= cloud.size) {
+        cloud.VBO = VBO;
+        cloud.capacity = vboCapacity;
+        uploader.resetStats();
     }
+    uploadCloud(cloud, cloud.size);
+    // Include the time the GPU needs to finish the copies.
+    auto start = std::chrono::steady_clock::now();
+    glFinish();
+    cloud.timings.uploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    installCloud(cloud);
+    return true;
+}
 
-    std::string line;
-    int numPoints = 0;
-    bool headerEnded = false;
-    // Parse header: look for "element vertex" and "end_header"
-    while (std::getline(file, line)) {
-        if (line.find("element vertex") != std::string::npos) {
-            std::istringstream iss(line);
-            std::string token;
-            // Expected: "element vertex <numPoints>"
-            iss >> token; // "element"
-            iss >> token; // "vertex"
-            iss >> numPoints;
-        }
-        if (line == "end_header") {
-            headerEnded = true;
-            break;
-        }
+void PointRenderer::loadPointCloudAsync(const std::string &newFilename)
+{
+    // A cancelled load may still be in a long processing stage. It is not waited for here, so
+    // the UI does not freeze; update() drops it once it returns.
+    cancelLoad();
+    if (asyncLoad.valid())
+        cancelledLoads.push_back(std::move(asyncLoad));
+    asyncLoad = {};
+
+    // Opening a LOD file only maps it and a stream reads on its own thread, there is nothing to
+    // do in the background.
+    if (std::filesystem::path(newFilename).extension() == LOD_EXTENSION) {
+        if (!loadLod(newFilename))
+            std::cerr << "Failed to load point cloud from file: " << newFilename << std::endl;
+        return;
     }
-
-    if (!headerEnded) {
-        std::cerr << "[PLY Mode] 'end_header' not found in file." << std::endl;
-        return false;
+    if (StreamConnection::isStreamAddress(newFilename)) {
+        if (!openStream(newFilename))
+            std::cerr << "Failed to open point stream: " << newFilename << std::endl;
+        return;
     }
 
-    std::cout << "[PLY Mode] Number of points in PLY: " << numPoints << std::endl;
+    loadProgress = std::make_shared<LoadProgress>();
+    asyncLoad = std::async(std::launch::async, [newFilename, loadOptions = options, progress = loadProgress]() {
+        auto cloud = std::make_unique<LoadedCloud>();
+        if (!prepareCloud(newFilename, loadOptions, *cloud, progress.get()))
+            cloud.reset();
+        return cloud;
+    });
+}
 
-    // Define a packed structure to match the binary layout in the file.
-    #pragma pack(push, 1)
-    struct PlyVertex {
-        float x, y, z;
-        float nx, ny, nz;
-        unsigned char r, g, b, cls;
-    };
-    #pragma pack(pop)
+void PointRenderer::cancelLoad()
+{
+    // The loading thread notices on its next progress report; its result is dropped in update().
+    loadProgress->cancelRequested = true;
+    discardCloud(uploading);
+}
 
-    size_t vertexSize = sizeof(PlyVertex); // expected to be 28 bytes
-    std::vector<PlyVertex> vertices(numPoints);
+float PointRenderer::getUploadProgress() const
+{
+    return uploading && uploading->size > 0 ? static_cast<float>(uploading->uploaded) / uploading->size : 0.0f;
+}
 
-    file.read(reinterpret_cast<char*>(vertices.data()), numPoints * vertexSize);
-    if (!file) {
-        std::cerr << "[PLY Mode] Error reading binary PLY data." << std::endl;
-        return false;
+void PointRenderer::update()
+{
+    if (stream) {
+        stream->update();
+        // Counts as a new cloud once the first points are in, so the camera frames them.
+        if (!streamFramed && stream->getPointCount() > 0) {
+            streamFramed = true;
+            ++cloudVersion;
+        }
     }
-    file.close();
-
-    points.resize(numPoints);
-    for (int i = 0; i < numPoints; ++i) {
-        points[i].position = glm::vec3(vertices[i].x, vertices[i].y, vertices[i].z);
-        points[i].normal   = glm::vec3(vertices[i].nx, vertices[i].ny, vertices[i].nz);
-        // Convert color from 0-255 to [0,1] range.
-        points[i].color    = glm::vec3(vertices[i].r / 255.0f, vertices[i].g / 255.0f, vertices[i].b / 255.0f);
+    // Loads hold no GL objects until they are uploaded here, so finished cancelled ones are just dropped.
+    cancelledLoads.erase(std::remove_if(cancelledLoads.begin(), cancelledLoads.end(), [](const auto &load) {
+        return load.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), cancelledLoads.end());
+    if (asyncLoad.valid() && asyncLoad.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        std::unique_ptr<LoadedCloud> cloud = asyncLoad.get();
+        if (loadProgress->cancelled()) {
+            std::cout << "Loading cancelled." << std::endl;
+            return;
+        }
+        if (!cloud) {
+            std::cerr << "Failed to load point cloud in the background." << std::endl;
+            return;
+        }
+        uploading = std::move(cloud);
     }
 
-    std::cout << "[PLY Mode] Loaded " << points.size() << " points." << std::endl;
-    return true;
+    // Upload a slice per frame and switch over once the whole cloud is on the GPU.
+    if (uploading && uploadCloud(*uploading, uploadBytesPerFrame)) {
+        installCloud(*uploading);
+        uploading.reset();
+    }
 }
-
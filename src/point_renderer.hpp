@@ -5,42 +5,263 @@
 #ifndef POINT_RENDERER_HPP
 #define POINT_RENDERER_HPP
 
+#include <future>
+#include <memory>
 #include <string>
 #include <vector>
 #include <glm/glm.hpp>
+#include "buffer_uploader.hpp"
+#include "chunk_grid.hpp"
+#include "compact_vertex.hpp"
+#include "gl_extensions.hpp"
+#include "gpu_culler.hpp"
+#include "kd_tree.hpp"
+#include "load_progress.hpp"
+#include "lod_octree.hpp"
+#include "point.hpp"
+#include "point_cache.hpp"
+#include "point_arrays.hpp"
+#include "point_loader.hpp"
+#include "point_stream.hpp"
+#include "shader.hpp"
+#include "vertex_layout.hpp"
 
-struct Point {
-    glm::vec3 position;
-    glm::vec3 color;
-    glm::vec3 normal;
-};
-
+// Draws a point cloud, or a scene of several clouds ("tiles", see scene_file.hpp) that share one
+// vertex buffer. A single file is loaded as a scene with one tile at the identity transform.
+// Instead of a file, a live feed can be drawn (see point_stream.hpp) by loading a stream address.
+// "World" coordinates below are relative to getOrigin(), which keeps them small for clouds in
+// large (e.g. georeferenced) coordinates.
 class PointRenderer {
 public:
-    explicit PointRenderer(const std::string& filename, bool parallel = false);
+    // What the last render() drew.
+    struct ChunkStats {
+        size_t chunksTotal = 0;
+        size_t chunksDrawn = 0;
+        size_t pointsDrawn = 0;
+        size_t drawRanges = 0;  // ranges drawn after merging neighbours
+        size_t drawCalls = 0;   // one multi-draw per tile, or one indirect multi-draw for all tiles
+    };
+
+    // One file of the loaded scene. Its points are one range of the vertex buffer and its chunks
+    // one range of getChunks(), with the chunk bounds in tile coordinates.
+    struct Tile {
+        std::string filename;
+        glm::mat4 transform{1.0f};    // tile to world coordinates
+        glm::dvec3 origin{0.0};       // position of the tile coordinates' zero in its file
+        Bounds bounds{};              // in tile coordinates
+        Bounds quantizationBounds{};  // bounds the compact positions are relative to
+        BoundingSphere sphere{};      // around the box center, in tile coordinates
+        size_t first = 0;
+        size_t count = 0;
+        size_t firstChunk = 0;
+        size_t chunkCount = 0;
+    };
+
+    // How long the last load took.
+    struct LoadTimings {
+        double prepareMs = 0.0;  // parsing or reading the cache, chunking, packing and indexing
+        double indexMs = 0.0;    // the part of prepareMs spent building the k-d trees
+        double uploadMs = 0.0;   // copying the vertex data to the GPU
+    };
+
+    // A point hit by pick().
+    struct PickResult {
+        size_t index = 0;           // into the points of all tiles, one after the other
+        glm::vec3 position{0.0f};   // world coordinates
+        float distance = 0.0f;      // from the ray origin
+    };
+
+    explicit PointRenderer(const std::string& filename, const LoadOptions& options = LoadOptions());
     ~PointRenderer();
 
-    // Render the point cloud
-    void render() const;
+    // Pick up a finished background load and upload the next slice of it. Call once per frame
+    // before render().
+    void update();
+    // Render the point cloud with 'shader', which must be in use with its matrices set.
+    // For LOD files this also selects and streams the nodes for the view.
+    // Only the points in [sliceBegin, sliceEnd) of the range of every chunk are drawn. The points
+    // are shuffled within their chunks, so a slice is an even subset (ignored for LOD files).
+    void render(const Shader& shader, const glm::mat4& projection, const glm::mat4& view, float sliceBegin = 0.0f,
+                float sliceEnd = 1.0f);
+    // Draw again what the last render() selected, e.g. for another pass with a different shader.
+    void draw(const Shader& shader) const;
+
+    // Vertex format used for the next load.
+    VertexFormat getVertexFormat() const { return options.vertexFormat; }
+    void setVertexFormat(VertexFormat format) { options.vertexFormat = format; }
+    size_t getPointCount() const
+    {
+        return lod ? lod->getPointCount() : stream ? stream->getPointCount() : points.size();
+    }
+    // Changes whenever another cloud is installed.
+    uint64_t getCloudVersion() const { return cloudVersion; }
+    size_t getGpuBytes() const
+    {
+        return lod ? lod->getStats().gpuBytes : stream ? stream->getStats().gpuBytes : gpuBytes;
+    }
+    // World-space bounds of all tiles.
+    Bounds getBounds() const { return lod ? lod->getBounds() : stream ? stream->getBounds() : bounds; }
+    // World-space sphere around all points, computed while loading (around the bounds for LOD files).
+    BoundingSphere getBoundingSphere() const;
+    // Where world coordinates are zero, in the coordinates of the (first) file. Adding it to a
+    // world position gives the coordinates as stored in the file.
+    glm::dvec3 getOrigin() const { return lod ? lod->getOrigin() : stream ? stream->getOrigin() : origin; }
+    // Subtracted from the tile transforms in double precision before rendering, for views made
+    // with Camera::GetRenderViewMatrix() (see Camera::CameraRelative). Zero by default.
+    void setCameraOrigin(const glm::dvec3& position);
+    const glm::dvec3& getCameraOrigin() const { return cameraOrigin; }
+    const std::vector<Tile>& getTiles() const { return tiles; }
+    // Whether all tiles are drawn with one glMultiDrawArraysIndirect call (GL 4.3).
+    bool isIndirectDraw() const { return indirectDraw; }
+    const LoadTimings& getLoadTimings() const { return loadTimings; }
+    // Slices and fence waits of the last upload, and whether it went through the staging ring.
+    const BufferUploader::Stats& getUploadStats() const { return uploader.getStats(); }
+    bool isPersistentUpload() const { return uploader.isPersistent(); }
+    // Skip the chunks outside the view frustum (on by default).
+    bool getFrustumCulling() const { return frustumCulling; }
+    void setFrustumCulling(bool enabled) { frustumCulling = enabled; }
+    // Cull the chunks with a compute shader instead of on the CPU, where supported (on by default).
+    bool getGpuCulling() const { return gpuCulling; }
+    void setGpuCulling(bool enabled) { gpuCulling = enabled; }
+    bool isGpuCullingAvailable() const { return gpuCuller && gpuCuller->isValid(); }
+    // With GPU culling the chunk and point counts are those of a frame or two ago.
+    const ChunkStats& getChunkStats() const { return chunkStats; }
+    const ChunkGrid& getChunks() const { return chunks; }
+    // Whether each chunk was drawn by the last render(). All chunks are drawn with culling off,
+    // and count as drawn with GPU culling, whose result stays on the GPU.
+    bool isChunkDrawn(size_t chunk) const
+    {
+        return !frustumCulling || gpuCulled || (chunk < chunkVisible.size() && chunkVisible[chunk]);
+    }
+    // Spatial queries in world coordinates, answered by a k-d tree per tile that is built while
+    // loading. Tile transforms may rotate, translate and scale uniformly. LOD files and streams
+    // have no trees, so nothing is found in them.
+    //
+    // The first point along the ray inside the cone with the given tangent of its half angle.
+    bool pick(const glm::vec3& origin, const glm::vec3& direction, float tanAngle, PickResult& result) const;
+    // The (up to) 'k' points nearest to 'center', closest first. Returns how many were found.
+    size_t findNearest(const glm::vec3& center, size_t k, std::vector<size_t>& indices) const;
+    // All points within 'radius' of 'center', in no particular order. Returns how many were found.
+    size_t findWithinRadius(const glm::vec3& center, float radius, std::vector<size_t>& indices) const;
+    glm::vec3 getWorldPosition(size_t index) const;
+    // The streamed octree if a ".lod" file is loaded, null otherwise.
+    LodOctree* getLod() const { return lod.get(); }
+    // The live feed if a stream address is loaded, null otherwise.
+    PointStream* getStream() const { return stream.get(); }
 
     // Load the point cloud using the stored filename.
     bool loadPointCloud();
-    // Clear the existing data and load from a new file (updates the member filename).
+    // Load from a new file and replace the current cloud (updates the member filename).
+    // ".scene" files load all their tiles in parallel, stream addresses (see
+    // StreamConnection::isStreamAddress()) are connected to and drawn as their points arrive.
+    // Blocks until the cloud is on the GPU; the current cloud is kept if loading fails.
     bool loadPointCloud(const std::string& filename);
 
+    // Load a new file on a background thread. The current cloud keeps being drawn until the new
+    // one is parsed and uploaded; the upload is spread over frames by render().
+    // A load that is still running is cancelled first.
+    void loadPointCloudAsync(const std::string& filename);
+    // Stop the background load, if any.
+    void cancelLoad();
+    bool isLoading() const { return asyncLoad.valid() || uploading != nullptr; }
+    const LoadProgress& getLoadProgress() const { return *loadProgress; }
+    // Fraction of the new cloud that is on the GPU, 0 while it is still being parsed.
+    float getUploadProgress() const;
+
+    size_t uploadBytesPerFrame = size_t(32) << 20;
+
 private:
-    // These methods load based on file format
-    bool loadPointCloudPts(const std::string& filename);
-    bool loadPointCloudPly(const std::string& filename);
-    bool loadPointCloudParallel(const std::string& filename);
+    // A point cloud ready for upload. Built by the loading thread without touching GL,
+    // then uploaded and installed by the render thread.
+    struct LoadedCloud {
+        std::string filename;
+        std::vector<Tile> tiles;
+        std::vector<KdTree> trees;              // one per tile
+        PointArrays arrays;                     // all tiles, kept by the renderer after the upload
+        std::vector<Point> interleaved;         // slice of 'arrays' being uploaded in the Full format
+        ChunkGrid chunks;
+        PointCache cache;                       // mapping 'data' points into, if loaded from a cache
+        std::vector<CompactPoint> packed;
+        const char* data = nullptr;             // vertex data for the GPU, null to interleave 'arrays'
+        size_t size = 0;
+        std::vector<VertexAttribute> attributes;
+        VertexFormat format = VertexFormat::Full;
+        Bounds bounds{};                        // world bounds of all tiles
+        BoundingSphere sphere{};                // world sphere around all tiles
+        glm::dvec3 origin{0.0};                 // see getOrigin()
+        unsigned int VBO = 0;
+        size_t capacity = 0;                    // allocated size of 'VBO'
+        size_t uploaded = 0;                    // bytes of 'data' already in 'VBO'
+        LoadTimings timings;
+    };
 
-    // Once points are loaded, this method (re)creates the OpenGL buffers.
-    void setupBuffers();
+    // Parse the file, or the files of a scene in parallel, and lay out the vertex data (any thread).
+    static bool prepareCloud(const std::string& filename, const LoadOptions& options, LoadedCloud& cloud,
+                             LoadProgress* progress);
+    // Upload up to 'maxBytes' more bytes of the cloud. Returns true once all of it is on the GPU.
+    bool uploadCloud(LoadedCloud& cloud, size_t maxBytes);
+    // Replace the current cloud with an uploaded one.
+    void installCloud(LoadedCloud& cloud);
+    void discardCloud(std::unique_ptr<LoadedCloud>& cloud);
+    // Upload 'cloud' once in each vertex format and print memory use and upload time.
+    static void compareVertexFormats(const PointArrays& cloud);
+    bool loadLod(const std::string& filename);
+    bool openStream(const std::string& address);
+    // Drop the GPU buffers and CPU data of the current cloud, for a LOD file or stream replacing it.
+    void releaseCloud();
 
-    std::vector<Point> points;
+    // Set the uniforms and bind the tile buffer point_cloud.vs needs for the current cloud.
+    void setShaderUniforms(const Shader& shader) const;
+    // Tile to world transform moved by -cameraOrigin, as drawn.
+    glm::mat4 renderTransform(const Tile& tile) const;
+    // Write the render transforms and quantization bounds of all tiles to tileBuffer.
+    void uploadTileUniforms();
+
+    PointArrays points;                // positions of all tiles, one after the other (the rest is on the GPU)
+    std::vector<Tile> tiles;
+    std::vector<KdTree> trees;         // one per tile, indices relative to the first point of the tile
+    ChunkGrid chunks;                  // 'points' and the VBO are stored in chunk order, tile by tile
+    std::vector<uint8_t> chunkVisible;
+    std::vector<int32_t> drawFirst, drawCount;
+    std::vector<size_t> drawTileEnd;   // end of the ranges of each tile in drawFirst/drawCount
+    std::vector<DrawArraysIndirectCommand> drawCommands;
+    bool indirectDraw = false;
+    bool frustumCulling = true;
+    bool gpuCulling = true;
+    bool gpuCulled = false;            // the last render() drew the commands of gpuCuller
+    std::unique_ptr<GpuChunkCuller> gpuCuller;
+    std::vector<Frustum> tileFrustums;
+    ChunkStats chunkStats;
+    std::unique_ptr<LodOctree> lod;
+    std::unique_ptr<PointStream> stream;
+    bool streamFramed = false;         // cloudVersion was bumped for the first points of 'stream'
     unsigned int VAO, VBO;
+    size_t vboCapacity = 0;                           // allocated size of VBO, may exceed gpuBytes
+    unsigned int tileBuffer = 0;                      // TileUniforms of all tiles
+    unsigned int tileTexture = 0;                     // tileBuffer as an RGBA32F buffer texture
+    size_t tileBufferBytes = 0;
+    unsigned int tileIndexVBO = 0;                    // 0, 1, 2, ... read per instance as aTile
+    unsigned int indirectBuffer = 0;                  // drawCommands
+    size_t indirectCapacity = 0;
+    BufferUploader uploader;
     std::string filename;
-    bool parallelLoading;
+    LoadOptions options;
+    VertexFormat uploadedFormat = VertexFormat::Full; // format of the current VBO
+    Bounds bounds{};
+    BoundingSphere sphere{};
+    glm::dvec3 origin{0.0};
+    glm::dvec3 cameraOrigin{0.0};
+    bool tileUniformsDirty = false;    // cameraOrigin changed since the last uploadTileUniforms()
+    size_t gpuBytes = 0;
+    uint64_t cloudVersion = 0;
+    LoadTimings loadTimings;
+
+    // Each background load has its own progress, so a cancelled one that is still finishing
+    // its current stage never sees the progress of the load that replaced it.
+    std::shared_ptr<LoadProgress> loadProgress = std::make_shared<LoadProgress>();
+    std::future<std::unique_ptr<LoadedCloud>> asyncLoad;
+    std::vector<std::future<std::unique_ptr<LoadedCloud>>> cancelledLoads;   // dropped once they return
+    std::unique_ptr<LoadedCloud> uploading;   // parsed cloud that is being uploaded
 };
 
 
@@ -0,0 +1,235 @@
+﻿//
+// src/point_stream.cpp
+//
+
+#include "point_stream.hpp"
+#include "stream_format.hpp"
+#include "vertex_layout.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+// How long the reader waits for data before it checks whether to stop.
+constexpr int READ_TIMEOUT_MS = 50;
+// Points the reader takes from the connection at once.
+constexpr size_t READ_BLOCK_POINTS = 4096;
+// The GPU ring starts with room for this many points and doubles from there.
+constexpr size_t MIN_CAPACITY = size_t(1) << 16;
+
+} // namespace
+
+PointStream::~PointStream()
+{
+    close();
+}
+
+bool PointStream::open(const std::string &address, size_t ringPoints)
+{
+    close();
+    // Pipes and stdin open at once, a TCP connect may not (see readerLoop()).
+    const bool tcp = StreamConnection::isTcpAddress(address);
+    if (!tcp && !connection.openRead(address))
+        return false;
+    ring = std::make_unique<SpscRing<Point>>(ringPoints);
+    stopReader = false;
+    readerConnected = !tcp;
+    readerEnded = false;
+    batchesRead = 0;
+    pointsRead = 0;
+    pointsDropped = 0;
+    reader = std::thread(&PointStream::readerLoop, this, tcp ? address : std::string());
+    std::cout << "[Stream] " << (tcp ? "Connecting to " : "Reading from ") << address << " (ring of "
+              << ring->capacity() << " points)" << std::endl;
+    return true;
+}
+
+void PointStream::close()
+{
+    if (reader.joinable()) {
+        stopReader = true;
+        reader.join();
+    }
+    connection.close();
+    ring.reset();
+    if (VBO) glDeleteBuffers(1, &VBO);
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    VAO = VBO = 0;
+    capacity = 0;
+    writeIndex = 0;
+    std::vector<Point>().swap(staging);
+    readerOrigin = origin = glm::dvec3(0.0);
+    bounds = Bounds{};
+    stats = Stats();
+}
+
+bool PointStream::readFully(char *data, size_t size)
+{
+    while (size > 0) {
+        if (stopReader)
+            return false;
+        long received = connection.read(data, size, READ_TIMEOUT_MS);
+        if (received < 0)
+            return false;
+        data += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+void PointStream::readerLoop(const std::string &tcpAddress)
+{
+    // Gives up when close() sets stopReader, so closing does not wait for the system's connect timeout.
+    if (!tcpAddress.empty()) {
+        if (!connection.openRead(tcpAddress, &stopReader)) {
+            readerEnded = true;
+            return;
+        }
+        readerConnected = true;
+    }
+    std::vector<Point> block(READ_BLOCK_POINTS);
+    bool first = true;
+    bool ok = true;
+    while (ok && !stopReader) {
+        StreamBatchHeader header;
+        if (!readFully(reinterpret_cast<char*>(&header), sizeof(header)))
+            break;
+        if (std::memcmp(header.magic, STREAM_MAGIC, sizeof(header.magic)) != 0 || header.version != STREAM_VERSION
+            || header.pointCount > MAX_STREAM_BATCH_POINTS) {
+            std::cerr << "[Stream] Corrupt batch header after " << pointsRead << " points, closing the stream" << std::endl;
+            break;
+        }
+        const glm::dvec3 batchOrigin(header.origin[0], header.origin[1], header.origin[2]);
+        if (first) {
+            readerOrigin = batchOrigin;
+            first = false;
+        }
+        // Later batches may use another origin; their offsets are moved onto the first one in double.
+        const glm::dvec3 shift = batchOrigin - readerOrigin;
+        for (uint32_t done = 0; done < header.pointCount;) {
+            const size_t count = std::min<size_t>(READ_BLOCK_POINTS, header.pointCount - done);
+            if (!readFully(reinterpret_cast<char*>(block.data()), count * sizeof(Point))) {
+                ok = false;
+                break;
+            }
+            if (shift != glm::dvec3(0.0)) {
+                for (size_t i = 0; i < count; ++i)
+                    block[i].position = glm::vec3(glm::dvec3(block[i].position) + shift);
+            }
+            const size_t pushed = ring->push(block.data(), count);
+            pointsDropped += count - pushed;
+            pointsRead += count;
+            done += static_cast<uint32_t>(count);
+        }
+        if (ok)
+            ++batchesRead;
+    }
+    if (!stopReader)
+        std::cout << "[Stream] Stream ended after " << batchesRead << " batches, " << pointsRead << " points" << std::endl;
+    readerEnded = true;
+}
+
+void PointStream::resize(size_t newCapacity)
+{
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(newCapacity * sizeof(Point)), nullptr, GL_DYNAMIC_DRAW);
+
+    // The newest points end just before writeIndex, possibly wrapping around the end of the old ring.
+    const size_t kept = std::min(stats.pointsResident, newCapacity);
+    if (kept > 0) {
+        const size_t start = (writeIndex + capacity - kept) % capacity;
+        const size_t part = std::min(kept, capacity - start);
+        glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(start * sizeof(Point)), 0,
+                            static_cast<GLsizeiptr>(part * sizeof(Point)));
+        if (kept > part) {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+                                static_cast<GLintptr>(part * sizeof(Point)),
+                                static_cast<GLsizeiptr>((kept - part) * sizeof(Point)));
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    if (VBO) glDeleteBuffers(1, &VBO);
+    VBO = buffer;
+    stats.pointsEvicted += stats.pointsResident - kept;
+    stats.pointsResident = kept;
+    capacity = newCapacity;
+    writeIndex = kept % newCapacity;
+    stats.gpuBytes = newCapacity * sizeof(Point);
+
+    if (!VAO) glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    applyVertexLayout(interleavedPointLayout());
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void PointStream::update()
+{
+    if (!ring)
+        return;
+    stats.batchesReceived = batchesRead;
+    stats.pointsReceived = pointsRead;
+    stats.pointsDropped = pointsDropped;
+    stats.connected = readerConnected;
+    stats.ended = readerEnded && ring->size() == 0;
+
+    // A lowered budget applies at once, keeping the newest points.
+    const size_t budget = std::max<size_t>(pointBudget, 1);
+    if (capacity > budget)
+        resize(budget);
+
+    staging.resize(std::max<size_t>(maxPointsPerFrame, 1));
+    size_t count = ring->pop(staging.data(), staging.size());
+    if (count == 0)
+        return;
+
+    Bounds received = {staging[0].position, staging[0].position};
+    for (size_t i = 1; i < count; ++i) {
+        received.min = glm::min(received.min, staging[i].position);
+        received.max = glm::max(received.max, staging[i].position);
+    }
+    if (stats.pointsResident + stats.pointsEvicted == 0) {
+        origin = readerOrigin;
+        bounds = received;
+    } else {
+        bounds = {glm::min(bounds.min, received.min), glm::max(bounds.max, received.max)};
+    }
+
+    // Grow the ring until it reaches the budget; from then on the oldest points are overwritten.
+    if (stats.pointsResident + count > capacity && capacity < budget)
+        resize(std::min(budget, std::max({capacity * 2, stats.pointsResident + count, MIN_CAPACITY})));
+    // More points than the whole ring holds: the oldest of them would be overwritten right away.
+    const size_t skipped = count > capacity ? count - capacity : 0;
+    const Point *points = staging.data() + skipped;
+    count -= skipped;
+
+    const size_t part = std::min(count, capacity - writeIndex);
+    uploader.upload(VBO, writeIndex * sizeof(Point), points, part * sizeof(Point));
+    if (count > part)
+        uploader.upload(VBO, 0, points + part, (count - part) * sizeof(Point));
+    writeIndex = (writeIndex + count) % capacity;
+    const size_t total = stats.pointsResident + count;
+    stats.pointsEvicted += skipped + (total > capacity ? total - capacity : 0);
+    stats.pointsResident = std::min(total, capacity);
+}
+
+void PointStream::render(const Shader &shader, const glm::dvec3 &offset) const
+{
+    if (!VAO || stats.pointsResident == 0)
+        return;
+    shader.setBool("compactVertices", false);
+    shader.setBool("sceneTiles", false);
+    shader.setMat4("model", glm::translate(glm::mat4(1.0f), -glm::vec3(offset)));
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(stats.pointsResident));
+    glBindVertexArray(0);
+}
@@ -0,0 +1,99 @@
+﻿//
+// src/point_stream.hpp
+//
+
+#ifndef POINT_STREAM_HPP
+#define POINT_STREAM_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "buffer_uploader.hpp"
+#include "point.hpp"
+#include "shader.hpp"
+#include "spsc_ring.hpp"
+#include "stream_connection.hpp"
+
+// Draws a live point feed (see stream_format.hpp) from stdin, a named pipe or a TCP connection.
+//
+// A background thread reads the batches and pushes their points into a lock-free ring shared
+// with the render thread only (see spsc_ring.hpp). Every frame update() moves what arrived into
+// a GPU ring buffer, which grows up to 'pointBudget' points; past that the newest points
+// overwrite the oldest ones. When the reader falls behind because the render thread does not
+// drain the ring, the points that do not fit are dropped rather than stalling the sender.
+class PointStream {
+public:
+    struct Stats {
+        uint64_t batchesReceived = 0;
+        uint64_t pointsReceived = 0;
+        uint64_t pointsDropped = 0;    // did not fit into the ring
+        uint64_t pointsEvicted = 0;    // overwritten on the GPU past the budget
+        size_t pointsResident = 0;
+        size_t gpuBytes = 0;
+        bool connected = false;        // the reader thread has opened the connection
+        bool ended = false;            // the sender closed it or sent a corrupt batch, or it could not be opened
+    };
+
+    PointStream() = default;
+    ~PointStream();
+    PointStream(const PointStream&) = delete;
+    PointStream& operator=(const PointStream&) = delete;
+
+    // Connect to 'address' (see StreamConnection) and start reading. 'ringPoints' is the capacity
+    // of the ring between the reader and the render thread. TCP addresses are connected to on the
+    // reader thread, so an unreachable host does not stall the caller; a failed connect ends the stream.
+    bool open(const std::string& address, size_t ringPoints = size_t(1) << 21);
+    void close();
+
+    // Upload the points received since the last call, at most 'maxPointsPerFrame' of them.
+    void update();
+    // Draw all resident points. 'offset' is subtracted from the positions in double precision,
+    // for camera-relative rendering.
+    void render(const Shader& shader, const glm::dvec3& offset = glm::dvec3(0.0)) const;
+
+    const Stats& getStats() const { return stats; }
+    size_t getPointCount() const { return stats.pointsResident; }
+    // Bounds of all points received so far, including evicted ones.
+    Bounds getBounds() const { return bounds; }
+    // Origin of the first batch; the positions of all batches are rebased onto it.
+    glm::dvec3 getOrigin() const { return origin; }
+
+    size_t pointBudget = 10000000;           // points kept on the GPU at most
+    size_t maxPointsPerFrame = size_t(1) << 20;
+
+private:
+    // Connects to 'tcpAddress' first, unless it is empty.
+    void readerLoop(const std::string& tcpAddress);
+    // Read exactly 'size' bytes unless the stream ends or close() is called.
+    bool readFully(char* data, size_t size);
+    // Reallocate the GPU ring for 'capacity' points, keeping the newest resident ones.
+    void resize(size_t capacity);
+
+    StreamConnection connection;
+    std::unique_ptr<SpscRing<Point>> ring;
+    std::thread reader;
+    std::atomic<bool> stopReader{false};
+    // Written by the reader thread, read by update().
+    std::atomic<uint64_t> batchesRead{0};
+    std::atomic<uint64_t> pointsRead{0};
+    std::atomic<uint64_t> pointsDropped{0};
+    std::atomic<bool> readerConnected{false};
+    std::atomic<bool> readerEnded{false};
+    // Set by the reader before its first push, so update() may read it once it has popped a point.
+    glm::dvec3 readerOrigin{0.0};
+    glm::dvec3 origin{0.0};                  // copy of 'readerOrigin' for the render thread
+
+    unsigned int VAO = 0, VBO = 0;
+    size_t capacity = 0;                     // points 'VBO' holds
+    size_t writeIndex = 0;                   // slot the next point goes to
+    std::vector<Point> staging;
+    BufferUploader uploader;
+    Bounds bounds{};
+    Stats stats;
+};
+
+#endif // POINT_STREAM_HPP
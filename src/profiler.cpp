@@ -0,0 +1,170 @@
+﻿//
+// src/profiler.cpp
+//
+
+#include "profiler.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <glad/glad.h>
+
+namespace {
+
+constexpr const char *FRAME_PASS = "Frame";
+
+float percentile(std::vector<float> &values, float p)
+{
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5f);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+} // namespace
+
+Profiler::~Profiler()
+{
+    for (Pass &pass : passes) {
+        if (pass.gpu)
+            glDeleteQueries(QUERY_FRAMES, pass.queries.data());
+    }
+}
+
+size_t Profiler::findPass(const char *name, bool gpu)
+{
+    for (size_t i = 0; i < passes.size(); ++i) {
+        if (passes[i].name == name)
+            return i;
+    }
+    Pass pass;
+    pass.name = name;
+    pass.gpu = gpu;
+    pass.cpuMs.assign(HISTORY, -1.0f);
+    pass.gpuMs.assign(HISTORY, -1.0f);
+    if (gpu)
+        glGenQueries(QUERY_FRAMES, pass.queries.data());
+    passes.push_back(std::move(pass));
+    return passes.size() - 1;
+}
+
+void Profiler::collect(Pass &pass)
+{
+    for (unsigned slot = 0; slot < QUERY_FRAMES; ++slot) {
+        if (!pass.pending[slot])
+            continue;
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(pass.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(pass.queries[slot], GL_QUERY_RESULT, &nanoseconds);
+        pass.gpuMs[pass.queryFrame[slot] % HISTORY] = static_cast<float>(nanoseconds / 1e6);
+        pass.pending[slot] = false;
+    }
+}
+
+void Profiler::beginFrame()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (enabled && frame > 0) {
+        Pass &total = passes[findPass(FRAME_PASS, false)];
+        total.cpuMs[(frame - 1) % HISTORY] = std::chrono::duration<float, std::milli>(now - frameStart).count();
+    }
+    frameStart = now;
+    ++frame;
+
+    for (Pass &pass : passes) {
+        pass.cpuMs[frame % HISTORY] = -1.0f;
+        pass.gpuMs[frame % HISTORY] = -1.0f;
+        if (pass.gpu)
+            collect(pass);
+    }
+}
+
+void Profiler::begin(const char *name, bool gpu)
+{
+    if (!enabled)
+        return;
+    bool useGpu = gpu && !gpuQueryActive;
+    size_t index = findPass(name, useGpu);
+    Pass &pass = passes[index];
+    if (useGpu && pass.gpu) {
+        unsigned slot = frame % QUERY_FRAMES;
+        // A result still not available after QUERY_FRAMES frames is dropped rather than waited for.
+        pass.pending[slot] = false;
+        glBeginQuery(GL_TIME_ELAPSED, pass.queries[slot]);
+        pass.queryFrame[slot] = frame;
+        gpuQueryActive = true;
+    } else {
+        useGpu = false;
+    }
+    open.push_back({index, std::chrono::steady_clock::now(), useGpu});
+}
+
+void Profiler::end()
+{
+    // Scopes opened before the profiler was disabled are still closed.
+    if (open.empty())
+        return;
+    OpenScope scope = open.back();
+    open.pop_back();
+    Pass &pass = passes[scope.pass];
+    if (scope.gpu) {
+        glEndQuery(GL_TIME_ELAPSED);
+        pass.pending[frame % QUERY_FRAMES] = true;
+        gpuQueryActive = false;
+    }
+    float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - scope.start).count();
+    float &sample = pass.cpuMs[frame % HISTORY];
+    sample = sample < 0.0f ? ms : sample + ms;
+}
+
+std::vector<float> Profiler::history(const Pass &pass, bool gpu) const
+{
+    const std::vector<float> &samples = gpu ? pass.gpuMs : pass.cpuMs;
+    std::vector<float> values;
+    values.reserve(HISTORY);
+    for (size_t i = 1; i <= HISTORY; ++i) {
+        float value = samples[(frame + i) % HISTORY];
+        if (value >= 0.0f)
+            values.push_back(value);
+    }
+    return values;
+}
+
+Profiler::Summary Profiler::summarize(const Pass &pass, bool gpu) const
+{
+    std::vector<float> values = history(pass, gpu);
+    Summary summary;
+    if (values.empty())
+        return summary;
+    summary.last = values.back();
+    summary.p50 = percentile(values, 0.50f);
+    summary.p95 = percentile(values, 0.95f);
+    summary.p99 = percentile(values, 0.99f);
+    return summary;
+}
+
+bool Profiler::dump(const std::string &filename) const
+{
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        std::cerr << "[Profiler] Failed to create file: " << filename << std::endl;
+        return false;
+    }
+    out << "frame,pass,cpu_ms,gpu_ms\n";
+    uint64_t first = frame >= HISTORY ? frame - HISTORY + 1 : 1;
+    for (uint64_t f = first; f <= frame; ++f) {
+        for (const Pass &pass : passes) {
+            float cpu = pass.cpuMs[f % HISTORY], gpu = pass.gpuMs[f % HISTORY];
+            if (cpu < 0.0f && gpu < 0.0f)
+                continue;
+            out << f << "," << pass.name << ",";
+            if (cpu >= 0.0f) out << cpu;
+            out << ",";
+            if (gpu >= 0.0f) out << gpu;
+            out << "\n";
+        }
+    }
+    std::cout << "[Profiler] Wrote " << filename << std::endl;
+    return true;
+}
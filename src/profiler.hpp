@@ -0,0 +1,96 @@
+﻿//
+// src/profiler.hpp
+//
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-pass CPU and GPU frame timings.
+//
+// GPU times come from GL_TIME_ELAPSED queries. Every pass has a small ring of query objects,
+// and a result is only read once GL reports it available, a few frames later. So the
+// profiler never waits for the GPU. GL allows only one active GL_TIME_ELAPSED query, so GPU
+// scopes must not overlap. Nested scopes are measured on the CPU only.
+class Profiler {
+public:
+    static constexpr size_t HISTORY = 240;        // frames kept per pass
+    static constexpr unsigned QUERY_FRAMES = 4;   // frames a GPU result may lag behind
+
+    struct Pass {
+        std::string name;
+        bool gpu = false;
+        std::vector<float> cpuMs;       // ring of HISTORY samples, -1 if the pass did not run
+        std::vector<float> gpuMs;
+        std::array<unsigned int, QUERY_FRAMES> queries{};
+        std::array<uint64_t, QUERY_FRAMES> queryFrame{};
+        std::array<bool, QUERY_FRAMES> pending{};
+    };
+
+    struct Summary {
+        float last = 0.0f;
+        float p50 = 0.0f;
+        float p95 = 0.0f;
+        float p99 = 0.0f;
+    };
+
+    Profiler() = default;
+    ~Profiler();
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // Start a new frame: records the CPU time of the last frame and collects finished queries.
+    void beginFrame();
+    // Time a pass until the matching end(). 'gpu' also issues a timer query.
+    void begin(const char* name, bool gpu = true);
+    void end();
+
+    bool isEnabled() const { return enabled; }
+    void setEnabled(bool value) { enabled = value; }
+    uint64_t getFrame() const { return frame; }
+    const std::vector<Pass>& getPasses() const { return passes; }
+
+    // Samples of a pass in chronological order, missing ones left out.
+    std::vector<float> history(const Pass& pass, bool gpu) const;
+    Summary summarize(const Pass& pass, bool gpu) const;
+
+    // Write all kept samples as CSV (frame,pass,cpu_ms,gpu_ms).
+    bool dump(const std::string& filename) const;
+
+private:
+    struct OpenScope {
+        size_t pass;
+        std::chrono::steady_clock::time_point start;
+        bool gpu;
+    };
+
+    size_t findPass(const char* name, bool gpu);
+    // Read the query results that are available without waiting.
+    void collect(Pass& pass);
+
+    std::vector<Pass> passes;
+    std::vector<OpenScope> open;
+    bool gpuQueryActive = false;
+    bool enabled = true;
+    uint64_t frame = 0;
+    std::chrono::steady_clock::time_point frameStart;
+};
+
+// Times the enclosing block as one pass of 'profiler'.
+class ProfileScope {
+public:
+    ProfileScope(Profiler& profiler, const char* name, bool gpu = true) : profiler(profiler) { profiler.begin(name, gpu); }
+    ~ProfileScope() { profiler.end(); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    Profiler& profiler;
+};
+
+#endif // PROFILER_HPP
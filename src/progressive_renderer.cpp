@@ -0,0 +1,128 @@
+﻿//
+// src/progressive_renderer.cpp
+//
+
+#include "progressive_renderer.hpp"
+#include "depth_range.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+GLuint createTexture(GLint internalFormat, GLenum format, GLenum type, int width, int height)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+} // namespace
+
+ProgressiveRenderer::ProgressiveRenderer()
+    : compositeShader("shaders/fullscreen.vs", "shaders/progressive_composite.fs")
+{
+    compositeShader.use();
+    compositeShader.setInt("colorTexture", 0);
+    compositeShader.setInt("depthTexture", 1);
+    glUseProgram(0);
+    glGenVertexArrays(1, &emptyVAO);
+}
+
+ProgressiveRenderer::~ProgressiveRenderer()
+{
+    resize(0, 0);
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void ProgressiveRenderer::resize(int newWidth, int newHeight)
+{
+    if (newWidth == width && newHeight == height)
+        return;
+    started = false;
+    if (framebuffer) {
+        glDeleteFramebuffers(1, &framebuffer);
+        GLuint textures[] = {colorTexture, depthTexture};
+        glDeleteTextures(2, textures);
+        framebuffer = colorTexture = depthTexture = 0;
+    }
+    width = newWidth;
+    height = newHeight;
+    if (width <= 0 || height <= 0)
+        return;
+
+    colorTexture = createTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    depthTexture = createTexture(GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLint previous = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "[Progressive] Framebuffer is incomplete" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previous));
+}
+
+void ProgressiveRenderer::render(PointRenderer &renderer, const Shader &shader, const FrameUniforms &uniforms,
+                                 const ProgressiveSettings &settings)
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    resize(viewport[2], viewport[3]);
+    if (!framebuffer)
+        return;
+    GLint target = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    // LOD files stream in new nodes and live streams new points without the view changing, so
+    // they are drawn whole every frame.
+    const bool lod = renderer.getLod() != nullptr || renderer.getStream() != nullptr;
+    const bool restart = !started || lod || renderer.getCloudVersion() != lastCloud ||
+                         renderer.getCameraOrigin() != lastCameraOrigin ||
+                         std::memcmp(&uniforms, &lastUniforms, sizeof(FrameUniforms)) != 0;
+    float sliceBegin = drawn, sliceEnd = drawn;
+    if (restart) {
+        const GLfloat clearColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        const GLfloat clearDepth = farDepth();
+        glClearBufferfv(GL_COLOR, 0, clearColor);
+        glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+        sliceBegin = 0.0f;
+        sliceEnd = lod ? 1.0f : std::clamp(settings.movingFraction, 0.01f, 1.0f);
+        started = true;
+        lastUniforms = uniforms;
+        lastCloud = renderer.getCloudVersion();
+        lastCameraOrigin = renderer.getCameraOrigin();
+    } else if (drawn < 1.0f) {
+        sliceEnd = std::min(1.0f, drawn + std::max(settings.refineFraction, 0.01f));
+    }
+    if (sliceEnd > sliceBegin) {
+        renderer.render(shader, uniforms.projection, uniforms.view, sliceBegin, sliceEnd);
+        drawn = sliceEnd;
+    }
+
+    // Composite into the target framebuffer, writing depth for everything drawn afterwards.
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(target));
+    glDepthFunc(GL_ALWAYS);
+    compositeShader.use();
+    compositeShader.setFloat("farDepth", farDepth());
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glDepthFunc(depthFunction());
+}
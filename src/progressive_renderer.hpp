@@ -0,0 +1,62 @@
+﻿//
+// src/progressive_renderer.hpp
+//
+
+#ifndef PROGRESSIVE_RENDERER_HPP
+#define PROGRESSIVE_RENDERER_HPP
+
+#include <cstdint>
+#include <glad/glad.h>
+#include "frame_uniforms.hpp"
+#include "point_renderer.hpp"
+#include "shader.hpp"
+
+// Options of progressive rendering, set from the menu.
+struct ProgressiveSettings {
+    bool enabled = false;
+    float movingFraction = 0.1f;   // share of the points drawn while the view changes
+    float refineFraction = 0.15f;  // share of the points added per frame while it does not
+};
+
+// Progressive point rendering into an offscreen color and depth buffer that is kept between frames.
+//
+// While the view (or anything else in the per-frame uniforms) changes, the buffer is cleared and
+// only the first 'movingFraction' of every chunk is drawn, so interaction stays smooth on huge
+// clouds. Once the view stays the same, the next slices of every chunk are added on top each
+// frame until all points are in. The points are shuffled within their chunks (see
+// shuffleChunks()), so every slice is an even subset. The buffer is composited into the target
+// framebuffer with its depth each frame, so markers and the UI can be drawn on top as usual.
+class ProgressiveRenderer {
+public:
+    ProgressiveRenderer();
+    ~ProgressiveRenderer();
+
+    ProgressiveRenderer(const ProgressiveRenderer&) = delete;
+    ProgressiveRenderer& operator=(const ProgressiveRenderer&) = delete;
+
+    // Draw the next slice of the points of 'renderer' with 'shader', then composite the image into
+    // the bound framebuffer, sized like the current viewport. 'shader' must be in use with its
+    // 'model' set, and 'uniforms' must be the per-frame values uploaded for this frame.
+    void render(PointRenderer& renderer, const Shader& shader, const FrameUniforms& uniforms,
+                const ProgressiveSettings& settings);
+
+private:
+    // (Re)create the textures if the size changed.
+    void resize(int width, int height);
+
+    Shader compositeShader;
+    GLuint framebuffer = 0;
+    GLuint colorTexture = 0;
+    GLuint depthTexture = 0;
+    GLuint emptyVAO = 0;        // for the full-screen triangle
+    int width = 0;
+    int height = 0;
+
+    bool started = false;       // the buffer holds an image of 'lastUniforms', 'lastCloud' and 'lastCameraOrigin'
+    FrameUniforms lastUniforms;
+    uint64_t lastCloud = 0;
+    glm::dvec3 lastCameraOrigin{0.0};  // moves the view with camera-relative rendering, see PointRenderer
+    float drawn = 0.0f;         // the slice [0, drawn) of every chunk is in the buffer
+};
+
+#endif // PROGRESSIVE_RENDERER_HPP
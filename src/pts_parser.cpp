@@ -0,0 +1,268 @@
+﻿//
+// src/pts_parser.cpp
+//
+
+#include "pts_parser.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+
+// Chunks smaller than this are not worth a thread of their own.
+constexpr size_t MIN_CHUNK_BYTES = 1 << 20;
+
+// Records are stored as X Y Z R G B Nx Ny Nz whatever the file has.
+constexpr size_t VALUES_PER_POINT = 9;
+
+// Lines parsed between two progress reports.
+constexpr size_t PROGRESS_LINES = 1 << 14;
+
+struct PtsChunk {
+    const char *begin;
+    const char *end;
+    std::vector<float> values;  // VALUES_PER_POINT floats per parsed point
+    size_t recordSize = 0;      // values per line in the file, 0 before the first line
+    float maxColor = 0.0f;
+    bool failed = false;
+
+    size_t numPoints() const { return values.size() / VALUES_PER_POINT; }
+};
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline const char *skipBlanks(const char *p, const char *end)
+{
+    while (p < end && isBlank(*p))
+        ++p;
+    return p;
+}
+
+// Parse a single whitespace-delimited float or double. std::from_chars ignores the global locale
+// and does not allocate, unlike operator>> on a stream.
+// Returns the position after the token, or nullptr if the token is not a valid number.
+template <typename T>
+inline const char *parseNumber(const char *p, const char *end, T &value)
+{
+    p = skipBlanks(p, end);
+    if (p < end && *p == '+')
+        ++p;
+    auto [ptr, ec] = std::from_chars(p, end, value);
+    if (ec != std::errc() || (ptr < end && !isBlank(*ptr)))
+        return nullptr;
+    return ptr;
+}
+
+// Position of the first record in [begin, end), for chooseOrigin(). Zero if there is none.
+glm::dvec3 firstPosition(const char *p, const char *end)
+{
+    while (p < end) {
+        const char *lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!lineEnd)
+            lineEnd = end;
+        if (skipBlanks(p, lineEnd) != lineEnd) {
+            double v[3];
+            const char *q = p;
+            for (size_t i = 0; i < 3 && q; ++i)
+                q = parseNumber(q, lineEnd, v[i]);
+            return q ? glm::dvec3(v[0], v[1], v[2]) : glm::dvec3(0.0);
+        }
+        p = lineEnd + 1;
+    }
+    return glm::dvec3(0.0);
+}
+
+// Parse all lines of a chunk. Stops at the first malformed line or when the load is cancelled.
+void parseChunk(PtsChunk &chunk, const glm::dvec3 &origin, LoadProgress *progress)
+{
+    // Rough guess of the bytes per point line, only used to limit reallocations.
+    chunk.values.reserve(static_cast<size_t>(chunk.end - chunk.begin) / 48 * VALUES_PER_POINT);
+
+    const char *p = chunk.begin;
+    const char *reportedBytes = p;
+    size_t reportedPoints = 0;
+    size_t lines = 0;
+    while (p < chunk.end) {
+        if (++lines % PROGRESS_LINES == 0) {
+            if (!reportProgress(progress, p - reportedBytes, chunk.numPoints() - reportedPoints)) {
+                chunk.failed = true;
+                return;
+            }
+            reportedBytes = p;
+            reportedPoints = chunk.numPoints();
+        }
+        const char *lineEnd = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+        if (!lineEnd)
+            lineEnd = chunk.end;
+
+        if (skipBlanks(p, lineEnd) != lineEnd) {
+            // Only the position needs double precision, the other values stay floats.
+            double position[3];
+            float attributes[MAX_PTS_VALUES - 3];
+            size_t count = 0;
+            const char *q = p;
+            for (; q && count < MAX_PTS_VALUES && skipBlanks(q, lineEnd) != lineEnd; ++count)
+                q = count < 3 ? parseNumber(q, lineEnd, position[count]) : parseNumber(q, lineEnd, attributes[count - 3]);
+            if (!q || skipBlanks(q, lineEnd) != lineEnd || !isPtsRecordSize(count)
+                || (chunk.recordSize != 0 && count != chunk.recordSize)) {
+                chunk.failed = true;
+                return;
+            }
+            chunk.recordSize = count;
+            Point pt = ptsRecordToPoint(position, attributes, count, origin);
+            const float record[VALUES_PER_POINT] = {pt.position.x, pt.position.y, pt.position.z,
+                                                    pt.color.r, pt.color.g, pt.color.b,
+                                                    pt.normal.x, pt.normal.y, pt.normal.z};
+            chunk.values.insert(chunk.values.end(), record, record + VALUES_PER_POINT);
+            if (count >= 6)
+                chunk.maxColor = std::max({chunk.maxColor, pt.color.r, pt.color.g, pt.color.b});
+        }
+        p = lineEnd + 1;
+    }
+    reportProgress(progress, chunk.end - reportedBytes, chunk.numPoints() - reportedPoints);
+}
+
+} // namespace
+
+bool isPtsRecordSize(size_t count)
+{
+    return count == 3 || count == 4 || count == 6 || count == 7 || count == 9;
+}
+
+Point ptsRecordToPoint(const double *position, const float *attributes, size_t count, const glm::dvec3 &origin)
+{
+    Point pt;
+    pt.position = glm::vec3(glm::dvec3(position[0], position[1], position[2]) - origin);
+    pt.color = glm::vec3(1.0f);
+    pt.normal = glm::vec3(0.0f);
+    if (count == 6 || count == 9)
+        pt.color = glm::vec3(attributes[0], attributes[1], attributes[2]);
+    else if (count == 7)
+        pt.color = glm::vec3(attributes[1], attributes[2], attributes[3]);
+    if (count == 9)
+        pt.normal = glm::vec3(attributes[3], attributes[4], attributes[5]);
+    return pt;
+}
+
+bool parsePtsHeader(const char *begin, const char *end, int &numPoints, const char *&body)
+{
+    numPoints = 0;
+    const char *p = begin;
+    while (p < end) {
+        const char *lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!lineEnd)
+            lineEnd = end;
+        const char *next = lineEnd < end ? lineEnd + 1 : end;
+
+        if (lineEnd - p >= 2 && p[0] == '/' && p[1] == '/') {
+            p = next;
+            continue;
+        }
+
+        const char *q = p;
+        while (q < lineEnd && isBlank(*q))
+            ++q;
+        if (q < lineEnd && *q == '+')
+            ++q;
+        auto [ptr, ec] = std::from_chars(q, lineEnd, numPoints);
+        if (ec != std::errc() || numPoints < 0) {
+            std::cerr << "Failed to parse number of points from line: " << std::string(p, lineEnd) << std::endl;
+            return false;
+        }
+        body = next;
+        return true;
+    }
+    body = end;
+    return true;
+}
+
+bool parsePtsPoints(const char *begin, const char *end, int numPoints, std::vector<Point> &points,
+                    glm::dvec3 &origin, LoadProgress *progress)
+{
+    // Known before the chunks are parsed, so all of them store their positions relative to it.
+    origin = chooseOrigin(firstPosition(begin, end));
+    ThreadPool &pool = ThreadPool::instance();
+    size_t bytes = static_cast<size_t>(end - begin);
+    size_t numChunks = std::max<size_t>(1, std::min<size_t>(pool.size() * 4, bytes / MIN_CHUNK_BYTES));
+
+    // Split into roughly equal ranges, moving each boundary forward to the next line start.
+    std::vector<PtsChunk> chunks(numChunks);
+    const char *chunkBegin = begin;
+    for (size_t i = 0; i < numChunks; ++i) {
+        const char *chunkEnd = end;
+        if (i + 1 < numChunks) {
+            chunkEnd = std::max(chunkBegin, begin + bytes * (i + 1) / numChunks);
+            const char *newline = static_cast<const char*>(std::memchr(chunkEnd, '\n', end - chunkEnd));
+            chunkEnd = newline ? newline + 1 : end;
+        }
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    pool.parallelFor(0, numChunks, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+            parseChunk(chunks[i], origin, progress);
+    });
+    if (progress && progress->cancelled())
+        return false;
+
+    // Walk the chunks in file order to find where each one lands in the output and to
+    // report the first malformed point with the same index the stream parser would.
+    std::vector<size_t> offsets(numChunks, 0);
+    size_t total = 0;
+    size_t usedChunks = 0;
+    size_t recordSize = 0;
+    float maxColor = 0.0f;
+    for (const PtsChunk &chunk : chunks) {
+        if (total >= static_cast<size_t>(numPoints))
+            break;
+        if (chunk.recordSize != 0) {
+            if (recordSize != 0 && chunk.recordSize != recordSize) {
+                std::cerr << "Inconsistent number of values per point: " << recordSize << " and "
+                          << chunk.recordSize << std::endl;
+                return false;
+            }
+            recordSize = chunk.recordSize;
+        }
+        offsets[usedChunks++] = total;
+        total += chunk.numPoints();
+        maxColor = std::max(maxColor, chunk.maxColor);
+        if (chunk.failed && total < static_cast<size_t>(numPoints)) {
+            std::cerr << "Failed to read point " << total << std::endl;
+            return false;
+        }
+    }
+    if (total < static_cast<size_t>(numPoints)) {
+        std::cerr << "Failed to read point " << total << std::endl;
+        return false;
+    }
+
+    // Build the interleaved points. Trailing records beyond the header count are dropped like
+    // in the stream parser.
+    const float colorScale = maxColor > 1.0f ? 1.0f / 255.0f : 1.0f;
+    points.resize(numPoints);
+    pool.parallelFor(0, usedChunks, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            PtsChunk &chunk = chunks[i];
+            size_t count = std::min(chunk.numPoints(), static_cast<size_t>(numPoints) - offsets[i]);
+            const float *v = chunk.values.data();
+            Point *out = points.data() + offsets[i];
+            for (size_t j = 0; j < count; ++j, v += VALUES_PER_POINT) {
+                out[j].position = glm::vec3(v[0], v[1], v[2]);
+                out[j].color    = glm::vec3(v[3], v[4], v[5]) * colorScale;
+                glm::vec3 normal(v[6], v[7], v[8]);
+                float length = glm::length(normal);
+                out[j].normal = length > 0.0f ? normal / length : normal;
+            }
+            std::vector<float>().swap(chunk.values);
+        }
+    });
+    return true;
+}
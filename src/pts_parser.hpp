@@ -0,0 +1,39 @@
+﻿//
+// src/pts_parser.hpp
+//
+
+#ifndef PTS_PARSER_HPP
+#define PTS_PARSER_HPP
+
+#include <cstddef>
+#include <vector>
+#include "load_progress.hpp"
+#include "point.hpp"
+
+// Parse the header of an in-memory .pts file: comment lines ("//") are skipped
+// until the first number, which is the point count.
+// On success 'body' points to the first byte after the count line.
+bool parsePtsHeader(const char* begin, const char* end, int& numPoints, const char*& body);
+
+// Values per line accepted in .pts files: "X Y Z", "X Y Z I", "X Y Z R G B", "X Y Z I R G B" or
+// "X Y Z R G B Nx Ny Nz". All lines of a file must have the same number of values.
+constexpr size_t MAX_PTS_VALUES = 9;
+bool isPtsRecordSize(size_t count);
+
+// Build a point from one record of 'count' values: the three position values, parsed as doubles,
+// and the 'count' - 3 values after them, parsed as floats. The position is stored relative to
+// 'origin' (see chooseOrigin() in point.hpp), so only the offset from it is rounded to float.
+// The intensity is ignored, missing colors are white and missing normals zero (see
+// estimateNormals() in neighborhood.hpp).
+Point ptsRecordToPoint(const double* position, const float* attributes, size_t count, const glm::dvec3& origin);
+
+// Parse 'numPoints' records (one per line, see isPtsRecordSize()) from [begin, end).
+// 'origin' is set from the first record and the positions are stored relative to it.
+// The range is split into newline-aligned chunks which are parsed on the shared thread pool.
+// The interleaved points are then built in parallel in file order: colors given in 0-255 are
+// scaled to [0,1] and normals are normalized.
+// Parsed bytes and points are added to 'progress'; returns false without a message if it gets cancelled.
+bool parsePtsPoints(const char* begin, const char* end, int numPoints, std::vector<Point>& points,
+                    glm::dvec3& origin, LoadProgress* progress = nullptr);
+
+#endif // PTS_PARSER_HPP
@@ -0,0 +1,64 @@
+﻿//
+// src/scene_file.cpp
+//
+
+#include "scene_file.hpp"
+#include "lod_format.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+bool readSceneFile(const std::string &filename, std::vector<SceneEntry> &entries)
+{
+    entries.clear();
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "[Scene] Failed to open file: " << filename << std::endl;
+        return false;
+    }
+
+    const fs::path directory = fs::path(filename).parent_path();
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        std::istringstream iss(line);
+        std::string path;
+        if (!(iss >> path) || path[0] == '#')
+            continue;
+
+        float values[17];
+        size_t count = 0;
+        while (count < 17 && iss >> values[count])
+            ++count;
+        if (!iss.eof() || (count != 0 && count != 3 && count != 16)) {
+            std::cerr << "[Scene] Expected a path and 0, 3 or 16 numbers in line " << lineNumber << " of "
+                      << filename << std::endl;
+            return false;
+        }
+        fs::path tilePath(path);
+        std::string ext = tilePath.extension().string();
+        if (ext == SCENE_EXTENSION || ext == LOD_EXTENSION) {
+            std::cerr << "[Scene] " << ext << " files cannot be scene tiles (line " << lineNumber << ")" << std::endl;
+            return false;
+        }
+
+        SceneEntry entry;
+        entry.file = (tilePath.is_relative() ? directory / tilePath : tilePath).string();
+        if (count == 3) {
+            entry.transform[3] = glm::vec4(values[0], values[1], values[2], 1.0f);
+        } else if (count == 16) {
+            // Rows in the file, columns in glm.
+            for (int row = 0; row < 4; ++row)
+                for (int column = 0; column < 4; ++column)
+                    entry.transform[column][row] = values[row * 4 + column];
+        }
+        entries.push_back(entry);
+    }
+    if (entries.empty()) {
+        std::cerr << "[Scene] No tiles in " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
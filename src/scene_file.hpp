@@ -0,0 +1,31 @@
+﻿//
+// src/scene_file.hpp
+//
+
+#ifndef SCENE_FILE_HPP
+#define SCENE_FILE_HPP
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// A scene lists point cloud files ("tiles") that are loaded and drawn together, each placed
+// with its own transform, e.g. the registered scans of a survey.
+//
+// Text format, one tile per line:
+//   <path> [tx ty tz | m00 m01 m02 m03 m10 ... m33]
+// The path of a .pts, .ply or .pcc file is followed by nothing (identity), a translation or a
+// 4x4 matrix given row by row. Relative paths are relative to the scene file. Empty lines and
+// lines starting with '#' are skipped.
+constexpr const char* SCENE_EXTENSION = ".scene";
+
+struct SceneEntry {
+    std::string file;
+    glm::mat4 transform{1.0f};   // tile to world coordinates
+};
+
+// Read the entries of a scene file. Returns false with a message if the file cannot be read
+// or a line is malformed.
+bool readSceneFile(const std::string& filename, std::vector<SceneEntry>& entries);
+
+#endif // SCENE_FILE_HPP
@@ -3,11 +3,22 @@
 //
 
 #include "shader.hpp"
+#include "gl_extensions.hpp"
 #include <glad/glad.h>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+namespace {
+
+// The shader files start with a UTF-8 byte order mark, which some GLSL compilers (Mesa) reject.
+const char* skipByteOrderMark(const std::string& code) {
+    return code.compare(0, 3, "\xEF\xBB\xBF") == 0 ? code.c_str() + 3 : code.c_str();
+}
+
+} // namespace
+
 Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     // 1. Retrieve the vertex/fragment source code from filePath
     std::string vertexCode, fragmentCode;
@@ -24,8 +35,8 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     vertexCode = vShaderStream.str();
     fragmentCode = fShaderStream.str();
 
-    const char* vShaderCode = vertexCode.c_str();
-    const char* fShaderCode = fragmentCode.c_str();
+    const char* vShaderCode = skipByteOrderMark(vertexCode);
+    const char* fShaderCode = skipByteOrderMark(fragmentCode);
 
     // 2. Compile shaders
     unsigned int vertex, fragment;
@@ -65,6 +76,90 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+
+    valid = success != 0;
+    reflectUniforms();
+}
+
+Shader::Shader(const char* computePath) {
+    std::ifstream cShaderFile(computePath);
+    if (!cShaderFile.is_open()) {
+        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+    }
+    std::stringstream cShaderStream;
+    cShaderStream << cShaderFile.rdbuf();
+    std::string computeCode = cShaderStream.str();
+    const char* cShaderCode = skipByteOrderMark(computeCode);
+
+    int success;
+    char infoLog[512];
+    unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &cShaderCode, nullptr);
+    glCompileShader(compute);
+    glGetShaderiv(compute, GL_COMPILE_STATUS, &success);
+    if(!success){
+        glGetShaderInfoLog(compute, 512, nullptr, infoLog);
+        std::cerr << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+
+    ID = glCreateProgram();
+    glAttachShader(ID, compute);
+    glLinkProgram(ID);
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    if(!success){
+        glGetProgramInfoLog(ID, 512, nullptr, infoLog);
+        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+    glDeleteShader(compute);
+
+    valid = success != 0;
+    reflectUniforms();
+}
+
+void Shader::reflectUniforms() {
+    int count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(static_cast<size_t>(maxLength > 0 ? maxLength : 1), '\0');
+    for (int i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, static_cast<GLuint>(i), maxLength, &length, &size, &type, &name[0]);
+        std::string uniform(name.data(), static_cast<size_t>(length));
+        // Arrays are reported as "name[0]", but set by their plain name.
+        if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0)
+            uniform.resize(uniform.size() - 3);
+        // Members of uniform blocks have no location.
+        int location = glGetUniformLocation(ID, uniform.c_str());
+        if (location >= 0)
+            uniforms[uniform].location = location;
+    }
+}
+
+Shader::Uniform *Shader::changed(const std::string &name, const void *value, size_t size) const {
+    auto it = uniforms.find(name);
+    if (it == uniforms.end())
+        return nullptr;
+    Uniform &uniform = it->second;
+    if (uniform.valid && std::memcmp(uniform.value.data(), value, size) == 0)
+        return nullptr;
+    std::memcpy(uniform.value.data(), value, size);
+    uniform.valid = true;
+    return &uniform;
+}
+
+int Shader::getUniformLocation(const std::string &name) const {
+    auto it = uniforms.find(name);
+    return it == uniforms.end() ? -1 : it->second.location;
+}
+
+bool Shader::bindUniformBlock(const char *name, unsigned int binding) const {
+    GLuint index = glGetUniformBlockIndex(ID, name);
+    if (index == GL_INVALID_INDEX)
+        return false;
+    glUniformBlockBinding(ID, index, binding);
+    return true;
 }
 
 Shader::~Shader() {
@@ -75,18 +170,23 @@ void Shader::use() const {
     glUseProgram(ID);
 }
 
+// The setters expect the shader to be in use, like glUniform* does.
 void Shader::setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    setInt(name, (int)value);
 }
 void Shader::setInt(const std::string &name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    if (Uniform *uniform = changed(name, &value, sizeof(value)))
+        glUniform1i(uniform->location, value);
 }
 void Shader::setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    if (Uniform *uniform = changed(name, &value, sizeof(value)))
+        glUniform1f(uniform->location, value);
 }
 void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    if (Uniform *uniform = changed(name, &mat[0][0], sizeof(glm::mat4)))
+        glUniformMatrix4fv(uniform->location, 1, GL_FALSE, &mat[0][0]);
 }
 void Shader::setVec3(const std::string &name, const glm::vec3 &value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    if (Uniform *uniform = changed(name, &value[0], sizeof(glm::vec3)))
+        glUniform3fv(uniform->location, 1, &value[0]);
 }
\ No newline at end of file
@@ -5,7 +5,9 @@
 #ifndef SHADER_H
 #define SHADER_H
 
+#include <array>
 #include <string>
+#include <unordered_map>
 #include <glm/glm.hpp>
 
 class Shader {
@@ -13,15 +15,41 @@ public:
     unsigned int ID;
     // constructor reads and builds the shader
     Shader(const char* vertexPath, const char* fragmentPath);
+    // Build a compute program (GL 4.3, see gl_extensions.hpp).
+    explicit Shader(const char* computePath);
     ~Shader();
     // use/activate the shader
     void use() const;
+    // Whether all stages compiled and the program linked.
+    bool isValid() const { return valid; }
     // utility uniform functions
+    // Locations are looked up in a table filled at link time, and a value equal to the last one
+    // set is not sent again. Unknown names (e.g. uniforms optimized out) are ignored.
     void setBool(const std::string &name, bool value) const;
     void setInt(const std::string &name, int value) const;
     void setFloat(const std::string &name, float value) const;
     void setMat4(const std::string &name, const glm::mat4 &mat) const;
     void setVec3(const std::string &name, const glm::vec3 &value) const;
+    // Location of an active uniform, or -1.
+    int getUniformLocation(const std::string &name) const;
+    // Connect the uniform block 'name' to the buffer binding point 'binding'. Returns false if
+    // the program has no such block.
+    bool bindUniformBlock(const char *name, unsigned int binding) const;
+
+private:
+    struct Uniform {
+        int location = -1;
+        bool valid = false;             // 'value' holds what was last set
+        std::array<float, 16> value{};  // last value, raw bits for ints
+    };
+
+    // Fill 'uniforms' with the active uniforms of the linked program.
+    void reflectUniforms();
+    // The entry of 'name' if its value has to be sent, nullptr if it is unknown or unchanged.
+    Uniform *changed(const std::string &name, const void *value, size_t size) const;
+
+    mutable std::unordered_map<std::string, Uniform> uniforms;
+    bool valid = false;
 };
 
 #endif
@@ -0,0 +1,519 @@
+﻿//
+// src/simd_kernels.cpp
+//
+
+#include "simd_kernels.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC accepts AVX2 intrinsics anywhere; GCC and Clang only in functions compiled for AVX2.
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace {
+
+// Points per block of the parallel loops.
+constexpr size_t BLOCK_POINTS = 1 << 16;
+
+SimdLevel detectSimdLevel()
+{
+#if defined(SIMD_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+    __cpuid(info, 1);
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    // The OS must also save the AVX registers on context switches.
+    if (maxLeaf < 7 || !fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return SimdLevel::SSE2;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0 ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#endif
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const SimdLevel supportedLevel = detectSimdLevel();
+std::atomic<SimdLevel> activeLevel{supportedLevel};
+
+// --- Bounds ---
+
+void boundsScalar(const float *x, const float *y, const float *z, size_t count, Bounds &bounds)
+{
+    for (size_t i = 0; i < count; ++i) {
+        bounds.min = glm::min(bounds.min, glm::vec3(x[i], y[i], z[i]));
+        bounds.max = glm::max(bounds.max, glm::vec3(x[i], y[i], z[i]));
+    }
+}
+
+#if defined(SIMD_X86)
+float horizontalMin(__m128 v)
+{
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+float horizontalMax(__m128 v)
+{
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+void boundsSse2(const float *x, const float *y, const float *z, size_t count, Bounds &bounds)
+{
+    __m128 minX = _mm_set1_ps(bounds.min.x), minY = _mm_set1_ps(bounds.min.y), minZ = _mm_set1_ps(bounds.min.z);
+    __m128 maxX = _mm_set1_ps(bounds.max.x), maxY = _mm_set1_ps(bounds.max.y), maxZ = _mm_set1_ps(bounds.max.z);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+        minX = _mm_min_ps(minX, vx); maxX = _mm_max_ps(maxX, vx);
+        minY = _mm_min_ps(minY, vy); maxY = _mm_max_ps(maxY, vy);
+        minZ = _mm_min_ps(minZ, vz); maxZ = _mm_max_ps(maxZ, vz);
+    }
+    bounds.min = glm::vec3(horizontalMin(minX), horizontalMin(minY), horizontalMin(minZ));
+    bounds.max = glm::vec3(horizontalMax(maxX), horizontalMax(maxY), horizontalMax(maxZ));
+    boundsScalar(x + i, y + i, z + i, count - i, bounds);
+}
+
+TARGET_AVX2 float horizontalMin(__m256 v)
+{
+    return horizontalMin(_mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+TARGET_AVX2 float horizontalMax(__m256 v)
+{
+    return horizontalMax(_mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+TARGET_AVX2 void boundsAvx2(const float *x, const float *y, const float *z, size_t count, Bounds &bounds)
+{
+    __m256 minX = _mm256_set1_ps(bounds.min.x), minY = _mm256_set1_ps(bounds.min.y), minZ = _mm256_set1_ps(bounds.min.z);
+    __m256 maxX = _mm256_set1_ps(bounds.max.x), maxY = _mm256_set1_ps(bounds.max.y), maxZ = _mm256_set1_ps(bounds.max.z);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i), vz = _mm256_loadu_ps(z + i);
+        minX = _mm256_min_ps(minX, vx); maxX = _mm256_max_ps(maxX, vx);
+        minY = _mm256_min_ps(minY, vy); maxY = _mm256_max_ps(maxY, vy);
+        minZ = _mm256_min_ps(minZ, vz); maxZ = _mm256_max_ps(maxZ, vz);
+    }
+    bounds.min = glm::vec3(horizontalMin(minX), horizontalMin(minY), horizontalMin(minZ));
+    bounds.max = glm::vec3(horizontalMax(maxX), horizontalMax(maxY), horizontalMax(maxZ));
+    boundsScalar(x + i, y + i, z + i, count - i, bounds);
+}
+#endif
+
+// --- Centroid ---
+
+void sumScalar(const float *x, const float *y, const float *z, size_t count, glm::dvec3 &sum)
+{
+    for (size_t i = 0; i < count; ++i)
+        sum += glm::dvec3(x[i], y[i], z[i]);
+}
+
+#if defined(SIMD_X86)
+double horizontalSum(__m128d v)
+{
+    return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+void sumSse2(const float *x, const float *y, const float *z, size_t count, glm::dvec3 &sum)
+{
+    __m128d sumX = _mm_setzero_pd(), sumY = _mm_setzero_pd(), sumZ = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+        sumX = _mm_add_pd(sumX, _mm_add_pd(_mm_cvtps_pd(vx), _mm_cvtps_pd(_mm_movehl_ps(vx, vx))));
+        sumY = _mm_add_pd(sumY, _mm_add_pd(_mm_cvtps_pd(vy), _mm_cvtps_pd(_mm_movehl_ps(vy, vy))));
+        sumZ = _mm_add_pd(sumZ, _mm_add_pd(_mm_cvtps_pd(vz), _mm_cvtps_pd(_mm_movehl_ps(vz, vz))));
+    }
+    sum += glm::dvec3(horizontalSum(sumX), horizontalSum(sumY), horizontalSum(sumZ));
+    sumScalar(x + i, y + i, z + i, count - i, sum);
+}
+
+TARGET_AVX2 double horizontalSum(__m256d v)
+{
+    return horizontalSum(_mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1)));
+}
+
+// The eight floats of 'v' as two vectors of four doubles, added.
+TARGET_AVX2 __m256d widenAndAdd(__m256 v)
+{
+    return _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(v)), _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+}
+
+TARGET_AVX2 void sumAvx2(const float *x, const float *y, const float *z, size_t count, glm::dvec3 &sum)
+{
+    __m256d sumX = _mm256_setzero_pd(), sumY = _mm256_setzero_pd(), sumZ = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        sumX = _mm256_add_pd(sumX, widenAndAdd(_mm256_loadu_ps(x + i)));
+        sumY = _mm256_add_pd(sumY, widenAndAdd(_mm256_loadu_ps(y + i)));
+        sumZ = _mm256_add_pd(sumZ, widenAndAdd(_mm256_loadu_ps(z + i)));
+    }
+    sum += glm::dvec3(horizontalSum(sumX), horizontalSum(sumY), horizontalSum(sumZ));
+    sumScalar(x + i, y + i, z + i, count - i, sum);
+}
+#endif
+
+// --- Largest distance ---
+// Squared distances, the square root is taken once at the end.
+
+void maxDistanceScalar(const float *x, const float *y, const float *z, size_t count, const glm::vec3 &center,
+                       float &max2)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const float dx = x[i] - center.x, dy = y[i] - center.y, dz = z[i] - center.z;
+        max2 = std::max(max2, dx * dx + dy * dy + dz * dz);
+    }
+}
+
+#if defined(SIMD_X86)
+void maxDistanceSse2(const float *x, const float *y, const float *z, size_t count, const glm::vec3 &center,
+                     float &max2)
+{
+    const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    __m128 best = _mm_set1_ps(max2);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), cx);
+        const __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), cy);
+        const __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), cz);
+        best = _mm_max_ps(best, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+    }
+    max2 = horizontalMax(best);
+    maxDistanceScalar(x + i, y + i, z + i, count - i, center, max2);
+}
+
+TARGET_AVX2 void maxDistanceAvx2(const float *x, const float *y, const float *z, size_t count,
+                                 const glm::vec3 &center, float &max2)
+{
+    const __m256 cx = _mm256_set1_ps(center.x), cy = _mm256_set1_ps(center.y), cz = _mm256_set1_ps(center.z);
+    __m256 best = _mm256_set1_ps(max2);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), cx);
+        const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), cy);
+        const __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + i), cz);
+        __m256 distance2 = _mm256_mul_ps(dz, dz);
+        distance2 = _mm256_fmadd_ps(dy, dy, distance2);
+        distance2 = _mm256_fmadd_ps(dx, dx, distance2);
+        best = _mm256_max_ps(best, distance2);
+    }
+    max2 = horizontalMax(best);
+    maxDistanceScalar(x + i, y + i, z + i, count - i, center, max2);
+}
+#endif
+
+// --- Normalize to the unit cube ---
+// All versions subtract, then multiply, so they give the same results.
+
+void normalizeScalar(const float *in, size_t count, float low, float scale, float *out)
+{
+    for (size_t i = 0; i < count; ++i)
+        out[i] = (in[i] - low) * scale;
+}
+
+#if defined(SIMD_X86)
+void normalizeSse2(const float *in, size_t count, float low, float scale, float *out)
+{
+    const __m128 vLow = _mm_set1_ps(low), vScale = _mm_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(in + i), vLow), vScale));
+    normalizeScalar(in + i, count - i, low, scale, out + i);
+}
+
+TARGET_AVX2 void normalizeAvx2(const float *in, size_t count, float low, float scale, float *out)
+{
+    const __m256 vLow = _mm256_set1_ps(low), vScale = _mm256_set1_ps(scale);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(in + i), vLow), vScale));
+    normalizeScalar(in + i, count - i, low, scale, out + i);
+}
+#endif
+
+// --- Pack colors ---
+// Rounded as floor(v * 255 + 0.5) of the clamped value in every version. NaN packs to 0.
+
+uint32_t packUnorm8(float value)
+{
+    value = value > 0.0f ? std::min(value, 1.0f) : 0.0f;
+    return static_cast<uint32_t>(value * 255.0f + 0.5f);
+}
+
+void packColorsScalar(const float *r, const float *g, const float *b, size_t count, uint32_t *rgba)
+{
+    for (size_t i = 0; i < count; ++i)
+        rgba[i] = packUnorm8(r[i]) | packUnorm8(g[i]) << 8 | packUnorm8(b[i]) << 16 | 0xFF000000u;
+}
+
+#if defined(SIMD_X86)
+// _mm_max_ps returns its second operand for NaN, so NaN clamps to 0.
+__m128i quantizeUnorm8(__m128 v)
+{
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+TARGET_AVX2 __m256i quantizeUnorm8(__m256 v)
+{
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+}
+
+void packColorsSse2(const float *r, const float *g, const float *b, size_t count, uint32_t *rgba)
+{
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i packed = _mm_or_si128(quantizeUnorm8(_mm_loadu_ps(r + i)),
+                                      _mm_slli_epi32(quantizeUnorm8(_mm_loadu_ps(g + i)), 8));
+        packed = _mm_or_si128(packed, _mm_slli_epi32(quantizeUnorm8(_mm_loadu_ps(b + i)), 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i), _mm_or_si128(packed, alpha));
+    }
+    packColorsScalar(r + i, g + i, b + i, count - i, rgba + i);
+}
+
+TARGET_AVX2 void packColorsAvx2(const float *r, const float *g, const float *b, size_t count, uint32_t *rgba)
+{
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i packed = _mm256_or_si256(quantizeUnorm8(_mm256_loadu_ps(r + i)),
+                                         _mm256_slli_epi32(quantizeUnorm8(_mm256_loadu_ps(g + i)), 8));
+        packed = _mm256_or_si256(packed, _mm256_slli_epi32(quantizeUnorm8(_mm256_loadu_ps(b + i)), 16));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + i), _mm256_or_si256(packed, alpha));
+    }
+    packColorsScalar(r + i, g + i, b + i, count - i, rgba + i);
+}
+#endif
+
+// --- Transform ---
+// glm matrices are column-major: m[column][row].
+
+void transformScalar(const glm::mat4 &m, float *x, float *y, float *z, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const float px = x[i], py = y[i], pz = z[i];
+        x[i] = m[0][0] * px + m[1][0] * py + m[2][0] * pz + m[3][0];
+        y[i] = m[0][1] * px + m[1][1] * py + m[2][1] * pz + m[3][1];
+        z[i] = m[0][2] * px + m[1][2] * py + m[2][2] * pz + m[3][2];
+    }
+}
+
+#if defined(SIMD_X86)
+void transformSse2(const glm::mat4 &m, float *x, float *y, float *z, size_t count)
+{
+    __m128 c[4][3];
+    for (int column = 0; column < 4; ++column) {
+        for (int row = 0; row < 3; ++row)
+            c[column][row] = _mm_set1_ps(m[column][row]);
+    }
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+        for (int row = 0; row < 3; ++row) {
+            __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0][row], px), _mm_mul_ps(c[1][row], py)),
+                                  _mm_add_ps(_mm_mul_ps(c[2][row], pz), c[3][row]));
+            _mm_storeu_ps((row == 0 ? x : row == 1 ? y : z) + i, v);
+        }
+    }
+    transformScalar(m, x + i, y + i, z + i, count - i);
+}
+
+TARGET_AVX2 void transformAvx2(const glm::mat4 &m, float *x, float *y, float *z, size_t count)
+{
+    __m256 c[4][3];
+    for (int column = 0; column < 4; ++column) {
+        for (int row = 0; row < 3; ++row)
+            c[column][row] = _mm256_set1_ps(m[column][row]);
+    }
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+        for (int row = 0; row < 3; ++row) {
+            __m256 v = _mm256_fmadd_ps(c[2][row], pz, c[3][row]);
+            v = _mm256_fmadd_ps(c[1][row], py, v);
+            v = _mm256_fmadd_ps(c[0][row], px, v);
+            _mm256_storeu_ps((row == 0 ? x : row == 1 ? y : z) + i, v);
+        }
+    }
+    transformScalar(m, x + i, y + i, z + i, count - i);
+}
+#endif
+
+// Call the version of a kernel for the active level.
+#if defined(SIMD_X86)
+#define DISPATCH(kernel, ...)                                       \
+    do {                                                            \
+        switch (activeLevel.load(std::memory_order_relaxed)) {      \
+            case SimdLevel::AVX2: kernel##Avx2(__VA_ARGS__); break; \
+            case SimdLevel::SSE2: kernel##Sse2(__VA_ARGS__); break; \
+            default:              kernel##Scalar(__VA_ARGS__); break; \
+        }                                                           \
+    } while (false)
+#else
+#define DISPATCH(kernel, ...) kernel##Scalar(__VA_ARGS__)
+#endif
+
+} // namespace
+
+SimdLevel getSimdLevel()
+{
+    return activeLevel.load();
+}
+
+void setSimdLevel(SimdLevel level)
+{
+    activeLevel.store(std::min(level, supportedLevel));
+}
+
+const char *simdLevelName(SimdLevel level)
+{
+    switch (level) {
+        case SimdLevel::AVX2: return "AVX2";
+        case SimdLevel::SSE2: return "SSE2";
+        default:              return "scalar";
+    }
+}
+
+bool parseSimdLevel(const std::string &name, SimdLevel &level)
+{
+    if (name == "avx2")
+        level = SimdLevel::AVX2;
+    else if (name == "sse2")
+        level = SimdLevel::SSE2;
+    else if (name == "scalar")
+        level = SimdLevel::Scalar;
+    else
+        return false;
+    return true;
+}
+
+Bounds computeBounds(const float *x, const float *y, const float *z, size_t count)
+{
+    if (count == 0)
+        return {glm::vec3(0.0f), glm::vec3(0.0f)};
+
+    const Bounds empty{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+    Bounds bounds = empty;
+    std::mutex mutex;
+    ThreadPool::instance().parallelFor(0, count, [&](size_t first, size_t last) {
+        Bounds local = empty;
+        DISPATCH(bounds, x + first, y + first, z + first, last - first, local);
+        std::lock_guard<std::mutex> lock(mutex);
+        bounds.min = glm::min(bounds.min, local.min);
+        bounds.max = glm::max(bounds.max, local.max);
+    }, BLOCK_POINTS);
+    return bounds;
+}
+
+glm::dvec3 computeCentroid(const float *x, const float *y, const float *z, size_t count)
+{
+    if (count == 0)
+        return glm::dvec3(0.0);
+
+    glm::dvec3 sum(0.0);
+    std::mutex mutex;
+    ThreadPool::instance().parallelFor(0, count, [&](size_t first, size_t last) {
+        glm::dvec3 local(0.0);
+        DISPATCH(sum, x + first, y + first, z + first, last - first, local);
+        std::lock_guard<std::mutex> lock(mutex);
+        sum += local;
+    }, BLOCK_POINTS);
+    return sum / static_cast<double>(count);
+}
+
+float computeMaxDistance(const float *x, const float *y, const float *z, size_t count, const glm::vec3 &center)
+{
+    float max2 = 0.0f;
+    std::mutex mutex;
+    ThreadPool::instance().parallelFor(0, count, [&](size_t first, size_t last) {
+        float local = 0.0f;
+        DISPATCH(maxDistance, x + first, y + first, z + first, last - first, center, local);
+        std::lock_guard<std::mutex> lock(mutex);
+        max2 = std::max(max2, local);
+    }, BLOCK_POINTS);
+    return std::sqrt(max2);
+}
+
+void normalizeToUnitCube(const float *x, const float *y, const float *z, size_t count, const Bounds &bounds,
+                         float *outX, float *outY, float *outZ)
+{
+    // Flat axes keep a non-zero extent so they map to 0 instead of dividing by zero.
+    const glm::vec3 extent = glm::max(bounds.extent(), glm::vec3(1e-20f));
+    const glm::vec3 scale(1.0f / extent.x, 1.0f / extent.y, 1.0f / extent.z);
+    ThreadPool::instance().parallelFor(0, count, [&](size_t first, size_t last) {
+        DISPATCH(normalize, x + first, last - first, bounds.min.x, scale.x, outX + first);
+        DISPATCH(normalize, y + first, last - first, bounds.min.y, scale.y, outY + first);
+        DISPATCH(normalize, z + first, last - first, bounds.min.z, scale.z, outZ + first);
+    }, BLOCK_POINTS);
+}
+
+void packColors(const float *r, const float *g, const float *b, size_t count, uint32_t *rgba)
+{
+    ThreadPool::instance().parallelFor(0, count, [&](size_t first, size_t last) {
+        DISPATCH(packColors, r + first, g + first, b + first, last - first, rgba + first);
+    }, BLOCK_POINTS);
+}
+
+void transformPositions(const glm::mat4 &transform, float *x, float *y, float *z, size_t count)
+{
+    ThreadPool::instance().parallelFor(0, count, [&](size_t first, size_t last) {
+        DISPATCH(transform, transform, x + first, y + first, z + first, last - first);
+    }, BLOCK_POINTS);
+}
+
+Bounds computeTransformedBounds(const glm::mat4 &transform, const float *x, const float *y, const float *z,
+                                size_t count)
+{
+    if (count == 0)
+        return {glm::vec3(0.0f), glm::vec3(0.0f)};
+
+    const Bounds empty{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+    Bounds bounds = empty;
+    std::mutex mutex;
+    ThreadPool::instance().parallelFor(0, count, [&](size_t first, size_t last) {
+        // The transform kernels work in place, so each block is transformed in a copy.
+        std::vector<float> tx(BLOCK_POINTS), ty(BLOCK_POINTS), tz(BLOCK_POINTS);
+        Bounds local = empty;
+        for (size_t begin = first; begin < last; begin += BLOCK_POINTS) {
+            const size_t n = std::min(BLOCK_POINTS, last - begin);
+            std::copy(x + begin, x + begin + n, tx.begin());
+            std::copy(y + begin, y + begin + n, ty.begin());
+            std::copy(z + begin, z + begin + n, tz.begin());
+            DISPATCH(transform, transform, tx.data(), ty.data(), tz.data(), n);
+            DISPATCH(bounds, tx.data(), ty.data(), tz.data(), n, local);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        bounds.min = glm::min(bounds.min, local.min);
+        bounds.max = glm::max(bounds.max, local.max);
+    }, BLOCK_POINTS);
+    return bounds;
+}
@@ -0,0 +1,59 @@
+﻿//
+// src/simd_kernels.hpp
+//
+
+#ifndef SIMD_KERNELS_HPP
+#define SIMD_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <glm/glm.hpp>
+#include "point.hpp"
+
+// Vectorized passes over the component arrays of PointArrays.
+//
+// Every kernel has an AVX2, an SSE2 and a scalar version. The best one the CPU supports is
+// picked at run time, so the build needs no special compiler flags and still runs on CPUs
+// without AVX2 (and on non-x86 machines, with the scalar versions). Large inputs are split
+// over the thread pool. The arrays need no particular alignment.
+
+// Instruction sets the kernels can use, in increasing order.
+enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+// The level the kernels use: the best one the CPU supports, unless lowered by setSimdLevel().
+SimdLevel getSimdLevel();
+// Use at most 'level', e.g. to compare the versions. Levels the CPU lacks are never used.
+void setSimdLevel(SimdLevel level);
+const char* simdLevelName(SimdLevel level);
+// Parse "avx2", "sse2" or "scalar". Returns false for anything else.
+bool parseSimdLevel(const std::string& name, SimdLevel& level);
+
+// Bounds of the positions. Empty input gives a zero box.
+Bounds computeBounds(const float* x, const float* y, const float* z, size_t count);
+
+// Mean of the positions, summed in double precision. Empty input gives zero.
+glm::dvec3 computeCentroid(const float* x, const float* y, const float* z, size_t count);
+
+// Largest distance of the positions from 'center'. Empty input gives 0.
+float computeMaxDistance(const float* x, const float* y, const float* z, size_t count, const glm::vec3& center);
+
+// Map the positions into [0,1] per axis relative to 'bounds' and write them to the 'out' arrays,
+// which may be the input arrays. Flat axes map to 0.
+void normalizeToUnitCube(const float* x, const float* y, const float* z, size_t count, const Bounds& bounds,
+                         float* outX, float* outY, float* outZ);
+
+// Convert colors in [0,1] to RGBA8 with alpha 255, red in the lowest byte, as stored in
+// CompactPoint::color. Values are clamped and rounded to the nearest step.
+void packColors(const float* r, const float* g, const float* b, size_t count, uint32_t* rgba);
+
+// Transform the positions in place by 'transform', whose last row must be (0, 0, 0, 1).
+void transformPositions(const glm::mat4& transform, float* x, float* y, float* z, size_t count);
+
+// Bounds of the positions transformed by 'transform' (as in transformPositions()), leaving the
+// input as it is. Tight where transformBounds() of the untransformed bounds is not, i.e. when
+// 'transform' rotates. Empty input gives a zero box.
+Bounds computeTransformedBounds(const glm::mat4& transform, const float* x, const float* y, const float* z,
+                                size_t count);
+
+#endif // SIMD_KERNELS_HPP
@@ -0,0 +1,141 @@
+﻿//
+// src/splat_renderer.cpp
+//
+
+#include "splat_renderer.hpp"
+#include "depth_range.hpp"
+#include "frame_uniforms.hpp"
+#include <iostream>
+
+namespace {
+
+GLuint createTexture(GLint internalFormat, GLenum format, GLenum type, int width, int height)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+} // namespace
+
+SplatRenderer::SplatRenderer()
+    : depthShader("shaders/point_cloud.vs", "shaders/splat_depth.fs"),
+      accumulateShader("shaders/point_cloud.vs", "shaders/splat_accumulate.fs"),
+      resolveShader("shaders/fullscreen.vs", "shaders/splat_resolve.fs")
+{
+    depthShader.bindUniformBlock("FrameUniforms", FRAME_UNIFORMS_BINDING);
+    accumulateShader.bindUniformBlock("FrameUniforms", FRAME_UNIFORMS_BINDING);
+    resolveShader.bindUniformBlock("FrameUniforms", FRAME_UNIFORMS_BINDING);
+    resolveShader.use();
+    resolveShader.setInt("colorTexture", 0);
+    resolveShader.setInt("normalTexture", 1);
+    resolveShader.setInt("depthTexture", 2);
+    glUseProgram(0);
+    glGenVertexArrays(1, &emptyVAO);
+}
+
+SplatRenderer::~SplatRenderer()
+{
+    resize(0, 0);
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+void SplatRenderer::resize(int newWidth, int newHeight)
+{
+    if (newWidth == width && newHeight == height)
+        return;
+    if (framebuffer) {
+        glDeleteFramebuffers(1, &framebuffer);
+        GLuint textures[] = {colorTexture, normalTexture, depthTexture};
+        glDeleteTextures(3, textures);
+        framebuffer = colorTexture = normalTexture = depthTexture = 0;
+    }
+    width = newWidth;
+    height = newHeight;
+    if (width <= 0 || height <= 0)
+        return;
+
+    colorTexture = createTexture(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+    normalTexture = createTexture(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+    depthTexture = createTexture(GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLint previous = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "[Splat] G-buffer framebuffer is incomplete" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previous));
+}
+
+void SplatRenderer::render(PointRenderer &renderer, const glm::mat4 &projection, const glm::mat4 &view,
+                           const SplatSettings &settings)
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    resize(viewport[2], viewport[3]);
+    if (!framebuffer)
+        return;
+    GLint target = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    const GLfloat clearDepth = farDepth();
+    glClearBufferfv(GL_COLOR, 0, zero);
+    glClearBufferfv(GL_COLOR, 1, zero);
+    glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+
+    // 1. Visibility: nearest surface, pushed back a little.
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    depthShader.use();
+    depthShader.setMat4("model", glm::mat4(1.0f));
+    depthShader.setFloat("depthOffset", settings.depthOffset);
+    renderer.render(depthShader, projection, view);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    // 2. Accumulation of every splat that passes the visibility depth.
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    accumulateShader.use();
+    accumulateShader.setMat4("model", glm::mat4(1.0f));
+    renderer.draw(accumulateShader);
+    glDisable(GL_BLEND);
+    glDepthMask(GL_TRUE);
+
+    // 3. Resolve into the target framebuffer, writing depth for everything drawn afterwards.
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(target));
+    glDepthFunc(GL_ALWAYS);
+    resolveShader.use();
+    resolveShader.setMat4("inverseViewProjection", glm::inverse(projection * view));
+    resolveShader.setBool("depthZeroToOne", isReversedZ());
+    resolveShader.setFloat("farDepth", farDepth());
+    resolveShader.setBool("eyeDomeLighting", settings.eyeDomeLighting);
+    resolveShader.setFloat("edlStrength", settings.edlStrength);
+    resolveShader.setFloat("edlRadius", settings.edlRadius);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, normalTexture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glDepthFunc(depthFunction());
+}
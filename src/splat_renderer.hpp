@@ -0,0 +1,59 @@
+﻿//
+// src/splat_renderer.hpp
+//
+
+#ifndef SPLAT_RENDERER_HPP
+#define SPLAT_RENDERER_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "point_renderer.hpp"
+#include "shader.hpp"
+
+// Options of the deferred pipeline, set from the menu.
+struct SplatSettings {
+    bool enabled = false;          // false draws with the forward shader instead
+    bool eyeDomeLighting = true;
+    float edlStrength = 1.0f;
+    float edlRadius = 1.4f;        // distance of the compared neighbours in pixels
+    float depthOffset = 0.01f;     // how far behind the visible surface splats still blend, relative
+};
+
+// Deferred point rendering into an offscreen G-buffer:
+//  1. visibility: the points write only depth, pushed back by 'depthOffset';
+//  2. accumulation: color and normal of every splat in front of that depth are summed with
+//     additive blending, weighted towards the splat center;
+//  3. resolve: one full-screen pass normalizes the sums, applies the lighting and optionally
+//     eye-dome lighting, and writes color and depth to the target framebuffer.
+// Lighting is computed once per pixel, not once per splat fragment, so big point sizes only
+// cost blending.
+class SplatRenderer {
+public:
+    SplatRenderer();
+    ~SplatRenderer();
+
+    SplatRenderer(const SplatRenderer&) = delete;
+    SplatRenderer& operator=(const SplatRenderer&) = delete;
+
+    // Draw the points of 'renderer' into the bound framebuffer, sized like the current viewport.
+    // The per-frame uniforms must be set.
+    void render(PointRenderer& renderer, const glm::mat4& projection, const glm::mat4& view,
+                const SplatSettings& settings);
+
+private:
+    // (Re)create the G-buffer textures if the size changed.
+    void resize(int width, int height);
+
+    Shader depthShader;
+    Shader accumulateShader;
+    Shader resolveShader;
+    GLuint framebuffer = 0;
+    GLuint colorTexture = 0;    // RGBA16F, rgb * weight and weight
+    GLuint normalTexture = 0;   // RGBA16F, normal * weight and weight
+    GLuint depthTexture = 0;
+    GLuint emptyVAO = 0;        // for the full-screen triangle
+    int width = 0;
+    int height = 0;
+};
+
+#endif // SPLAT_RENDERER_HPP
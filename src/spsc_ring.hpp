@@ -0,0 +1,82 @@
+﻿//
+// src/spsc_ring.hpp
+//
+
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded queue between exactly one producer thread and one consumer thread, without locks.
+//
+// 'head' is only written by the producer and 'tail' only by the consumer, each published with a
+// release store and read by the other side with an acquire load, so the items written before a
+// push() are visible after the pop() that returns them. Both indices count up without wrapping
+// inside the ring; the capacity is a power of two, so the slot is index & mask. Each side keeps a
+// cached copy of the other side's index and only reloads it when the ring looks full or empty,
+// which keeps the two cache lines from bouncing between the cores on every call.
+template <typename T>
+class SpscRing {
+public:
+    // 'minCapacity' is rounded up to a power of two.
+    explicit SpscRing(size_t minCapacity)
+    {
+        size_t capacity = 1;
+        while (capacity < minCapacity)
+            capacity *= 2;
+        slots.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t capacity() const { return slots.size(); }
+    // Items in the ring; only a snapshot while the other side is running.
+    size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+
+    // Producer: copy as many of 'count' items as fit and return how many that were. Items that
+    // reach the end of the slots continue at the start.
+    size_t push(const T* items, size_t count)
+    {
+        const size_t write = head.load(std::memory_order_relaxed);
+        if (write + count - cachedTail > slots.size())
+            cachedTail = tail.load(std::memory_order_acquire);
+        count = std::min(count, slots.size() - (write - cachedTail));
+        const size_t first = write & mask;
+        const size_t part = std::min(count, slots.size() - first);
+        std::copy(items, items + part, slots.begin() + first);
+        std::copy(items + part, items + count, slots.begin());
+        head.store(write + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer: move up to 'maxCount' items into 'items' and return how many there were.
+    size_t pop(T* items, size_t maxCount)
+    {
+        const size_t read = tail.load(std::memory_order_relaxed);
+        if (cachedHead - read < maxCount)
+            cachedHead = head.load(std::memory_order_acquire);
+        const size_t count = std::min(maxCount, cachedHead - read);
+        const size_t first = read & mask;
+        const size_t part = std::min(count, slots.size() - first);
+        std::copy(slots.begin() + first, slots.begin() + first + part, items);
+        std::copy(slots.begin(), slots.begin() + (count - part), items + part);
+        tail.store(read + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    std::vector<T> slots;
+    size_t mask = 0;
+    // Each index on its own cache line, next to the cached copy its owner reads with it.
+    alignas(64) std::atomic<size_t> head{0};   // next slot to write, owned by the producer
+    size_t cachedTail = 0;                      // producer's copy of 'tail'
+    alignas(64) std::atomic<size_t> tail{0};   // next slot to read, owned by the consumer
+    size_t cachedHead = 0;                      // consumer's copy of 'head'
+};
+
+#endif // SPSC_RING_HPP
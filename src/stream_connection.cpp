@@ -0,0 +1,502 @@
+﻿//
+// src/stream_connection.cpp
+//
+
+#include "stream_connection.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+  #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+  #endif
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  #include <windows.h>
+#else
+  #include <cerrno>
+  #include <csignal>
+  #include <fcntl.h>
+  #include <netdb.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <poll.h>
+  #include <sys/socket.h>
+  #include <sys/types.h>
+  #include <unistd.h>
+#endif
+
+namespace {
+
+constexpr const char *TCP_PREFIX = "tcp://";
+// How long a pending connect waits before it checks whether it was cancelled.
+constexpr int CONNECT_POLL_MS = 50;
+
+#ifdef _WIN32
+using NativeSocket = SOCKET;
+constexpr NativeSocket NO_SOCKET = INVALID_SOCKET;
+
+void closeSocket(NativeSocket s)
+{
+    closesocket(s);
+}
+
+// Winsock has to be started once per process before the first socket call.
+bool startSockets()
+{
+    static const bool started = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return started;
+}
+
+std::string socketError(int code)
+{
+    return "error " + std::to_string(code);
+}
+
+std::string lastSocketError()
+{
+    return socketError(WSAGetLastError());
+}
+
+bool setNonBlocking(NativeSocket s, bool nonBlocking)
+{
+    u_long mode = nonBlocking ? 1 : 0;
+    return ioctlsocket(s, FIONBIO, &mode) == 0;
+}
+
+bool connectPending()
+{
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+// Wait for a pending connect to finish. Returns 1 once it has, 0 on timeout and -1 on errors.
+int waitForConnect(NativeSocket s, int timeoutMs)
+{
+    fd_set writable, failed;
+    FD_ZERO(&writable);
+    FD_ZERO(&failed);
+    FD_SET(s, &writable);
+    FD_SET(s, &failed);
+    timeval timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+    return std::min(select(0, nullptr, &writable, &failed, &timeout), 1);
+}
+#else
+using NativeSocket = int;
+constexpr NativeSocket NO_SOCKET = -1;
+
+void closeSocket(NativeSocket s)
+{
+    ::close(s);
+}
+
+bool startSockets()
+{
+    return true;
+}
+
+std::string socketError(int code)
+{
+    return std::strerror(code);
+}
+
+std::string lastSocketError()
+{
+    return socketError(errno);
+}
+
+bool setNonBlocking(NativeSocket s, bool nonBlocking)
+{
+    const int flags = fcntl(s, F_GETFL);
+    return flags != -1 && fcntl(s, F_SETFL, nonBlocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK) != -1;
+}
+
+bool connectPending()
+{
+    return errno == EINPROGRESS;
+}
+
+// Wait for a pending connect to finish. Returns 1 once it has, 0 on timeout and -1 on errors.
+int waitForConnect(NativeSocket s, int timeoutMs)
+{
+    pollfd writable{s, POLLOUT, 0};
+    int ready = poll(&writable, 1, timeoutMs);
+    return ready < 0 && errno == EINTR ? 0 : ready;
+}
+#endif
+
+// Split "tcp://host:port"; IPv6 hosts are written in brackets, e.g. "tcp://[::1]:5555".
+bool parseTcpAddress(const std::string &address, std::string &host, std::string &port)
+{
+    const std::string rest = address.substr(std::strlen(TCP_PREFIX));
+    const size_t colon = rest.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == rest.size()) {
+        std::cerr << "[Stream] Expected tcp://host:port, got: " << address << std::endl;
+        return false;
+    }
+    host = rest.substr(0, colon);
+    port = rest.substr(colon + 1);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+        host = host.substr(1, host.size() - 2);
+    return true;
+}
+
+bool isCancelled(const std::atomic<bool> *cancel)
+{
+    return cancel && *cancel;
+}
+
+// Connect 's' to 'target' without blocking, checking every CONNECT_POLL_MS whether to give up.
+// Sets 'error' on failure; the socket is blocking again on success.
+bool connectCancellable(NativeSocket s, const addrinfo &target, const std::atomic<bool> *cancel, std::string &error)
+{
+    if (!setNonBlocking(s, true)) {
+        error = lastSocketError();
+        return false;
+    }
+    if (connect(s, target.ai_addr, static_cast<int>(target.ai_addrlen)) != 0) {
+        if (!connectPending()) {
+            error = lastSocketError();
+            return false;
+        }
+        int ready = 0;
+        while (ready == 0) {
+            if (isCancelled(cancel)) {
+                error = "cancelled";
+                return false;
+            }
+            ready = waitForConnect(s, CONNECT_POLL_MS);
+        }
+        int result = 0;
+        socklen_t length = sizeof(result);
+        if (ready < 0 || getsockopt(s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&result), &length) != 0) {
+            error = lastSocketError();
+            return false;
+        }
+        if (result != 0) {
+            error = socketError(result);
+            return false;
+        }
+    }
+    if (!setNonBlocking(s, false)) {
+        error = lastSocketError();
+        return false;
+    }
+    return true;
+}
+
+// Connect to 'address', or listen on it and accept one client. NO_SOCKET (logged) on failure.
+// A connect is given up, without a message, once '*cancel' becomes true.
+NativeSocket connectSocket(const std::string &address, bool listen, const std::atomic<bool> *cancel)
+{
+    std::string host, port;
+    if (!parseTcpAddress(address, host, port) || !startSockets())
+        return NO_SOCKET;
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listen ? AI_PASSIVE : 0;
+    addrinfo *result = nullptr;
+    if (int error = getaddrinfo(host.c_str(), port.c_str(), &hints, &result)) {
+        std::cerr << "[Stream] Cannot resolve " << address << ": " << gai_strerror(error) << std::endl;
+        return NO_SOCKET;
+    }
+    NativeSocket connection = NO_SOCKET;
+    std::string error;
+    for (addrinfo *candidate = result; candidate && connection == NO_SOCKET && !isCancelled(cancel);
+         candidate = candidate->ai_next) {
+        NativeSocket s = ::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (s == NO_SOCKET)
+            continue;
+        if (!listen) {
+            if (connectCancellable(s, *candidate, cancel, error))
+                connection = s;
+        } else {
+            const int reuse = 1;
+            setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+            if (bind(s, candidate->ai_addr, static_cast<int>(candidate->ai_addrlen)) == 0 && ::listen(s, 1) == 0) {
+                std::cout << "[Stream] Waiting for a reader on " << address << std::endl;
+                connection = accept(s, nullptr, nullptr);
+            }
+            if (connection == NO_SOCKET)
+                error = lastSocketError();
+        }
+        if (connection != s)
+            closeSocket(s);
+    }
+    freeaddrinfo(result);
+    if (connection == NO_SOCKET) {
+        if (isCancelled(cancel))
+            return NO_SOCKET;
+        std::cerr << "[Stream] Failed to " << (listen ? "listen on " : "connect to ") << address << ": " << error
+                  << std::endl;
+        return NO_SOCKET;
+    }
+    // Batches go out as soon as they are written instead of waiting to fill a segment.
+    const int noDelay = 1;
+    setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+    return connection;
+}
+
+} // namespace
+
+StreamConnection::~StreamConnection()
+{
+    close();
+}
+
+bool StreamConnection::isTcpAddress(const std::string &address)
+{
+    return address.rfind(TCP_PREFIX, 0) == 0;
+}
+
+bool StreamConnection::isStreamAddress(const std::string &name)
+{
+    if (name == "-" || isTcpAddress(name))
+        return true;
+#ifdef _WIN32
+    return name.rfind("\\\\.\\pipe\\", 0) == 0;
+#else
+    std::error_code ec;
+    return std::filesystem::is_fifo(name, ec);
+#endif
+}
+
+bool StreamConnection::openSocket(const std::string &address, bool listen, const std::atomic<bool> *cancel)
+{
+    NativeSocket s = connectSocket(address, listen, cancel);
+    if (s == NO_SOCKET)
+        return false;
+#ifdef _WIN32
+    handle_ = static_cast<uintptr_t>(s);
+#else
+    fd_ = s;
+#endif
+    socket = true;
+    owned = true;
+    return true;
+}
+
+#ifdef _WIN32
+
+bool StreamConnection::isOpen() const
+{
+    return handle_ != 0;
+}
+
+void StreamConnection::close()
+{
+    if (handle_ != 0 && owned) {
+        if (socket)
+            closeSocket(static_cast<NativeSocket>(handle_));
+        else
+            CloseHandle(reinterpret_cast<HANDLE>(handle_));
+    }
+    handle_ = 0;
+    socket = owned = false;
+}
+
+bool StreamConnection::openRead(const std::string &address, const std::atomic<bool> *cancel)
+{
+    close();
+    if (isTcpAddress(address))
+        return openSocket(address, false, cancel);
+    HANDLE pipe;
+    if (address == "-") {
+        pipe = GetStdHandle(STD_INPUT_HANDLE);
+    } else {
+        pipe = CreateFileA(address.c_str(), GENERIC_READ, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        owned = true;
+    }
+    if (pipe == INVALID_HANDLE_VALUE || pipe == nullptr) {
+        std::cerr << "[Stream] Failed to open for reading: " << address << std::endl;
+        owned = false;
+        return false;
+    }
+    handle_ = reinterpret_cast<uintptr_t>(pipe);
+    return true;
+}
+
+bool StreamConnection::openWrite(const std::string &address)
+{
+    close();
+    if (isTcpAddress(address))
+        return openSocket(address, true, nullptr);
+    HANDLE pipe;
+    if (address == "-") {
+        pipe = GetStdHandle(STD_OUTPUT_HANDLE);
+    } else if (isStreamAddress(address)) {
+        // The writing end creates the named pipe and waits for the reader to open it.
+        pipe = CreateNamedPipeA(address.c_str(), PIPE_ACCESS_OUTBOUND, PIPE_TYPE_BYTE | PIPE_WAIT, 1, 1 << 20, 0, 0,
+                                nullptr);
+        if (pipe != INVALID_HANDLE_VALUE) {
+            std::cout << "[Stream] Waiting for a reader on " << address << std::endl;
+            if (!ConnectNamedPipe(pipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED) {
+                CloseHandle(pipe);
+                pipe = INVALID_HANDLE_VALUE;
+            }
+        }
+        owned = true;
+    } else {
+        pipe = CreateFileA(address.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        owned = true;
+    }
+    if (pipe == INVALID_HANDLE_VALUE || pipe == nullptr) {
+        std::cerr << "[Stream] Failed to open for writing: " << address << std::endl;
+        owned = false;
+        return false;
+    }
+    handle_ = reinterpret_cast<uintptr_t>(pipe);
+    return true;
+}
+
+long StreamConnection::read(char *data, size_t size, int timeoutMs)
+{
+    const DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+    if (socket) {
+        NativeSocket s = static_cast<NativeSocket>(handle_);
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(s, &readable);
+        timeval timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+        int ready = select(0, &readable, nullptr, nullptr, &timeout);
+        if (ready <= 0)
+            return ready == 0 ? 0 : -1;
+        int received = recv(s, data, static_cast<int>(chunk), 0);
+        return received > 0 ? received : -1;
+    }
+
+    // Pipes cannot be waited on with a timeout, so poll how much is available.
+    HANDLE pipe = reinterpret_cast<HANDLE>(handle_);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    DWORD available = 0;
+    while (true) {
+        if (!PeekNamedPipe(pipe, nullptr, 0, nullptr, &available, nullptr))
+            return -1;
+        if (available > 0)
+            break;
+        if (std::chrono::steady_clock::now() >= deadline)
+            return 0;
+        Sleep(1);
+    }
+    DWORD received = 0;
+    if (!ReadFile(pipe, data, std::min(chunk, available), &received, nullptr) || received == 0)
+        return -1;
+    return static_cast<long>(received);
+}
+
+bool StreamConnection::write(const char *data, size_t size)
+{
+    while (size > 0) {
+        const DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        DWORD written = 0;
+        if (socket) {
+            int sent = send(static_cast<NativeSocket>(handle_), data, static_cast<int>(chunk), 0);
+            if (sent <= 0)
+                return false;
+            written = static_cast<DWORD>(sent);
+        } else if (!WriteFile(reinterpret_cast<HANDLE>(handle_), data, chunk, &written, nullptr) || written == 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+#else
+
+bool StreamConnection::isOpen() const
+{
+    return fd_ >= 0;
+}
+
+void StreamConnection::close()
+{
+    if (fd_ >= 0 && owned)
+        ::close(fd_);
+    fd_ = -1;
+    socket = owned = false;
+}
+
+bool StreamConnection::openRead(const std::string &address, const std::atomic<bool> *cancel)
+{
+    close();
+    if (isTcpAddress(address))
+        return openSocket(address, false, cancel);
+    if (address == "-") {
+        fd_ = STDIN_FILENO;
+        return true;
+    }
+    // Opened without blocking, as a FIFO otherwise waits for its writer; until that comes, read()
+    // times out as if no data had arrived yet.
+    fd_ = ::open(address.c_str(), O_RDONLY | O_NONBLOCK);
+    if (fd_ >= 0)
+        fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_NONBLOCK);
+    if (fd_ < 0) {
+        std::cerr << "[Stream] Failed to open for reading: " << address << " (" << std::strerror(errno) << ")"
+                  << std::endl;
+        return false;
+    }
+    owned = true;
+    return true;
+}
+
+bool StreamConnection::openWrite(const std::string &address)
+{
+    close();
+    // A reader that goes away makes write() fail instead of killing the process.
+    std::signal(SIGPIPE, SIG_IGN);
+    if (isTcpAddress(address))
+        return openSocket(address, true, nullptr);
+    if (address == "-") {
+        fd_ = STDOUT_FILENO;
+        return true;
+    }
+    // Regular files are created, so a feed can also be recorded and replayed through a FIFO later.
+    fd_ = ::open(address.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "[Stream] Failed to open for writing: " << address << " (" << std::strerror(errno) << ")"
+                  << std::endl;
+        return false;
+    }
+    owned = true;
+    return true;
+}
+
+long StreamConnection::read(char *data, size_t size, int timeoutMs)
+{
+    pollfd readable{fd_, POLLIN, 0};
+    int ready = poll(&readable, 1, timeoutMs);
+    if (ready <= 0)
+        return ready == 0 || errno == EINTR ? 0 : -1;
+    ssize_t received = ::read(fd_, data, size);
+    if (received < 0)
+        return errno == EINTR || errno == EAGAIN ? 0 : -1;
+    return received > 0 ? static_cast<long>(received) : -1;
+}
+
+bool StreamConnection::write(const char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t written = ::write(fd_, data, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+#endif
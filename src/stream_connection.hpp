@@ -0,0 +1,60 @@
+﻿//
+// src/stream_connection.hpp
+//
+
+#ifndef STREAM_CONNECTION_HPP
+#define STREAM_CONNECTION_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// One end of a byte stream for live point feeds (see stream_format.hpp). The address is
+// "-" for stdin/stdout, "tcp://host:port" for a TCP connection, or the path of a named pipe
+// (a FIFO made with mkfifo, or "\\.\pipe\name" on Windows).
+// Uses POSIX file descriptors and sockets, or Win32 handles and Winsock on Windows.
+class StreamConnection {
+public:
+    StreamConnection() = default;
+    ~StreamConnection();
+
+    StreamConnection(const StreamConnection&) = delete;
+    StreamConnection& operator=(const StreamConnection&) = delete;
+
+    // Open 'address' for reading. TCP connects to a listening sender; a named pipe is opened without
+    // waiting for its writer. Returns false (and logs) on failure.
+    // Connecting can take until the system gives up on an unreachable host, so it is done on a
+    // background thread: it stops early, without a message, once '*cancel' becomes true.
+    bool openRead(const std::string& address, const std::atomic<bool>* cancel = nullptr);
+    // Open 'address' for writing. TCP listens on the port and waits for one reader to connect, and
+    // so does a named pipe on Windows. Returns false (and logs) on failure.
+    bool openWrite(const std::string& address);
+    void close();
+    bool isOpen() const;
+
+    // Read up to 'size' bytes, waiting at most 'timeoutMs' for the first of them.
+    // Returns the number of bytes read, 0 if none arrived in time, or -1 at the end of the stream
+    // and on errors.
+    long read(char* data, size_t size, int timeoutMs);
+    // Write all 'size' bytes, blocking while the reader is behind. Returns false once it is gone.
+    bool write(const char* data, size_t size);
+
+    // Whether 'name' is a stream address rather than a point cloud file.
+    static bool isStreamAddress(const std::string& name);
+    // Whether 'address' is a "tcp://host:port" address, whose openRead() may block.
+    static bool isTcpAddress(const std::string& address);
+
+private:
+    bool openSocket(const std::string& address, bool listen, const std::atomic<bool>* cancel);
+
+    bool socket = false;       // a TCP connection rather than a pipe or the standard streams
+    bool owned = false;        // closed by close(), false for stdin/stdout
+#ifdef _WIN32
+    uintptr_t handle_ = 0;     // HANDLE of a pipe or SOCKET, 0 if closed
+#else
+    int fd_ = -1;
+#endif
+};
+
+#endif // STREAM_CONNECTION_HPP
@@ -0,0 +1,33 @@
+﻿//
+// src/stream_format.hpp
+//
+
+#ifndef STREAM_FORMAT_HPP
+#define STREAM_FORMAT_HPP
+
+#include <cstdint>
+#include "point.hpp"
+
+// Wire format of a live point feed, read by PointStream and written by the stream generator.
+//
+// The feed is a sequence of batches, each a StreamBatchHeader followed by 'pointCount' Point
+// records (position, color, normal and radius as ten little-endian floats, see point.hpp).
+// Positions are relative to the batch origin, so a scanner in georeferenced coordinates can send
+// float offsets without losing precision (see chooseOrigin() in point.hpp). A radius of 0 leaves
+// the splat size to the fixed point size.
+constexpr char STREAM_MAGIC[4] = {'P', 'C', 'S', 'B'};
+constexpr uint32_t STREAM_VERSION = 1;
+// Larger batches are rejected as corrupt, so a broken header cannot make the reader allocate gigabytes.
+constexpr uint32_t MAX_STREAM_BATCH_POINTS = 1u << 20;
+
+struct StreamBatchHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t pointCount;
+    uint32_t reserved;
+    double origin[3];       // added to the positions to get the coordinates of the scanner
+};
+static_assert(sizeof(StreamBatchHeader) == 40, "StreamBatchHeader layout must not change");
+static_assert(sizeof(Point) == 40, "Point records are sent as is");
+
+#endif // STREAM_FORMAT_HPP
@@ -0,0 +1,104 @@
+﻿//
+// src/thread_pool.cpp
+//
+
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned numThreads)
+{
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    workers.reserve(numThreads);
+    for (unsigned i = 0; i < numThreads; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+ThreadPool &ThreadPool::instance()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(task));
+    }
+    condition.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)> &fn,
+                             size_t minBlock)
+{
+    if (begin >= end)
+        return;
+    size_t count = end - begin;
+    // A few blocks per worker keeps the load balanced when blocks take uneven time.
+    size_t numBlocks = std::min<size_t>(size() * 4, (count + minBlock - 1) / std::max<size_t>(minBlock, 1));
+    if (numBlocks <= 1) {
+        fn(begin, end);
+        return;
+    }
+
+    // Shared with the helper tasks, which may still start after this call returned.
+    struct State {
+        std::atomic<size_t> nextBlock{0};
+        std::atomic<size_t> doneBlocks{0};
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<State>();
+    auto runBlocks = [state, begin, count, numBlocks, &fn] {
+        for (;;) {
+            size_t block = state->nextBlock.fetch_add(1);
+            if (block >= numBlocks)
+                return;
+            fn(begin + count * block / numBlocks, begin + count * (block + 1) / numBlocks);
+            if (state->doneBlocks.fetch_add(1) + 1 == numBlocks) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done.notify_all();
+            }
+        }
+    };
+
+    // Helpers only touch 'fn' while they own an unfinished block, and the caller waits for all
+    // blocks, so the reference stays valid.
+    size_t numHelpers = std::min<size_t>(size(), numBlocks - 1);
+    for (size_t i = 0; i < numHelpers; ++i)
+        submit(runBlocks);
+    runBlocks();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&] { return state->doneBlocks.load() == numBlocks; });
+}
@@ -0,0 +1,50 @@
+﻿//
+// src/thread_pool.hpp
+//
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads shared by the loaders and the CPU processing passes.
+class ThreadPool {
+public:
+    // 'numThreads' == 0 creates one worker per hardware core.
+    explicit ThreadPool(unsigned numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Process-wide pool, created on first use.
+    static ThreadPool& instance();
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    // Queue a task for execution on one of the workers.
+    void submit(std::function<void()> task);
+
+    // Split [begin, end) into blocks of at least 'minBlock' items and call fn(blockBegin, blockEnd)
+    // for each of them on the workers. The calling thread takes part and returns once all blocks
+    // are done, so this may also be used from inside a task.
+    void parallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)>& fn,
+                     size_t minBlock = 1);
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+};
+
+#endif // THREAD_POOL_HPP
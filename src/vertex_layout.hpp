@@ -0,0 +1,56 @@
+﻿//
+// src/vertex_layout.hpp
+//
+
+#ifndef VERTEX_LAYOUT_HPP
+#define VERTEX_LAYOUT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include "point.hpp"
+
+// Attribute locations used by shaders/point_cloud.vs.
+enum VertexLocation : uint32_t {
+    LOCATION_POSITION = 0,
+    LOCATION_COLOR    = 1,
+    LOCATION_NORMAL   = 2,
+    LOCATION_RADIUS   = 3,
+    LOCATION_TILE     = 4   // index of the scene tile, per instance or a constant attribute
+};
+
+// Describes where one vertex attribute lives inside a block of vertex data.
+// The struct is plain data with fixed-size members, so it is also stored as is in cache files.
+struct VertexAttribute {
+    uint32_t location;
+    uint32_t components;
+    uint32_t type;        // GL type enum, e.g. GL_FLOAT
+    uint32_t normalized;  // GL_TRUE or GL_FALSE
+    uint64_t offset;      // byte offset of the first element from the start of the vertex data
+    uint64_t stride;      // bytes between consecutive elements
+};
+
+// Layout of a std::vector<Point> uploaded as is.
+inline std::vector<VertexAttribute> interleavedPointLayout()
+{
+    return {
+        {LOCATION_POSITION, 3, GL_FLOAT, GL_FALSE, offsetof(Point, position), sizeof(Point)},
+        {LOCATION_COLOR,    3, GL_FLOAT, GL_FALSE, offsetof(Point, color),    sizeof(Point)},
+        {LOCATION_NORMAL,   3, GL_FLOAT, GL_FALSE, offsetof(Point, normal),   sizeof(Point)},
+        {LOCATION_RADIUS,   1, GL_FLOAT, GL_FALSE, offsetof(Point, radius),   sizeof(Point)},
+    };
+}
+
+// Enable and point the attributes of the currently bound VAO at the bound GL_ARRAY_BUFFER.
+inline void applyVertexLayout(const std::vector<VertexAttribute>& attributes)
+{
+    for (const VertexAttribute& attribute : attributes) {
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribPointer(attribute.location, static_cast<GLint>(attribute.components), attribute.type,
+                              static_cast<GLboolean>(attribute.normalized), static_cast<GLsizei>(attribute.stride),
+                              reinterpret_cast<void*>(static_cast<uintptr_t>(attribute.offset)));
+    }
+}
+
+#endif // VERTEX_LAYOUT_HPP
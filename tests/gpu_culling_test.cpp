@@ -0,0 +1,150 @@
+﻿//
+// tests/gpu_culling_test.cpp
+//
+
+// Culls the chunks of a random two-tile cloud from many cameras with GpuChunkCuller and with
+// cullChunks(), and checks that both pick the same chunks and that the GPU commands draw them
+// with the right range and tile. Needs an OpenGL 4.3 context; CTest runs it with Mesa's
+// llvmpipe, so no GPU is required. Exits with SKIP_EXIT_CODE if no such context can be created.
+
+#include "chunk_grid.hpp"
+#include "frustum.hpp"
+#include "gl_extensions.hpp"
+#include "gpu_culler.hpp"
+#include "hidden_window.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+constexpr size_t POINT_COUNT = 200000;
+constexpr size_t CHUNK_POINTS = 1024;
+constexpr int VIEWS = 200;
+// Chunks this close to a plane may fall either way, as the GPU may round differently.
+constexpr float PLANE_TOLERANCE = 1e-3f;
+
+// Smallest distance of the chunk's furthest corner to any of the planes, as cullChunks() computes it.
+float planeMargin(const ChunkGrid &grid, size_t i, const Frustum &frustum)
+{
+    float margin = INFINITY;
+    for (const glm::vec4 &plane : frustum.planes) {
+        float distance = std::max(plane.x * grid.minX[i], plane.x * grid.maxX[i])
+                         + std::max(plane.y * grid.minY[i], plane.y * grid.maxY[i])
+                         + std::max(plane.z * grid.minZ[i], plane.z * grid.maxZ[i]) + plane.w;
+        margin = std::min(margin, std::abs(distance));
+    }
+    return margin;
+}
+
+int runTest()
+{
+    if (!GpuChunkCuller::isSupported()) {
+        std::cout << "[Test] No compute shaders or multi-draw indirect, skipping" << std::endl;
+        return SKIP_EXIT_CODE;
+    }
+    GpuChunkCuller culler;
+    if (!culler.isValid()) {
+        std::cerr << "[Test] Failed to build shaders/chunk_cull.comp" << std::endl;
+        return 1;
+    }
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+    std::vector<Point> points(POINT_COUNT);
+    for (Point &point : points)
+        point.position = glm::vec3(coordinate(random), coordinate(random), coordinate(random) * 0.2f);
+    ChunkGrid grid;
+    buildChunkGrid(points, grid, CHUNK_POINTS);
+
+    // Two tiles over the same chunks, the second shifted and rotated in the world.
+    const size_t split = grid.size() / 2;
+    std::vector<uint32_t> chunkTile(grid.size(), 0);
+    std::fill(chunkTile.begin() + split, chunkTile.end(), 1u);
+    const glm::mat4 tileTransforms[2] = {
+        glm::mat4(1.0f),
+        glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(25.0f, 0.0f, 0.0f)), 0.7f, glm::vec3(0.0f, 1.0f, 0.0f)),
+    };
+    culler.setChunks(grid, chunkTile);
+
+    std::vector<uint8_t> visible(grid.size());
+    std::vector<DrawArraysIndirectCommand> commands(grid.size());
+    size_t checked = 0, cpuVisible = 0, borderline = 0;
+    for (int view = 0; view < VIEWS; ++view) {
+        glm::vec3 eye(coordinate(random) * 4.0f, coordinate(random) * 4.0f, coordinate(random) * 4.0f);
+        glm::vec3 target(coordinate(random) + 12.0f, coordinate(random), coordinate(random));
+        glm::mat4 viewProjection = glm::perspective(glm::radians(30.0f), 16.0f / 9.0f, 0.5f, 40.0f)
+                                   * glm::lookAt(eye, target, glm::vec3(0.0f, 0.0f, 1.0f));
+
+        std::vector<Frustum> frustums;
+        for (const glm::mat4 &transform : tileTransforms)
+            frustums.push_back(extractFrustum(viewProjection * transform));
+        cullChunks(grid, frustums[0], visible, 0, split);
+        cullChunks(grid, frustums[1], visible, split, grid.size());
+
+        culler.cull(frustums);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, culler.getCommandBuffer());
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                           static_cast<GLsizeiptr>(commands.size() * sizeof(DrawArraysIndirectCommand)), commands.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        for (size_t i = 0; i < grid.size(); ++i) {
+            const DrawArraysIndirectCommand &command = commands[i];
+            if (command.first != static_cast<GLuint>(grid.first[i]) || command.count != static_cast<GLuint>(grid.count[i])
+                || command.baseInstance != chunkTile[i]) {
+                std::cerr << "[Test] View " << view << ", chunk " << i << ": wrong draw command" << std::endl;
+                return 1;
+            }
+            if ((command.instanceCount != 0) != (visible[i] != 0)) {
+                if (planeMargin(grid, i, frustums[chunkTile[i]]) < PLANE_TOLERANCE) {
+                    ++borderline;
+                    continue;
+                }
+                std::cerr << "[Test] View " << view << ", chunk " << i << ": "
+                          << (visible[i] ? "visible" : "culled") << " on the CPU but not on the GPU" << std::endl;
+                return 1;
+            }
+            cpuVisible += visible[i];
+            ++checked;
+        }
+    }
+    // Views that see nothing or everything would not test much.
+    if (cpuVisible == 0 || cpuVisible == checked) {
+        std::cerr << "[Test] The views do not cull any chunks differently" << std::endl;
+        return 1;
+    }
+    std::cout << "[Test] " << VIEWS << " views of " << grid.size() << " chunks agree (" << cpuVisible << " of "
+              << checked << " visible, " << borderline << " on a plane)" << std::endl;
+    return 0;
+}
+
+} // namespace
+
+int main()
+{
+    GLFWwindow *window = createHiddenWindow(4, 3);
+    if (!window) {
+        std::cout << "[Test] No OpenGL 4.3 context, skipping" << std::endl;
+        return SKIP_EXIT_CODE;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
+        std::cerr << "[Test] Failed to initialize GLAD" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    loadGlExtensions(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
+    const char *renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    std::cout << "[Test] Renderer: " << (renderer ? renderer : "unknown") << std::endl;
+
+    // The culler is released inside runTest(), while the context still exists.
+    int result = runTest();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return result;
+}
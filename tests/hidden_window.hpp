@@ -0,0 +1,42 @@
+﻿//
+// tests/hidden_window.hpp
+//
+
+#ifndef HIDDEN_WINDOW_HPP
+#define HIDDEN_WINDOW_HPP
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+// Exit code of a test that cannot run here, reported by CTest as skipped (SKIP_RETURN_CODE).
+constexpr int SKIP_EXIT_CODE = 77;
+
+// Create an invisible window with an OpenGL 'major'.'minor' core context, for tests that need a
+// context but draw nothing. Without a display it falls back to Mesa's software context without
+// any window system, as in the benchmark. Returns null, with GLFW terminated, if neither works.
+inline GLFWwindow *createHiddenWindow(int major, int minor)
+{
+    auto create = [&]() -> GLFWwindow* {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        return glfwCreateWindow(64, 64, "Test", nullptr, nullptr);
+    };
+
+    if (glfwInit()) {
+        if (GLFWwindow *window = create())
+            return window;
+        glfwTerminate();
+    }
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    if (!glfwInit())
+        return nullptr;
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    GLFWwindow *window = create();
+    if (!window)
+        glfwTerminate();
+    return window;
+}
+
+#endif // HIDDEN_WINDOW_HPP
@@ -0,0 +1,133 @@
+﻿//
+// tests/point_stream_test.cpp
+//
+
+// Feeds a PointStream from PointStreamGenerator over TCP, as a scanner would, and checks that all
+// points arrive and that the GPU ring keeps the newest of them within the point budget, also
+// after the budget is lowered. The path of the generator is the first argument. Needs an OpenGL
+// 3.3 context; CTest runs it with Mesa's llvmpipe. Exits with SKIP_EXIT_CODE if none can be created.
+
+#include "gl_extensions.hpp"
+#include "hidden_window.hpp"
+#include "point_stream.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The generator sends BATCHES batches of BATCH_POINTS points at RATE points per second.
+constexpr unsigned BATCH_POINTS = 5000;
+constexpr unsigned BATCHES = 100;
+constexpr unsigned RATE = 1000000;
+constexpr uint64_t TOTAL_POINTS = uint64_t(BATCH_POINTS) * BATCHES;
+constexpr size_t BUDGET = 200000;
+constexpr size_t LOWERED_BUDGET = 50000;
+// Fewer than a batch, so the points arrive over many frames.
+constexpr size_t POINTS_PER_FRAME = 3000;
+constexpr const char *ADDRESS = "tcp://127.0.0.1:47615";
+// The generator sweeps a 40 m swath across y, with centimetre noise.
+constexpr float HALF_SWATH = 20.5f;
+constexpr std::chrono::seconds TIMEOUT(30);
+
+bool check(bool condition, const char *what)
+{
+    if (!condition)
+        std::cerr << "[Test] Failed: " << what << std::endl;
+    return condition;
+}
+
+// Received = resident + evicted, with nothing dropped as the ring holds the whole feed.
+bool checkCounts(const PointStream::Stats &stats, size_t budget)
+{
+    std::cout << "[Test] Budget " << budget << ": received " << stats.pointsReceived << " points in "
+              << stats.batchesReceived << " batches, " << stats.pointsResident << " resident, "
+              << stats.pointsEvicted << " evicted, " << stats.pointsDropped << " dropped" << std::endl;
+    return check(stats.batchesReceived == BATCHES, "all batches received")
+           && check(stats.pointsReceived == TOTAL_POINTS, "all points received")
+           && check(stats.pointsDropped == 0, "no points dropped")
+           && check(stats.pointsResident == budget, "as many points resident as the budget")
+           && check(stats.pointsEvicted == TOTAL_POINTS - budget, "all other points evicted")
+           && check(stats.gpuBytes == budget * sizeof(Point), "the GPU ring no bigger than the budget");
+}
+
+int runTest(const std::string &generator)
+{
+    // The generator listens on ADDRESS, sends the feed to the first reader and exits.
+    const std::string command = "\"" + generator + "\" " + ADDRESS + " --rate " + std::to_string(RATE)
+                                + " --batch " + std::to_string(BATCH_POINTS) + " --seconds "
+                                + std::to_string(double(TOTAL_POINTS) / RATE);
+    int generatorResult = -1;
+    std::thread sender([&] { generatorResult = std::system(command.c_str()); });
+
+    PointStream stream;
+    stream.pointBudget = BUDGET;
+    stream.maxPointsPerFrame = POINTS_PER_FRAME;
+    const auto deadline = Clock::now() + TIMEOUT;
+    bool opened = stream.open(ADDRESS, TOTAL_POINTS);
+    size_t frames = 0;
+    while (opened && Clock::now() < deadline) {
+        stream.update();
+        ++frames;
+        const PointStream::Stats &stats = stream.getStats();
+        if (stats.ended && stats.connected)
+            break;
+        // Refused as the generator was not listening yet: connect again.
+        if (stats.ended)
+            opened = stream.open(ADDRESS, TOTAL_POINTS);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    if (!opened || !stream.getStats().ended) {
+        std::cerr << "[Test] The stream did not end within " << TIMEOUT.count() << " s" << std::endl;
+        // The generator may still wait for a reader, so it is not waited for.
+        sender.detach();
+        return 1;
+    }
+    sender.join();
+    std::cout << "[Test] Streamed in " << frames << " frames" << std::endl;
+
+    const Bounds bounds = stream.getBounds();
+    bool ok = check(generatorResult == 0, "the generator exits without an error")
+              && check(frames > TOTAL_POINTS / POINTS_PER_FRAME, "the points are spread over many frames")
+              && checkCounts(stream.getStats(), BUDGET)
+              && check(bounds.min.y >= -HALF_SWATH && bounds.max.y <= HALF_SWATH, "the points lie on the swath");
+    if (!ok)
+        return 1;
+
+    // A lower budget applies on the next update, dropping the oldest resident points.
+    stream.pointBudget = LOWERED_BUDGET;
+    stream.update();
+    return checkCounts(stream.getStats(), LOWERED_BUDGET) ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: PointStreamTest <path of PointStreamGenerator>" << std::endl;
+        return 1;
+    }
+    GLFWwindow *window = createHiddenWindow(3, 3);
+    if (!window) {
+        std::cout << "[Test] No OpenGL 3.3 context, skipping" << std::endl;
+        return SKIP_EXIT_CODE;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
+        std::cerr << "[Test] Failed to initialize GLAD" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    loadGlExtensions(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
+
+    // The stream is released inside runTest(), while the context still exists.
+    int result = runTest(argv[1]);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return result;
+}
@@ -0,0 +1,207 @@
+﻿//
+// tests/simd_kernels_test.cpp
+//
+
+// Runs every kernel of simd_kernels.hpp at each SimdLevel the CPU supports and compares the
+// results with the scalar versions, on odd counts and unaligned offsets so the vector loops and
+// their scalar tails are both exercised. Also checks that packing interleaved points gives the
+// same compact vertices as packing the arrays.
+
+#include "compact_vertex.hpp"
+#include "point_arrays.hpp"
+#include "simd_kernels.hpp"
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr size_t POINT_COUNT = 100003;
+constexpr size_t OFFSETS[] = {0, 1, 3, 7};
+// The vector versions may fuse multiplies and adds, so floats can differ in the last bit.
+constexpr float TOLERANCE = 1e-5f;
+// Coordinates reach 6000 and TRANSFORM scales them by 1.5, so a transformed coordinate is a sum of
+// terms this large that may cancel to a small one; its rounding follows the terms.
+constexpr float TRANSFORMED_TERMS = 10000.0f;
+
+struct Results {
+    std::vector<Bounds> bounds;
+    std::vector<glm::dvec3> centroids;
+    std::vector<float> maxDistances;
+    std::vector<float> unit;
+    std::vector<uint32_t> colors;
+    std::vector<CompactPoint> packed;
+    std::vector<float> transformed;
+    std::vector<Bounds> transformedBounds;
+};
+
+// Rotates about two axes, scales and translates, so every matrix element takes part.
+const glm::mat4 TRANSFORM = glm::scale(glm::rotate(glm::rotate(glm::translate(glm::mat4(1.0f),
+                                                                              glm::vec3(250.0f, -40.0f, 7.5f)),
+                                                               0.6f, glm::vec3(0.0f, 0.0f, 1.0f)),
+                                                   -0.3f, glm::vec3(1.0f, 0.0f, 0.0f)),
+                                       glm::vec3(1.5f));
+
+Results runKernels(const PointArrays &arrays)
+{
+    Results results;
+    for (size_t offset : OFFSETS) {
+        const size_t count = arrays.size() - offset;
+        const float *x = arrays.x.data() + offset, *y = arrays.y.data() + offset, *z = arrays.z.data() + offset;
+        Bounds bounds = computeBounds(x, y, z, count);
+        results.bounds.push_back(bounds);
+        results.centroids.push_back(computeCentroid(x, y, z, count));
+        results.maxDistances.push_back(computeMaxDistance(x, y, z, count, glm::vec3(1.5f, -2.0f, 0.25f)));
+
+        std::vector<float> unitX(count), unitY(count), unitZ(count);
+        normalizeToUnitCube(x, y, z, count, bounds, unitX.data(), unitY.data(), unitZ.data());
+        for (const std::vector<float> *axis : {&unitX, &unitY, &unitZ})
+            results.unit.insert(results.unit.end(), axis->begin(), axis->end());
+
+        std::vector<uint32_t> rgba(count);
+        packColors(arrays.r.data() + offset, arrays.g.data() + offset, arrays.b.data() + offset, count, rgba.data());
+        results.colors.insert(results.colors.end(), rgba.begin(), rgba.end());
+
+        std::vector<CompactPoint> packed(count);
+        packCompactPoints(arrays, offset, count, bounds, packed.data());
+        results.packed.insert(results.packed.end(), packed.begin(), packed.end());
+
+        std::vector<float> movedX(x, x + count), movedY(y, y + count), movedZ(z, z + count);
+        transformPositions(TRANSFORM, movedX.data(), movedY.data(), movedZ.data(), count);
+        for (const std::vector<float> *axis : {&movedX, &movedY, &movedZ})
+            results.transformed.insert(results.transformed.end(), axis->begin(), axis->end());
+        results.transformedBounds.push_back(computeTransformedBounds(TRANSFORM, x, y, z, count));
+    }
+    return results;
+}
+
+bool near(float a, float b, float magnitude = 1.0f)
+{
+    return std::abs(a - b) <= TOLERANCE * std::max(magnitude, std::abs(b));
+}
+
+bool near(const glm::vec3 &a, const glm::vec3 &b, float magnitude = 1.0f)
+{
+    return near(a.x, b.x, magnitude) && near(a.y, b.y, magnitude) && near(a.z, b.z, magnitude);
+}
+
+bool compare(const char *level, const Results &results, const Results &scalar)
+{
+    for (size_t i = 0; i < scalar.bounds.size(); ++i) {
+        if (results.bounds[i].min != scalar.bounds[i].min || results.bounds[i].max != scalar.bounds[i].max) {
+            std::cerr << "[Test] " << level << ": computeBounds differs at offset " << OFFSETS[i] << std::endl;
+            return false;
+        }
+        // Summed in double in another order; far below the float tolerance.
+        if (!near(glm::vec3(results.centroids[i]), glm::vec3(scalar.centroids[i]))) {
+            std::cerr << "[Test] " << level << ": computeCentroid differs at offset " << OFFSETS[i] << std::endl;
+            return false;
+        }
+        if (!near(results.transformedBounds[i].min, scalar.transformedBounds[i].min, TRANSFORMED_TERMS)
+            || !near(results.transformedBounds[i].max, scalar.transformedBounds[i].max, TRANSFORMED_TERMS)) {
+            std::cerr << "[Test] " << level << ": computeTransformedBounds differs at offset " << OFFSETS[i]
+                      << std::endl;
+            return false;
+        }
+        if (!near(results.maxDistances[i], scalar.maxDistances[i])) {
+            std::cerr << "[Test] " << level << ": computeMaxDistance differs at offset " << OFFSETS[i] << ": "
+                      << results.maxDistances[i] << " != " << scalar.maxDistances[i] << std::endl;
+            return false;
+        }
+    }
+    for (size_t i = 0; i < scalar.unit.size(); ++i) {
+        if (!near(results.unit[i], scalar.unit[i])) {
+            std::cerr << "[Test] " << level << ": normalizeToUnitCube differs at " << i << ": " << results.unit[i]
+                      << " != " << scalar.unit[i] << std::endl;
+            return false;
+        }
+    }
+    for (size_t i = 0; i < scalar.transformed.size(); ++i) {
+        if (!near(results.transformed[i], scalar.transformed[i], TRANSFORMED_TERMS)) {
+            std::cerr << "[Test] " << level << ": transformPositions differs at " << i << ": "
+                      << results.transformed[i] << " != " << scalar.transformed[i] << std::endl;
+            return false;
+        }
+    }
+    if (results.colors != scalar.colors) {
+        std::cerr << "[Test] " << level << ": packColors differs" << std::endl;
+        return false;
+    }
+    // The quantization steps are far coarser than the float differences above.
+    if (std::memcmp(results.packed.data(), scalar.packed.data(), scalar.packed.size() * sizeof(CompactPoint)) != 0) {
+        std::cerr << "[Test] " << level << ": packCompactPoints differs" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> coordinate(-1000.0f, 1000.0f);
+    // Colors a little outside [0,1] test the clamping.
+    std::uniform_real_distribution<float> unit(-0.1f, 1.1f);
+    std::vector<Point> points(POINT_COUNT);
+    for (Point &point : points) {
+        point.position = glm::vec3(coordinate(random), coordinate(random) * 0.01f, coordinate(random) + 5000.0f);
+        point.color = glm::vec3(unit(random), unit(random), unit(random));
+        point.normal = glm::normalize(glm::vec3(coordinate(random), coordinate(random), coordinate(random)));
+        point.radius = std::abs(coordinate(random)) * 0.01f;
+    }
+    PointArrays arrays;
+    splitPoints(points, arrays);
+
+    const SimdLevel best = getSimdLevel();
+    setSimdLevel(SimdLevel::Scalar);
+    const Results scalar = runKernels(arrays);
+
+    // The scalar versions against plain glm, at offset 0.
+    glm::dvec3 sum(0.0);
+    Bounds moved{glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+    for (size_t i = 0; i < POINT_COUNT; ++i) {
+        sum += glm::dvec3(points[i].position);
+        const glm::vec3 p = glm::vec3(TRANSFORM * glm::vec4(points[i].position, 1.0f));
+        moved = {glm::min(moved.min, p), glm::max(moved.max, p)};
+        if (!near(p, glm::vec3(scalar.transformed[i], scalar.transformed[POINT_COUNT + i],
+                               scalar.transformed[2 * POINT_COUNT + i]),
+                  TRANSFORMED_TERMS)) {
+            std::cerr << "[Test] transformPositions differs from glm at " << i << std::endl;
+            return 1;
+        }
+    }
+    if (!near(glm::vec3(sum / double(POINT_COUNT)), glm::vec3(scalar.centroids[0]))
+        || !near(moved.min, scalar.transformedBounds[0].min, TRANSFORMED_TERMS)
+        || !near(moved.max, scalar.transformedBounds[0].max, TRANSFORMED_TERMS)) {
+        std::cerr << "[Test] computeCentroid or computeTransformedBounds differs from glm" << std::endl;
+        return 1;
+    }
+
+    for (SimdLevel level : {SimdLevel::SSE2, SimdLevel::AVX2}) {
+        if (level > best) {
+            std::cout << "[Test] " << simdLevelName(level) << " not supported by this CPU, skipped" << std::endl;
+            continue;
+        }
+        setSimdLevel(level);
+        if (!compare(simdLevelName(level), runKernels(arrays), scalar))
+            return 1;
+        std::cout << "[Test] " << simdLevelName(level) << " matches scalar" << std::endl;
+    }
+
+    // The interleaved overload packs batch by batch, the arrays overload column by column.
+    setSimdLevel(best);
+    Bounds bounds = computeBounds(arrays.x.data(), arrays.y.data(), arrays.z.data(), arrays.size());
+    std::vector<CompactPoint> fromPoints, fromArrays(arrays.size());
+    packCompactPoints(points, bounds, fromPoints);
+    packCompactPoints(arrays, 0, arrays.size(), bounds, fromArrays.data());
+    if (std::memcmp(fromPoints.data(), fromArrays.data(), fromArrays.size() * sizeof(CompactPoint)) != 0) {
+        std::cerr << "[Test] Packing interleaved points differs from packing the arrays" << std::endl;
+        return 1;
+    }
+    std::cout << "[Test] Interleaved and array packing match" << std::endl;
+    return 0;
+}
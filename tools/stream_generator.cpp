@@ -0,0 +1,149 @@
+﻿//
+// tools/stream_generator.cpp
+//
+// Stand-in for a live scanner: writes a synthetic scan in the format of src/stream_format.hpp
+// to stdout, a named pipe or a file, or serves it to one TCP client.
+//
+//   PointStreamGenerator - | PointCloudRenderer -
+//   PointStreamGenerator tcp://127.0.0.1:5555 --rate 1000000 &  PointCloudRenderer tcp://127.0.0.1:5555
+//
+// All messages go to stderr, as stdout may carry the stream.
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "stream_connection.hpp"
+#include "stream_format.hpp"
+
+namespace {
+
+struct GeneratorOptions {
+    std::string address;
+    double pointsPerSecond = 500000.0;
+    unsigned batchPoints = 5000;
+    double seconds = 0.0;           // 0 runs until the reader goes away
+    glm::dvec3 origin{0.0};         // added to all positions, e.g. 500000 5400000 0 for UTM-like coordinates
+};
+
+// The scanner drives along x and sweeps one profile across y per line, over hilly terrain.
+constexpr double DRIVE_SPEED = 2.0;          // m/s
+constexpr double LINES_PER_SECOND = 100.0;
+constexpr double SWATH_WIDTH = 40.0;         // m
+
+double terrainHeight(double x, double y)
+{
+    return 2.0 * std::sin(0.1 * x) * std::cos(0.15 * y) + 0.5 * std::sin(0.7 * x + 0.3 * y);
+}
+
+glm::vec3 terrainNormal(double x, double y)
+{
+    const double dx = 0.2 * std::cos(0.1 * x) * std::cos(0.15 * y) + 0.35 * std::cos(0.7 * x + 0.3 * y);
+    const double dy = -0.3 * std::sin(0.1 * x) * std::sin(0.15 * y) + 0.15 * std::cos(0.7 * x + 0.3 * y);
+    return glm::normalize(glm::vec3(glm::dvec3(-dx, -dy, 1.0)));
+}
+
+// Green valleys, brown slopes and white tops.
+glm::vec3 heightColor(double z)
+{
+    const float t = static_cast<float>(std::min(std::max((z + 2.5) / 5.0, 0.0), 1.0));
+    const glm::vec3 low(0.2f, 0.5f, 0.2f), mid(0.55f, 0.4f, 0.25f), high(0.95f, 0.95f, 0.95f);
+    return t < 0.5f ? low + (mid - low) * (t * 2.0f) : mid + (high - mid) * (t * 2.0f - 1.0f);
+}
+
+bool parseArguments(int argc, char *argv[], GeneratorOptions &options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if ((arg == "--rate" || arg == "--batch" || arg == "--seconds") && i + 1 < argc) {
+            const double value = std::atof(argv[++i]);
+            if (value <= 0.0) {
+                std::cerr << "Invalid value for " << arg << ": " << argv[i] << std::endl;
+                return false;
+            }
+            if (arg == "--rate")
+                options.pointsPerSecond = value;
+            else if (arg == "--batch")
+                options.batchPoints = static_cast<unsigned>(std::min<double>(value, MAX_STREAM_BATCH_POINTS));
+            else
+                options.seconds = value;
+        } else if (arg == "--origin" && i + 3 < argc) {
+            for (int k = 0; k < 3; ++k)
+                options.origin[k] = std::atof(argv[++i]);
+        } else if (options.address.empty() && (arg == "-" || arg.rfind("--", 0) != 0)) {
+            options.address = arg;
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return false;
+        }
+    }
+    if (options.address.empty()) {
+        std::cerr << "Usage: PointStreamGenerator <- | tcp://host:port | pipe or file> [--rate <points/s>]"
+                  << " [--batch <points>] [--seconds <s>] [--origin <x> <y> <z>]" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    GeneratorOptions options;
+    if (!parseArguments(argc, argv, options))
+        return 1;
+    StreamConnection connection;
+    if (!connection.openWrite(options.address))
+        return 1;
+    std::cerr << "[Generator] Writing " << options.pointsPerSecond << " points/s in batches of "
+              << options.batchPoints << " to " << options.address << std::endl;
+
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    const double pointsPerLine = options.pointsPerSecond / LINES_PER_SECOND;
+    const float radius = static_cast<float>(0.5 * SWATH_WIDTH / pointsPerLine);
+    std::mt19937 random(12345u);
+    std::normal_distribution<double> noise(0.0, 0.01);
+    std::vector<char> batch(sizeof(StreamBatchHeader) + options.batchPoints * sizeof(Point));
+    uint64_t sent = 0;
+    while (options.seconds <= 0.0 || sent < options.seconds * options.pointsPerSecond) {
+        // Each batch is relative to where the scanner is, so the offsets stay small as it drives on.
+        const double scannerX = std::floor(DRIVE_SPEED * sent / options.pointsPerSecond);
+        StreamBatchHeader header{};
+        std::memcpy(header.magic, STREAM_MAGIC, sizeof(header.magic));
+        header.version = STREAM_VERSION;
+        header.pointCount = options.batchPoints;
+        const glm::dvec3 batchOrigin = options.origin + glm::dvec3(scannerX, 0.0, 0.0);
+        for (int k = 0; k < 3; ++k)
+            header.origin[k] = batchOrigin[k];
+        std::memcpy(batch.data(), &header, sizeof(header));
+
+        Point *points = reinterpret_cast<Point*>(batch.data() + sizeof(header));
+        for (unsigned i = 0; i < options.batchPoints; ++i, ++sent) {
+            const double line = sent / pointsPerLine;
+            const double x = DRIVE_SPEED * std::floor(line) / LINES_PER_SECOND + noise(random);
+            const double y = (line - std::floor(line) - 0.5) * SWATH_WIDTH + noise(random);
+            const double z = terrainHeight(x, y) + noise(random);
+            Point &pt = points[i];
+            pt.position = glm::vec3(glm::dvec3(x - scannerX, y, z));
+            pt.color = heightColor(z);
+            pt.normal = terrainNormal(x, y);
+            pt.radius = radius;
+        }
+        if (!connection.write(batch.data(), batch.size())) {
+            std::cerr << "[Generator] Reader went away after " << sent << " points" << std::endl;
+            return 0;
+        }
+
+        // Keep to the rate: sleep until this batch is due.
+        const auto due = start + std::chrono::duration<double>(sent / options.pointsPerSecond);
+        std::this_thread::sleep_until(std::chrono::time_point_cast<Clock::duration>(due));
+    }
+    std::cerr << "[Generator] Sent " << sent << " points" << std::endl;
+    return 0;
+}